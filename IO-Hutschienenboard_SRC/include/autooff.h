@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// Auto-off timer scheduler
+// Armed channels are kept ordered by deadline (64-bit esp_timer
+// microseconds, no wrap). One esp_timer fires at the earliest
+// deadline and calls dueFn; the owner then collects the expired
+// channels with takeExpired(). Nothing is polled per channel.
+//
+// The schedule is mirrored to RTC memory (CRC-protected) together
+// with a heartbeat. Every boot resets all relays to off, so after a
+// warm reset (watchdog, panic, brownout, restart) begin() drops the
+// mirrored timers by default. With AUTOOFF_RESTORE=1 it restores each
+// timer with the time it had left at the last heartbeat instead, and
+// iologic switches those relays back on for the rest - never longer.
+//
+// Usage:
+//   autooff::begin(onDue);                      // onDue runs in the esp_timer task
+//   autooff::arm(ch, 300, esp_timer_get_time()); // off in 5 min
+//   // In the IO cycle:
+//   autooff::heartbeat(nowUs);
+//   uint16_t due = autooff::takeExpired(nowUs);  // bit i = switch off relay i
+//
+// All functions taking nowUs work on that clock only, so the
+// scheduling logic can be driven by a virtual clock.
+// ============================================================
+
+#ifndef AUTOOFF_RESTORE
+#define AUTOOFF_RESTORE 0          // 1 = resume timers (and their relays) after a warm reset
+#endif
+
+namespace autooff {
+
+typedef void (*DueFn)();
+
+// Create the timer; restore = take over the deadlines from RTC memory
+void begin(DueFn due, bool restore = AUTOOFF_RESTORE != 0);
+
+// Channels restored by begin() (timer still running)
+uint16_t restoredMask();
+
+// Start the timer: off after seconds (seconds = 0 cancels)
+void arm(uint8_t ch, uint32_t seconds, int64_t nowUs);
+
+// New duration for a running timer, counted from its original start
+void retime(uint8_t ch, uint32_t seconds);
+
+void cancel(uint8_t ch);
+bool armed(uint8_t ch);
+
+// Seconds until the channel switches off (rounded up, 0 = not armed)
+uint32_t remainingSeconds(uint8_t ch, int64_t nowUs);
+
+// Remove and return all channels with deadline <= nowUs
+uint16_t takeExpired(int64_t nowUs);
+
+// Record "still alive at nowUs" for the reset restore
+void heartbeat(int64_t nowUs);
+
+} // namespace autooff
@@ -0,0 +1,95 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "stateproto.h"
+
+// ============================================================
+// Binary WebSocket subprotocol ("bin1")
+// Fixed-layout little-endian frames for machine clients (SCADA
+// bridge). JSON stays the default; a client switches to binary
+// with {"cmd":"hello","proto":"bin1"} (or a binary CMD_HELLO
+// frame) and from then on receives StateFrame instead of JSON.
+//
+// Every frame starts with {version, type}. Layout is pinned by
+// the static_asserts below - changing it requires a new version.
+// ============================================================
+
+#define BINPROTO_VERSION 1
+
+namespace binproto {
+
+enum MsgType : uint8_t {
+    MSG_STATE   = 0x01,   // Server -> client: StateFrame
+    MSG_COMMAND = 0x10,   // Client -> server: CommandFrame
+};
+
+enum Cmd : uint8_t {
+    CMD_HELLO  = 0x00,    // value = requested protocol version (ignored unless BINPROTO_VERSION)
+    CMD_TOGGLE = 0x01,    // ch
+    CMD_SET    = 0x02,    // ch, value 0/1
+    CMD_MAP    = 0x03,    // ch = input, value = output (int32, -1 = none)
+    CMD_TIMER  = 0x04,    // ch, value = auto-off seconds
+    CMD_ALLOFF = 0x05,
+    CMD_RESYNC = 0x06,    // Request a StateFrame
+    CMD_INMODE = 0x07,    // ch, value = mode (bits 0-7) | filter ms (bits 8-23)
+    CMD_S0IMP  = 0x08,    // ch, value = S0 impulses per kWh
+};
+
+// StateFrame.flags
+enum StateFlag : uint8_t {
+    SF_NTP  = (1 << 0),
+    SF_SIM  = (1 << 1),
+    SF_MCP1 = (1 << 2),
+    SF_MCP2 = (1 << 3),
+};
+
+struct __attribute__((packed)) StateFrame {
+    uint8_t  version;                  // BINPROTO_VERSION
+    uint8_t  type;                     // MSG_STATE
+    uint8_t  channels;                 // NUM_CHANNELS
+    uint8_t  flags;                    // StateFlag bits
+    uint32_t seq;                      // Same counter as the JSON frames
+    uint16_t inputs;                   // bit i = input i
+    uint16_t outputs;                  // bit i = relay i
+    int8_t   mappings[NUM_CHANNELS];   // -1 = none
+    uint32_t timers[NUM_CHANNELS];     // Auto-off seconds
+    uint32_t remaining[NUM_CHANNELS];  // Seconds until auto-off
+};
+
+struct __attribute__((packed)) CommandFrame {
+    uint8_t  version;                  // BINPROTO_VERSION
+    uint8_t  type;                     // MSG_COMMAND
+    uint8_t  cmd;                      // Cmd
+    uint8_t  ch;
+    int32_t  value;
+};
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "binproto: little-endian target required");
+static_assert(NUM_CHANNELS == 12, "binproto v1 layout is defined for 12 channels");
+static_assert(offsetof(StateFrame, seq) == 4, "StateFrame layout");
+static_assert(offsetof(StateFrame, inputs) == 8, "StateFrame layout");
+static_assert(offsetof(StateFrame, outputs) == 10, "StateFrame layout");
+static_assert(offsetof(StateFrame, mappings) == 12, "StateFrame layout");
+static_assert(offsetof(StateFrame, timers) == 24, "StateFrame layout");
+static_assert(offsetof(StateFrame, remaining) == 72, "StateFrame layout");
+static_assert(sizeof(StateFrame) == 120, "StateFrame layout");
+static_assert(offsetof(CommandFrame, value) == 4, "CommandFrame layout");
+static_assert(sizeof(CommandFrame) == 8, "CommandFrame layout");
+
+// --- Decoded command (shared by the JSON and binary paths) ---
+struct Command {
+    uint8_t cmd;     // Cmd
+    uint8_t ch;
+    int32_t value;
+};
+
+// Snapshot -> StateFrame (flags: extra bits such as SF_SIM)
+void encodeState(const stateproto::Snapshot& s, uint32_t seq, uint8_t flags, StateFrame& out);
+
+// Raw bytes -> Command; false on wrong size, version or type
+bool decodeCommand(const uint8_t* data, size_t len, Command& out);
+
+// Command -> CommandFrame (for clients / host tools)
+void encodeCommand(const Command& c, CommandFrame& out);
+
+} // namespace binproto
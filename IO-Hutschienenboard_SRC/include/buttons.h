@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// Top board buttons (MCP23017, interrupt driven)
+// The expander interrupts on any button change. The ISR only wakes
+// the button task. The task reads INTF, INTCAP and GPIO of both
+// ports in one 6-byte burst and debounces in software: a change is
+// taken at once, then the button is locked for BTN_DEBOUNCE_MS. One
+// settle read after the lockout catches a level that changed during
+// it. Without button activity the task sleeps and the bus stays
+// idle.
+//
+// Presses are collected as a mask; the IO scan takes them
+// (hal::buttonPresses()) and toggles relay i for button i.
+//
+// Usage:
+//   buttons::begin(MCP_BUTTONS, MCP_ADDR[MCP_BUTTONS], BUTTON_INT_PIN);  // after mcpport::begin
+//   uint16_t presses = buttons::takePresses();     // IO task
+//   buttons::Stats st = buttons::getStats();
+//
+// SIMULATE_HW: no interrupt, inject() stands in for a press.
+// ============================================================
+
+#ifndef BTN_DEBOUNCE_MS
+#define BTN_DEBOUNCE_MS 30         // Lockout after an accepted change
+#endif
+#ifndef BTN_RETRY_MS
+#define BTN_RETRY_MS 5             // Retry after a failed I2C read while INT is low
+#endif
+
+namespace buttons {
+
+// Configure the expander and start the task; false = chip missing
+bool begin(uint8_t chip, uint8_t addr, uint8_t intPin);
+bool ready();
+
+// Debounced presses since the last call, bit i = button i
+uint16_t takePresses();
+
+struct Stats {
+    uint32_t reads;         // Burst reads (interrupts + settle reads)
+    uint32_t presses;
+    uint32_t bounces;       // Changes ignored within the lockout
+    uint16_t held;          // Debounced state, bit i = button i down
+};
+
+Stats getStats();
+
+#if SIMULATE_HW
+void inject(uint8_t ch);
+#endif
+
+} // namespace buttons
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include "binproto.h"
+
+// ============================================================
+// Network -> I/O command queue
+// WebSocket handlers (async TCP task) only post a fixed-size
+// message and return; the IO task drains the queue at the start of
+// its cycle and executes the commands with the I/O image it owns.
+// Bounded and lock-free (MpmcRing): a full queue rejects the
+// command instead of blocking the network stack.
+//
+// Latencies go into log2 histograms (bucket k: 2^(k-1) .. 2^k - 1 us),
+// the percentiles in Stats are bucket upper bounds:
+//   wait     post -> popped by the IO task
+//   handler  WebSocket event handler, entry -> return
+//
+// Usage:
+//   cmdqueue::begin();                         // before the server starts
+//   if (!cmdqueue::post(cmd)) ...              // handler: queue full
+//   cmdqueue::noteHandler(micros() - t0);
+//   // IO task, I/O lock held:
+//   cmdqueue::Message m;
+//   while (cmdqueue::pop(m)) fx |= iologic::execute(m.cmd);
+//   cmdqueue::endCycle();
+// ============================================================
+
+#ifndef CMDQ_SIZE
+#define CMDQ_SIZE 32               // Queued commands (power of two)
+#endif
+#ifndef CMDQ_DRAIN_MAX
+#define CMDQ_DRAIN_MAX 8           // Commands executed per IO cycle
+#endif
+
+namespace cmdqueue {
+
+struct Message {
+    binproto::Command cmd;
+    int64_t postUs;                // hal::nowUs() at post()
+};
+
+void begin();
+
+// Any task (not an ISR); false = queue full, command rejected
+bool post(const binproto::Command& c);
+
+// IO task: oldest message, at most CMDQ_DRAIN_MAX per cycle
+// (call endCycle() after the loop); records the wait time
+bool pop(Message& m);
+void endCycle();
+
+// Duration of one network handler call
+void noteHandler(uint32_t us);
+
+struct Stats {
+    uint32_t depth;            // Messages waiting now
+    uint32_t maxDepth;
+    uint32_t posted;
+    uint32_t rejected;         // Queue full
+    uint32_t waitP50Us;
+    uint32_t waitP99Us;
+    uint32_t waitMaxUs;
+    uint32_t handlerP50Us;
+    uint32_t handlerP90Us;
+    uint32_t handlerP99Us;
+    uint32_t handlerMaxUs;
+};
+
+Stats getStats();
+
+} // namespace cmdqueue
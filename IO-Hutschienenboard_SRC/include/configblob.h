@@ -0,0 +1,104 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================
+// Binary configuration blob
+// The whole configuration is one packed struct stored under a
+// single NVS key, so loading it at boot is one getBytes():
+//
+//   magic u32 "IOCF" | version u16 | size u16 | crc32 u32 | Config[size]
+//
+// The layout is append-only. To add a field: append it to Config,
+// bump CFG_BLOB_VERSION and set its default in defaults(). A blob
+// of an older version is shorter, its missing tail keeps the
+// defaults; fields whose meaning changed get a fixup in migrate().
+// A blob of a newer firmware is read as far as this one knows it.
+//
+// Version 2 appended the rule text (rules.h), compiled at load.
+//
+// Before the blob every value had its own NVS key ("ssid", "map3",
+// "auto3", ...). load() falls back to those keys through a
+// LegacyReader when there is no usable blob.
+//
+// Usage:
+//   configblob::Config c;
+//   uint8_t buf[CFG_BLOB_MAX];
+//   size_t n = prefs.getBytes("cfg", buf, sizeof(buf));
+//   if (configblob::decode(buf, n, c) != configblob::OK) ...
+//   n = configblob::encode(c, buf, sizeof(buf));
+//   prefs.putBytes("cfg", buf, n);
+//   // Boot, with the old keys as fallback:
+//   if (configblob::load(buf, n, reader, c) == configblob::LEGACY) {
+//       ... write the blob, then configblob::forEachLegacyKey(remove)
+//   }
+// ============================================================
+
+#define CFG_BLOB_VERSION  2
+#define CFG_BLOB_CHANNELS 12
+#define CFG_BLOB_RULES    512   // Rule text incl. NUL (RULES_TEXT_MAX)
+#define CFG_BLOB_HEADER   12
+
+namespace configblob {
+
+// Version 2
+struct __attribute__((packed)) Config {
+    char     ssid[33];
+    char     pass[65];
+    int8_t   inputMapping[CFG_BLOB_CHANNELS];     // -1 = none
+    uint32_t autoOffSeconds[CFG_BLOB_CHANNELS];   // 0 = off
+    uint8_t  inputMode[CFG_BLOB_CHANNELS];        // inputfilter::Mode
+    uint16_t inputFilterMs[CFG_BLOB_CHANNELS];    // 0 = default of the mode
+    uint16_t s0Imp[CFG_BLOB_CHANNELS];            // Impulses per kWh
+    // --- Version 2 ---
+    char     rules[CFG_BLOB_RULES];               // Rule text, "" = none
+};
+
+#define CFG_BLOB_MAX (CFG_BLOB_HEADER + sizeof(configblob::Config))
+
+enum Result : uint8_t {
+    OK = 0,
+    MIGRATED,       // Older version, upgraded in memory (write it back)
+    EMPTY,          // No blob
+    CORRUPT,        // Bad magic / size / CRC, defaults returned
+    LEGACY          // load(): taken from the old keys (write the blob, remove them)
+};
+
+// Stored type of an old key (NVS reads only with the type it was written with)
+enum KeyType : uint8_t {
+    KEY_I8,         // "map0".."map11"
+    KEY_U8,         // "imode0".."imode11"
+    KEY_U16,        // "ifilt0".., "s0imp0"..
+    KEY_U32         // "auto0"..
+};
+
+// Access to the old keys (NVS on the board, a table in the tests)
+struct LegacyReader {
+    bool (*num)(const char* key, KeyType type, int64_t& v);     // false = not stored
+    bool (*str)(const char* key, char* out, size_t cap);        // "ssid", "pass"; false = not stored
+};
+
+void defaults(Config& c);
+
+// Blob -> c (defaults for missing fields; on EMPTY/CORRUPT all defaults)
+Result decode(const uint8_t* buf, size_t len, Config& c, uint16_t* version = nullptr);
+
+// c -> blob of the current version; returns bytes written (0 = cap too small)
+size_t encode(const Config& c, uint8_t* buf, size_t cap);
+
+// Old keys present ("ssid" or "map0")
+bool hasLegacy(const LegacyReader& r);
+
+// Old keys -> c; missing keys and values outside the range of their
+// field (mapping to a channel > 12, unknown input mode, ...) keep the default
+void readLegacy(const LegacyReader& r, Config& c);
+
+// Every old key, to remove them once the blob is written
+void forEachLegacyKey(void (*fn)(const char* key));
+
+// Boot: decode(), and if the blob is missing or corrupt the old keys
+// when present (LEGACY). blob: what decode() returned.
+Result load(const uint8_t* buf, size_t len, const LegacyReader& legacy, Config& c,
+            uint16_t* version = nullptr, Result* blob = nullptr);
+
+} // namespace configblob
@@ -0,0 +1,69 @@
+#pragma once
+#include <Arduino.h>
+#include "logtoken.h"
+
+// ============================================================
+// Post-mortem trace buffer
+// The last CRASHLOG_ENTRIES log records and state transitions are
+// kept in RTC memory, which survives watchdog, panic, brownout and
+// software resets. Recording copies the format string address,
+// the timestamp and the packed arguments (logtoken.h) - nothing is
+// formatted, so it stays on permanently. The text is only built
+// when the buffer is read out (/api/crashlog).
+//
+// dbg:: calls at CRASHLOG_MIN_LEVEL and above are recorded without
+// regard to the runtime category mask. Other state changes are
+// recorded explicitly with trace().
+//
+// begin() moves the records of the previous run out of RTC memory
+// (valid only for the same firmware build: the format addresses
+// come from its flash image) and starts a new buffer.
+//
+// Usage:
+//   crashlog::begin();                              // First thing in setup()
+//   crashlog::trace(dbg::CAT_INPUT, "Eingang %u: %u", ch + 1, level);
+//   // Read out:
+//   crashlog::writeEntries(w, false);               // Run before the reset
+//   crashlog::resetReasonName();                    // "TASK_WDT", "BROWNOUT", ...
+// ============================================================
+
+#ifndef CRASHLOG_ENTRIES
+#define CRASHLOG_ENTRIES 32     // 64 bytes each in RTC slow memory
+#endif
+#ifndef CRASHLOG_MIN_LEVEL
+#define CRASHLOG_MIN_LEVEL 1    // dbg::LVL_INFO
+#endif
+#define CRASHLOG_ARGS 48        // Packed argument bytes per entry
+#define CRASHLOG_LVL_TRACE 5    // Level of trace() entries ("EVT")
+
+namespace stateproto { class JsonWriter; }
+
+namespace crashlog {
+
+// Keep the previous run, start recording
+void begin();
+
+// One record (fmt must be a string literal); truncated: tok::Packer dropped arguments
+void record(uint8_t lvl, uint16_t cat, const char* fmt, const uint8_t* args, uint8_t len,
+            bool truncated = false);
+
+template <typename... Args>
+inline void trace(uint16_t cat, const char* fmt, Args... args) {
+    tok::Packer pk;
+    tok::packAll(pk, args...);
+    record(CRASHLOG_LVL_TRACE, cat, fmt, pk.buf, pk.len, pk.truncated);
+}
+
+// --- Read out (formats, not for hot paths) ---
+
+uint32_t bootCount();           // Runs since the buffer was first initialized
+int resetReason();              // esp_reset_reason() of this boot
+const char* resetReasonName();
+bool previousValid();           // Records of the previous run available
+uint32_t lostCount(bool current);   // Older records overwritten
+
+// Array of {"t","lvl","cat","msg"}, oldest first.
+// current = false: run before the last reset, true: this run
+void writeEntries(stateproto::JsonWriter& w, bool current);
+
+} // namespace crashlog
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================
+// Pacing of the WebSocket state broadcast
+// A state change only marks a frame as pending. tick() lets it go
+// out WS_COALESCE_MS after the first change (later changes merge
+// into it) and at most WS_MAX_FPS times per second. Without a
+// pending change a slot is still granted when a lagging client
+// waits for its catch-up snapshot.
+//
+// The clock is passed in (milliseconds), so the simulator drives
+// the same pacing with virtual time.
+//
+// Usage:
+//   framepace::request(millis());                  // state changed (any task)
+//   // Housekeeping:
+//   if (framepace::tick(millis(), anyStaleClient)) broadcastState();
+// ============================================================
+
+#ifndef WS_COALESCE_MS
+#define WS_COALESCE_MS 30          // Merge state changes within this window
+#endif
+#ifndef WS_MAX_FPS
+#define WS_MAX_FPS 20              // Upper limit for broadcast frames per second
+#endif
+
+namespace framepace {
+
+typedef bool (*StaleFn)();         // A client needs a catch-up frame
+
+void request(uint32_t nowMs);
+
+// true = send a frame now (stale may be nullptr)
+bool tick(uint32_t nowMs, StaleFn stale);
+
+bool pending();
+uint32_t coalesced();              // Changes merged into a pending frame
+
+} // namespace framepace
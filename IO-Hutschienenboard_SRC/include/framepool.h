@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// ============================================================
+// Pool of reference-counted message buffers (header-only)
+// The WebSocket library keeps a shared buffer (the type behind
+// AsyncWebSocketSharedBuffer) until every client it was queued for
+// has sent it. FramePool keeps N of them allocated at full size and
+// hands out one nobody else holds any more (use_count() == 1), so a
+// broadcast in steady state allocates nothing. When all N are still
+// in flight it allocates a new one and counts a miss.
+//
+// One taker task; the library may drop references from any task.
+//
+// Usage:
+//   static FramePool<6> pool;
+//   pool.begin(STATE_JSON_MAX);                 // at startup
+//   FramePool<6>::Buffer msg = pool.take(STATE_JSON_MAX);
+//   size_t n = format((char*)msg->data(), msg->size());
+//   msg->resize(n);                             // within capacity: no realloc
+//   ws.text(id, msg);
+// ============================================================
+
+template <size_t N>
+class FramePool {
+public:
+    typedef std::shared_ptr<std::vector<uint8_t>> Buffer;
+
+    void begin(size_t capacity) {
+        for (size_t i = 0; i < N; i++) {
+            m_buf[i] = std::make_shared<std::vector<uint8_t>>();
+            m_buf[i]->reserve(capacity);
+        }
+    }
+
+    // Buffer of len bytes; a pooled one if free, else a new one
+    Buffer take(size_t len) {
+        for (size_t i = 0; i < N; i++) {
+            Buffer& b = m_buf[i];
+            if (!b || b.use_count() != 1 || b->capacity() < len) continue;
+            // Pairs with the release of the last reference in the sender
+            std::atomic_thread_fence(std::memory_order_acquire);
+            b->resize(len);
+            return b;
+        }
+        m_misses++;
+        return std::make_shared<std::vector<uint8_t>>(len);
+    }
+
+    uint32_t misses() const { return m_misses; }     // take() that allocated
+    static constexpr size_t size() { return N; }
+
+private:
+    Buffer m_buf[N];
+    uint32_t m_misses = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================
+// Hardware abstraction layer
+// Everything the control logic (iologic) needs from the board,
+// as plain functions bound at link time - no vtables in the scan
+// cycle. Two implementations exist:
+//
+//   src/hal_esp32.cpp     inputcap, relaypulse/mcpport, s0counter,
+//                         esp_timer, Preferences, AsyncWebSocket
+//   native/hal_native.cpp virtual clock, scripted inputs, instant or
+//                         delayed relays, in-memory store (Linux,
+//                         pio run -e native)
+//
+// Relay requests complete asynchronously: the driver reports the
+// switched relay with iologic::onRelayDone(ch, on).
+//
+// Usage:
+//   int64_t now = hal::nowUs();
+//   hal::Edge e;
+//   while (hal::inputPop(e)) { ... }
+//   hal::relayBatch(true);  hal::relayRequest(3, true);  hal::relayBatch(false);
+//   size_t n = hal::storeRead("cfg", buf, sizeof(buf));
+//   hal::transportSend(0, json, len, false);    // 0 = all clients
+// ============================================================
+
+namespace hal {
+
+// --- Clock ---
+int64_t nowUs();                    // Monotonic microseconds since boot
+uint32_t cycles();                  // CPU cycle counter (nanoseconds on the host), wraps
+
+// --- GPIO input ---
+struct Edge {
+    int64_t tsUs;                   // nowUs() at the edge
+    uint8_t channel;
+    uint8_t level;                  // Level after the edge (0/1)
+};
+
+bool inputPop(Edge& e);             // Oldest captured edge (false if none)
+uint16_t inputLevels();             // Current raw levels, bit i = input i
+uint32_t inputDropped();            // Edges lost so far (capture overflow)
+
+// --- Relay driver (bistable coils) ---
+bool relayReady(uint8_t ch);        // Driver of the channel answers
+void relayRequest(uint8_t ch, bool on);
+bool relayTarget(uint8_t ch, bool current);   // State after pending requests
+void relayBatch(bool begin);        // Bracket requests that go out together
+
+// --- Top board buttons ---
+uint16_t buttonPresses();           // Debounced presses since the last call, bit i = button i
+
+// --- Pulse counter (S0 inputs) ---
+bool counterConfigure(uint8_t ch, bool enabled, uint16_t impPerKwh);   // true = hardware counter
+void counterEdge(uint8_t ch, bool level, int64_t tsUs);
+bool counterPoll(int64_t nowUs);    // true if totals / power changed
+uint64_t counterTotal(uint8_t ch);
+uint32_t counterPowerW(uint8_t ch);
+
+// --- Persistence (small blobs, flash on the board) ---
+size_t storeRead(const char* key, uint8_t* buf, size_t cap);   // 0 = missing
+bool storeWrite(const char* key, const uint8_t* buf, size_t len);
+
+// --- Transport (WebSocket on the board) ---
+void transportSend(uint32_t client, const uint8_t* data, size_t len, bool binary);   // client 0 = all
+
+} // namespace hal
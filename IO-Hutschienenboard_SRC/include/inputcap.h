@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// Input edge capture (GPIO ISR -> lock-free ring buffer)
+// Every level change on an input pin is recorded with its
+// esp_timer timestamp; the main logic drains the records.
+//
+// Usage:
+//   inputcap::begin(xTaskGetCurrentTaskHandle());
+//   // In loop():
+//   inputcap::Event ev;
+//   while (inputcap::pop(ev)) { ... }
+//   inputcap::wait(10);    // sleeps until next edge or timeout
+//
+// SIMULATE_HW: no ISRs are attached, edges are injected with
+//   inputcap::inject(ch, level);
+// ============================================================
+
+namespace inputcap {
+
+struct Event {
+    int64_t tsUs;       // esp_timer_get_time() at the edge
+    uint8_t channel;    // 0..NUM_CHANNELS-1
+    uint8_t level;      // pin level after the edge (0/1)
+};
+
+// Configure input pins and attach edge ISRs.
+// notifyTask (optional) gets a task notification for every captured edge.
+void begin(TaskHandle_t notifyTask = nullptr);
+
+// Pop the oldest captured edge (false if none pending)
+bool pop(Event& ev);
+
+// Block until an edge was captured or timeoutMs elapsed
+void wait(uint32_t timeoutMs);
+
+// Current raw pin levels of all channels (bit i = input i), one register read
+uint16_t levels();
+
+// Current raw pin level of a channel
+bool level(uint8_t ch);
+
+// Mute / unmute the edge ISR of a channel (pin counted by other hardware)
+void setIsrEnabled(uint8_t ch, bool enabled);
+
+// --- Statistics ---
+uint32_t droppedCount();    // Edges lost because the ring was full
+uint32_t pendingCount();    // Edges waiting in the ring
+
+#if SIMULATE_HW
+// Feed a synthetic edge into the ring (as if the ISR had fired)
+bool inject(uint8_t ch, bool level);
+#endif
+
+} // namespace inputcap
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include "pin_config.h"
+
+// ============================================================
+// Input conditioning for the S0 inputs
+// Works on the timestamped edges from inputcap, no extra polling.
+//
+// MODE_DC: dry contact. The first edge is taken at once, further
+//          edges are ignored for filterMs (bounce lockout). After the
+//          lockout the raw level is re-checked.
+// MODE_AC: 8 VAC through the optocoupler gives a 50 Hz pulse train.
+//          The input reads "on" from the first edge and stays on as
+//          long as edges keep coming; no edge for filterMs (missing
+//          pulse) -> "off". A steady high level also counts as on.
+//
+// Usage:
+//   inputfilter::reset(ch, rawLevel);
+//   inputfilter::configure(ch, inputfilter::MODE_AC, 0);  // 0 = default
+//   if (inputfilter::feed(ch, level, tsUs)) onChange(ch, inputfilter::state(ch));
+//   uint16_t changed = inputfilter::poll(nowUs);   // timeouts, call often
+// ============================================================
+
+namespace inputfilter {
+
+enum Mode : uint8_t {
+    MODE_DC = 0,
+    MODE_AC = 1,
+    MODE_COUNTER = 2,   // S0 meter, raw edges go to s0counter (not filtered here:
+                        // PCNT glitch filter on hardware units, none on the
+                        // edge fallback - S0 outputs are solid-state, no bounce)
+};
+
+static const uint16_t DC_DEFAULT_MS = 20;   // Bounce lockout
+static const uint16_t AC_DEFAULT_MS = 30;   // > one 50 Hz period
+static const uint16_t AC_MIN_MS     = 25;
+
+// Set mode and filter time (0 = default for the mode)
+void configure(uint8_t ch, Mode mode, uint16_t filterMs);
+Mode mode(uint8_t ch);
+uint16_t filterMs(uint8_t ch);          // Effective value
+
+// Force the conditioned state (e.g. at boot from the pin level)
+void reset(uint8_t ch, bool level);
+
+// Raw edge; returns true if the conditioned state changed
+bool feed(uint8_t ch, bool level, int64_t tsUs);
+
+// Time-based transitions (lockout end, AC timeout); returns changed mask
+uint16_t poll(int64_t nowUs);
+
+// Conditioned state
+bool state(uint8_t ch);
+uint16_t states();
+
+} // namespace inputfilter
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+#include "pin_config.h"
+#include "stateproto.h"
+#include "binproto.h"
+#include "rules.h"
+#include "procimage.h"
+
+// ============================================================
+// Control logic of the board (portable)
+// Input conditioning -> mapping (impulse switch) and rules
+// (rules.h) -> relays, auto-off timers and the command set of the
+// WebSocket protocols.
+// Talks to the hardware only through hal.h, so the same code runs
+// in the IO task on the ESP32 and in the native build on Linux
+// (benchmarks, simulation).
+//
+// Not thread-safe: the caller serializes scan() / execute() /
+// capture() (ioLock on the board). onRelayDone() and the auto-off
+// wakeup only set flags and arm timers. image() is lock-free: inputs
+// and committed outputs are published together as one atomic word.
+//
+// Usage:
+//   iologic::applyInputMode(ch);           // after loading the config
+//   iologic::begin();                      // once the relay driver runs
+//   // Every scan period:
+//   uint8_t fx = iologic::scan();          // FX_STATE: publish, FX_RELAY: LEDs
+//   // From a client:
+//   if (iologic::execute(cmd) & iologic::FX_CONFIG) markConfigDirty();
+//   iologic::capture(snap, hal::nowUs());
+// ============================================================
+
+namespace iologic {
+
+// --- Configuration ---
+extern int8_t inputMapping[NUM_CHANNELS];    // Input -> relay, -1 = none
+extern uint32_t autoOffSeconds[NUM_CHANNELS];   // 0 = off
+extern uint8_t inputMode[NUM_CHANNELS];      // inputfilter::Mode (DC / AC / S0)
+extern uint16_t inputFilterMs[NUM_CHANNELS]; // 0 = default of the mode
+extern uint16_t s0Imp[NUM_CHANNELS];         // S0 impulses per kWh (counter mode)
+extern char rulesText[RULES_TEXT_MAX];       // Source of the active rules
+
+// --- Effects reported by scan() / execute() ---
+enum Effect : uint8_t {
+    FX_STATE  = (1 << 0),   // Client-visible state changed
+    FX_RELAY  = (1 << 1),   // A relay switched
+    FX_CONFIG = (1 << 2),   // Configuration changed (persist it)
+};
+
+// Start the auto-off scheduler; timers restored after a warm reset
+// switch their relays back on
+void begin();
+
+void setRelay(uint8_t ch, bool on);
+void toggleRelay(uint8_t ch);
+
+// Push inputMode / inputFilterMs / s0Imp of a channel to the hardware
+void applyInputMode(uint8_t ch);
+
+// Compile and activate rules (copied to rulesText); on error the
+// active rules stay and err says why
+bool setRules(const char* text, rules::Error* err = nullptr);
+
+// Activate a table the caller compiled from text without the lock
+// (the long part); only the copy needs it
+void activateRules(const char* text, const rules::Program& p);
+
+struct RuleStats {
+    uint8_t  rows;          // Compiled rows
+    uint32_t avgCycles;     // Rule step per scan (smoothed), hal::cycles()
+    uint32_t maxCycles;
+};
+
+RuleStats ruleStats();
+
+// Relay driver: the relay has switched (any task)
+void onRelayDone(uint8_t ch, bool on);
+
+// One scan: drain input edges, filter timeouts, counters, top board
+// buttons, rules, auto-off
+uint8_t scan();
+
+// Command of the JSON / binary protocol; returns Effect bits
+uint8_t execute(const binproto::Command& c);
+
+uint32_t remainingAutoOff(uint8_t ch, int64_t nowUs);
+
+// Relays that are on with a running auto-off timer, bit i = relay i
+uint16_t timerMask();
+
+// Inputs / committed outputs from any task (edges are scan-internal, 0 here)
+procimage::Image image();
+
+// I/O part of the snapshot (mcp, ntp and time are up to the caller)
+void capture(stateproto::Snapshot& s, int64_t nowUs);
+
+} // namespace iologic
@@ -0,0 +1,120 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+// ============================================================
+// Argument packing for tokenized (deferred-format) log records
+// The format string is not sent, only its address; the host tool
+// (tools/logdecode.py) looks it up in the firmware ELF and walks
+// its conversions to consume the packed arguments:
+//
+//   integer / enum / bool / char  <= 32 bit   4 bytes LE
+//   %ll.. / 64-bit integer                    8 bytes LE
+//   %f %e %g (float/double)                   8 bytes IEEE double
+//   %s                                        bytes + NUL (max DBG_TOK_STR_MAX)
+//   %p                                        4 bytes
+//
+// Packing stops at the first argument that does not fit; the record
+// then carries DBG_TOK_TRUNCATED in its level byte and the decoders
+// show the missing arguments as "<?>" plus a " <...>" marker.
+//
+// Usage:
+//   tok::Packer pk;
+//   tok::packAll(pk, ch, "SET", esp_timer_get_time());
+//   // pk.buf / pk.len -> record payload
+// ============================================================
+
+#define DBG_TOK_ARGS_MAX 96     // Packed argument bytes per record
+#define DBG_TOK_STR_MAX  48     // Per %s argument, incl. NUL
+#define DBG_TOK_TRUNCATED 0x80  // Level byte flag: trailing arguments dropped
+
+// Tokenized frame: sync, payload length, header, args, checksum
+#define DBG_TOK_SYNC0 0xA5
+#define DBG_TOK_SYNC1 0x5A
+#define DBG_TOK_FRAME_HDR 18    // Sync, length and header before the args
+#define DBG_TOK_FRAME_MAX (DBG_TOK_FRAME_HDR + DBG_TOK_ARGS_MAX + 1)
+
+namespace tok {
+
+struct Packer {
+    uint8_t buf[DBG_TOK_ARGS_MAX];
+    uint8_t len = 0;
+    bool    truncated = false;     // Set at the first argument that did not fit
+
+    void put(const void* p, size_t n) {
+        if (truncated || len + n > sizeof(buf)) {
+            truncated = true;
+            return;
+        }
+        memcpy(buf + len, p, n);
+        len += (uint8_t)n;
+    }
+};
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+pack(Packer& pk, T v) {
+    if (sizeof(T) > 4) {
+        const uint64_t w = (uint64_t)v;
+        pk.put(&w, 8);
+    } else {
+        const uint32_t w = (uint32_t)v;
+        pk.put(&w, 4);
+    }
+}
+
+inline void pack(Packer& pk, double v) {
+    pk.put(&v, 8);
+}
+
+inline void pack(Packer& pk, const char* s) {
+    if (!s) s = "(null)";
+    size_t n = 0;               // strnlen() warns on short literals (-Wstringop-overread)
+    while (n < DBG_TOK_STR_MAX - 1 && s[n]) n++;
+    if (pk.truncated || pk.len + n + 1 > sizeof(pk.buf)) {
+        pk.truncated = true;
+        return;
+    }
+    pk.put(s, n);
+    const uint8_t nul = 0;
+    pk.put(&nul, 1);
+}
+
+inline void pack(Packer& pk, const void* p) {
+    const uint32_t w = (uint32_t)(uintptr_t)p;
+    pk.put(&w, 4);
+}
+
+inline void packAll(Packer&) {}
+
+template <typename T, typename... Rest>
+inline void packAll(Packer& pk, T v, Rest... rest) {
+    pack(pk, v);
+    packAll(pk, rest...);
+}
+
+// Binary frame for tools/logdecode.py (little-endian):
+//   A5 5A | len | fmt u32 | sec u32 | ms u32 | lvl u8 | cat u16 | args[len] | sum u8
+// lvl bit 7 (DBG_TOK_TRUNCATED): arguments after args[len] were dropped.
+// f needs DBG_TOK_FRAME_HDR + len + 1 bytes; returns the frame length.
+inline size_t encodeFrame(uint8_t* f, const char* fmt, uint32_t sec, uint32_t ms, uint8_t lvl,
+                          uint16_t cat, const uint8_t* args, uint8_t len, bool truncated) {
+    const uint32_t addr = (uint32_t)(uintptr_t)fmt;
+    f[0] = DBG_TOK_SYNC0;
+    f[1] = DBG_TOK_SYNC1;
+    f[2] = len;
+    memcpy(f + 3, &addr, 4);
+    memcpy(f + 7, &sec, 4);
+    memcpy(f + 11, &ms, 4);
+    f[15] = (uint8_t)(lvl | (truncated ? DBG_TOK_TRUNCATED : 0));
+    memcpy(f + 16, &cat, 2);
+    memcpy(f + DBG_TOK_FRAME_HDR, args, len);
+    uint8_t sum = 0;
+    for (size_t i = 3; i < DBG_TOK_FRAME_HDR + (size_t)len; i++) sum += f[i];
+    f[DBG_TOK_FRAME_HDR + len] = sum;
+    return DBG_TOK_FRAME_HDR + len + 1;
+}
+
+} // namespace tok
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// MCP23017 port driver with shadow output latches
+// Pin writes only change a shadow copy of OLATA/OLATB; flush()
+// sends every changed chip as ONE sequential 16-bit write.
+//
+// Usage:
+//   mcpport::begin(Wire);
+//   mcpport::addOutputChip(0, 0x20);
+//   mcpport::write(0, 3, HIGH);         // staged only
+//   mcpport::write(0, 11, LOW);
+//   mcpport::flush();                    // 1 I2C transaction
+//
+//   mcpport::hold();                     // collect across several
+//   ... writes + flush() calls ...       // callers, e.g. "alloff"
+//   mcpport::release();                  // flushes once
+//
+//   mcpport::addInputChip(2, 0x22, 0x0FFF);   // buttons, INT on change
+//   mcpport::readRegs(2, mcpport::REG_INTFA, buf, 6);   // INTF, INTCAP, GPIO
+//
+// SIMULATE_HW: all transactions go to an in-memory mock bus.
+// ============================================================
+
+#define MCP_MAX_CHIPS 4
+
+namespace mcpport {
+
+// --- MCP23017 registers (IOCON.BANK = 0) ---
+enum Reg : uint8_t {
+    REG_IODIRA   = 0x00,
+    REG_IPOLA    = 0x02,
+    REG_GPINTENA = 0x04,
+    REG_DEFVALA  = 0x06,
+    REG_INTCONA  = 0x08,
+    REG_IOCON    = 0x0A,
+    REG_GPPUA    = 0x0C,
+    REG_INTFA    = 0x0E,
+    REG_INTCAPA  = 0x10,
+    REG_GPIOA    = 0x12,
+    REG_OLATA    = 0x14,
+};
+
+// Initialize the bus (Wire must be started by the caller)
+void begin(TwoWire& wire);
+
+// Probe chip and configure all 16 pins as outputs, driven LOW
+bool addOutputChip(uint8_t chip, uint8_t addr);
+
+// Probe chip and configure all 16 pins as inputs with pull-up; the
+// pins in mask read inverted (pressed = 1) and interrupt on change.
+// INTA/INTB are mirrored and open drain, so both may share one GPIO.
+bool addInputChip(uint8_t chip, uint8_t addr, uint16_t mask);
+bool ready(uint8_t chip);
+
+// --- Shadow latch ---
+void write(uint8_t chip, uint8_t pin, bool level);      // pin 0-15
+void writeMask(uint8_t chip, uint16_t mask, uint16_t bits);
+uint16_t latch(uint8_t chip);
+
+// Send all changed latches (one transaction per dirty chip)
+bool flush();
+
+// Defer flush() until the matching release()
+void hold();
+void release();
+
+// --- Raw register access (sequential, counted) ---
+bool writeRegs(uint8_t chip, uint8_t reg, const uint8_t* data, uint8_t len);
+bool readRegs(uint8_t chip, uint8_t reg, uint8_t* data, uint8_t len);
+
+// --- Statistics ---
+uint32_t txCount();      // I2C transactions since boot
+uint32_t errorCount();   // Failed (NACK) transactions
+
+} // namespace mcpport
@@ -11,21 +11,51 @@
 //   12 Bistable Relays -> 2x MCP23017 via I2C (24 outputs: SET + RESET per relay)
 //
 // MCP23017 #1 (0x20): Relay 1-8 SET (GPA0-7) + Relay 1-8 RESET (GPB0-7)
-// MCP23017 #2 (0x21): Relay 9-12 SET (GPA0-3) + Relay 9-12 RESET (GPB0-3)
+// MCP23017 #2 (0x23): Relay 9-12 SET (GPA0-3) + Relay 9-12 RESET (GPB0-3)
 //                      GPA4-7, GPB4-7 = 8 spare I/Os for future use
 //
+// Top board (J202):
+//   MCP23017 #3 (0x22): Button 1-8 (GPA0-7) + Button 9-12 (GPB0-3),
+//                       INTA/INTB -> GPIO13
+//   MCP23017 #4 (0x21): LED 1-8 (GPA0-7) + LED 9-12 (GPB0-3), high = on
+//
 // ============================================================
 
 // --- I2C Bus for MCP23017 ---
 static const uint8_t I2C_SDA_PIN = 11;
 static const uint8_t I2C_SCL_PIN = 12;
 
-// --- MCP23017 I2C Addresses ---
-static const uint8_t MCP_ADDR_1 = 0x20;  // Relay 1-8
-static const uint8_t MCP_ADDR_2 = 0x21;  // Relay 9-12
+// --- MCP23017 board map ---
+// Slot = mcpport chip index; address = 0x20 + A2..A0 straps
+enum McpSlot : uint8_t {
+    MCP_RELAY_1 = 0,    // Relay 1-8
+    MCP_RELAY_2 = 1,    // Relay 9-12
+    MCP_BUTTONS = 2,    // Top board buttons
+    MCP_LEDS    = 3,    // Top board status LEDs
+    MCP_SLOTS   = 4,
+};
+
+static constexpr uint8_t MCP_ADDR[MCP_SLOTS] = {
+    0x20,   // MCP_RELAY_1
+    0x23,   // MCP_RELAY_2 (0x21 belongs to the top board LEDs)
+    0x22,   // MCP_BUTTONS
+    0x21,   // MCP_LEDS
+};
+
+constexpr bool mcpAddrsValid(uint8_t i = 0, uint8_t j = 1) {
+    return i >= MCP_SLOTS ? true :
+           j >= MCP_SLOTS ? (MCP_ADDR[i] & 0xF8) == 0x20 && mcpAddrsValid((uint8_t)(i + 1), (uint8_t)(i + 2)) :
+           MCP_ADDR[i] != MCP_ADDR[j] && mcpAddrsValid(i, (uint8_t)(j + 1));
+}
+static_assert(mcpAddrsValid(), "MCP_ADDR: address outside 0x20-0x27 or used twice");
+
+// --- Top board buttons ---
+// Button i on MCP pin i, closes to GND; INTA/INTB mirrored (open drain)
+static const uint8_t BUTTON_INT_PIN = 13;      // J202 pin 5 (R248)
 
 // --- 12 Digital Inputs (from optocoupler outputs, directly on ESP32) ---
-static const uint8_t INPUT_PINS[12] = {
+// constexpr: pinmap.h derives the register -> channel permutation from it
+static constexpr uint8_t INPUT_PINS[12] = {
     4,   // GPIO4  - Input 1
     5,   // GPIO5  - Input 2
     6,   // GPIO6  - Input 3
@@ -42,28 +72,28 @@ static const uint8_t INPUT_PINS[12] = {
 
 // --- Relay Pin Mapping on MCP23017 ---
 // Each relay has a SET pin and RESET pin on the MCP23017
-// Format: {mcp_index (0 or 1), set_pin (0-15), reset_pin (0-15)}
+// Format: {mcp slot, set_pin (0-15), reset_pin (0-15)}
 struct RelayPinDef {
-    uint8_t mcpIndex;   // 0 = MCP_ADDR_1, 1 = MCP_ADDR_2
+    uint8_t mcpIndex;   // MCP_RELAY_1 / MCP_RELAY_2
     uint8_t setPin;     // MCP23017 pin number (0-15, 0-7=GPA, 8-15=GPB)
     uint8_t resetPin;   // MCP23017 pin number
 };
 
 static const RelayPinDef RELAY_PINS[12] = {
     // MCP23017 #1 (0x20): Relays 1-8
-    {0,  0,  8},  // Relay 1:  SET=GPA0, RESET=GPB0
-    {0,  1,  9},  // Relay 2:  SET=GPA1, RESET=GPB1
-    {0,  2, 10},  // Relay 3:  SET=GPA2, RESET=GPB2
-    {0,  3, 11},  // Relay 4:  SET=GPA3, RESET=GPB3
-    {0,  4, 12},  // Relay 5:  SET=GPA4, RESET=GPB4
-    {0,  5, 13},  // Relay 6:  SET=GPA5, RESET=GPB5
-    {0,  6, 14},  // Relay 7:  SET=GPA6, RESET=GPB6
-    {0,  7, 15},  // Relay 8:  SET=GPA7, RESET=GPB7
-    // MCP23017 #2 (0x21): Relays 9-12
-    {1,  0,  8},  // Relay 9:  SET=GPA0, RESET=GPB0
-    {1,  1,  9},  // Relay 10: SET=GPA1, RESET=GPB1
-    {1,  2, 10},  // Relay 11: SET=GPA2, RESET=GPB2
-    {1,  3, 11},  // Relay 12: SET=GPA3, RESET=GPB3
+    {MCP_RELAY_1, 0,  8},  // Relay 1:  SET=GPA0, RESET=GPB0
+    {MCP_RELAY_1, 1,  9},  // Relay 2:  SET=GPA1, RESET=GPB1
+    {MCP_RELAY_1, 2, 10},  // Relay 3:  SET=GPA2, RESET=GPB2
+    {MCP_RELAY_1, 3, 11},  // Relay 4:  SET=GPA3, RESET=GPB3
+    {MCP_RELAY_1, 4, 12},  // Relay 5:  SET=GPA4, RESET=GPB4
+    {MCP_RELAY_1, 5, 13},  // Relay 6:  SET=GPA5, RESET=GPB5
+    {MCP_RELAY_1, 6, 14},  // Relay 7:  SET=GPA6, RESET=GPB6
+    {MCP_RELAY_1, 7, 15},  // Relay 8:  SET=GPA7, RESET=GPB7
+    // MCP23017 #2 (0x23): Relays 9-12
+    {MCP_RELAY_2, 0,  8},  // Relay 9:  SET=GPA0, RESET=GPB0
+    {MCP_RELAY_2, 1,  9},  // Relay 10: SET=GPA1, RESET=GPB1
+    {MCP_RELAY_2, 2, 10},  // Relay 11: SET=GPA2, RESET=GPB2
+    {MCP_RELAY_2, 3, 11},  // Relay 12: SET=GPA3, RESET=GPB3
 };
 
 // Bistable relay pulse duration in milliseconds
@@ -73,5 +103,5 @@ static const uint16_t RELAY_PULSE_MS = 50;
 static const uint8_t NUM_CHANNELS = 12;
 
 // --- Free ESP32 GPIOs (not used, available for future expansion) ---
-// GPIO0, 1, 2, 13, 14, 21, 35, 36, 37, 38, 39, 40, 41, 42, 45, 46, 47, 48
-// = 18 spare pins!
+// GPIO0, 1, 2, 14, 21, 35, 36, 37, 38, 39, 40, 41, 42, 45, 46, 47, 48
+// = 17 spare pins (GPIO13 = button interrupt)
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include "pin_config.h"
+
+// ============================================================
+// Input pins -> channel bits, resolved at compile time
+// gather() turns the GPIO IN registers (GPIO0-31, GPIO32-48) into
+// the input mask (bit i = input i). Inputs whose pin and channel
+// differ by the same offset move together with one shift and one
+// AND; the offsets and masks come from INPUT_PINS at compile time,
+// unused offsets fold away. With the current pinout that is five
+// shift/AND pairs for 12 inputs instead of 12 single-bit reads.
+//
+// Usage:
+//   uint16_t in = pinmap::gather(REG_READ(GPIO_IN_REG),
+//                                pinmap::USES_IN1 ? REG_READ(GPIO_IN1_REG) : 0);
+// ============================================================
+
+namespace pinmap {
+
+// Inputs on GPIO register reg (0 = GPIO0-31, 1 = GPIO32-63) with pin - channel == shift
+constexpr uint32_t groupMask(uint8_t reg, int shift, uint8_t i = 0) {
+    return i >= NUM_CHANNELS ? 0 :
+        ((((INPUT_PINS[i] >> 5) == reg && (int)(INPUT_PINS[i] & 31) - (int)i == shift) ? (1u << i) : 0) |
+         groupMask(reg, shift, (uint8_t)(i + 1)));
+}
+
+constexpr bool usesRegister(uint8_t reg, uint8_t i = 0) {
+    return i < NUM_CHANNELS && ((INPUT_PINS[i] >> 5) == reg || usesRegister(reg, (uint8_t)(i + 1)));
+}
+
+constexpr bool pinsUnique(uint8_t i = 0, uint8_t j = 1) {
+    return i >= NUM_CHANNELS ? true :
+           j >= NUM_CHANNELS ? pinsUnique((uint8_t)(i + 1), (uint8_t)(i + 2)) :
+           INPUT_PINS[i] != INPUT_PINS[j] && pinsUnique(i, (uint8_t)(j + 1));
+}
+
+static_assert(NUM_CHANNELS <= 16, "Input mask is 16 bits");
+static_assert(pinsUnique(), "INPUT_PINS: pin used twice");
+
+static constexpr bool USES_IN1 = usesRegister(1);   // Any input on GPIO32+
+
+// One shift/AND group per offset, SHIFT counting down to the end marker
+template <uint8_t REG, int SHIFT>
+struct Gather {
+    static inline uint32_t apply(uint32_t in) {
+        return (((in >> (SHIFT > 0 ? SHIFT : 0)) << (SHIFT < 0 ? -SHIFT : 0)) & groupMask(REG, SHIFT)) |
+               Gather<REG, SHIFT - 1>::apply(in);
+    }
+};
+
+template <uint8_t REG>
+struct Gather<REG, -16> {
+    static inline uint32_t apply(uint32_t) { return 0; }
+};
+
+// GPIO IN registers -> input mask
+inline uint16_t gather(uint32_t in0, uint32_t in1) {
+    return (uint16_t)(Gather<0, 31>::apply(in0) | Gather<1, 31>::apply(in1));
+}
+
+} // namespace pinmap
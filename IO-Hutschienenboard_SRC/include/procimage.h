@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================
+// Process image of the scan cycle (PLC style)
+// Inputs, outputs and the input edges of one scan as channel
+// bitmasks (bit i = channel i). Edges are computed for all
+// channels at once from the input image before and after the
+// scan; a channel that changed and changed back within the scan
+// (changed bit set, level unchanged) counts as both edges.
+//
+// Inputs and outputs are published as one 32-bit word, so
+// readers in other tasks (JSON, LEDs) always see a consistent
+// pair without taking the I/O lock.
+//
+// Usage:
+//   procimage::Image img;
+//   img.in = newInputs;                 // after draining the edges
+//   procimage::latchEdges(img, prevIn, changed);
+//   if (img.rise & (1 << 3)) ...
+//   uint32_t word = procimage::pack(img.in, img.out);
+// ============================================================
+
+namespace procimage {
+
+struct Image {
+    uint16_t in;        // Conditioned inputs
+    uint16_t out;       // Committed relay states
+    uint16_t rise;      // Inputs that went on during the scan
+    uint16_t fall;      // Inputs that went off during the scan
+};
+
+// prev: inputs at the start of the scan, changed: inputs that changed at least once
+inline void latchEdges(Image& img, uint16_t prev, uint16_t changed) {
+    const uint16_t diff = (uint16_t)(img.in ^ prev);
+    const uint16_t pulse = (uint16_t)(changed & ~diff);     // Went and came back
+    img.rise = (uint16_t)((diff & img.in) | pulse);
+    img.fall = (uint16_t)((diff & ~img.in) | pulse);
+}
+
+inline uint32_t pack(uint16_t in, uint16_t out) {
+    return (uint32_t)in | ((uint32_t)out << 16);
+}
+
+inline uint16_t inputsOf(uint32_t word) {
+    return (uint16_t)word;
+}
+
+inline uint16_t outputsOf(uint32_t word) {
+    return (uint16_t)(word >> 16);
+}
+
+} // namespace procimage
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// Non-blocking pulse scheduler for the bistable relays
+// request() energizes the SET/RESET coil and returns at once,
+// an esp_timer callback releases the coil after the pulse width.
+// Pulses of different relays run in parallel.
+//
+// Usage:
+//   relaypulse::begin(driveCoil, flushCoils, pulseDone);
+//   relaypulse::request(ch, true);      // SET pulse on channel ch
+//
+// driveCoil(ch, on, active) is called with active=true at pulse start
+// and active=false at pulse end; flushCoils() after each group of
+// driveCoil() calls, pulseDone(ch, on) once the coil is released.
+// All run outside any lock, pulse ends in the esp_timer task.
+// ============================================================
+
+namespace relaypulse {
+
+typedef void (*DriveFn)(uint8_t ch, bool on, bool active);
+typedef void (*FlushFn)();
+typedef void (*DoneFn)(uint8_t ch, bool on);
+
+struct Stats {
+    uint8_t  depth;      // Pulses running + queued right now
+    uint8_t  maxDepth;   // High-water mark of depth
+    uint32_t pulses;     // Pulses completed
+    uint32_t overruns;   // Queued requests replaced by a newer one
+};
+
+void begin(DriveFn drive, FlushFn flush, DoneFn done, uint16_t pulseMs = 50);
+
+// Start (or queue, if the channel is still pulsing) a SET/RESET pulse
+void request(uint8_t ch, bool on);
+
+// Channel has a pulse running or queued
+bool busy(uint8_t ch);
+
+// State the channel will have once all pulses completed
+bool target(uint8_t ch, bool current);
+
+Stats getStats();
+
+} // namespace relaypulse
@@ -0,0 +1,148 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// ============================================================
+// Lock-free ring buffers (header-only)
+//
+// SpscRing: single producer / single consumer, fixed capacity.
+//   Producer may be an ISR, consumer a task (or vice versa).
+//   Capacity N must be a power of two; one slot is NOT wasted,
+//   head/tail are free-running counters.
+//
+// Usage:
+//   static SpscRing<Event, 64> ring;
+//   ring.push(ev);           // ISR / producer side
+//   while (ring.pop(ev)) {}  // task / consumer side
+//
+// MpmcRing: multi producer / multi consumer, bounded (Vyukov).
+//   Tasks only (no ISR). The payload lives in caller-provided
+//   storage (e.g. PSRAM); the sequence counters stay in the
+//   object, i.e. in internal RAM where atomics are safe.
+//   discard() drops the oldest item, for drop-oldest producers.
+//
+// Usage:
+//   static MpmcRing<Record, 128> ring;
+//   ring.attach((Record*)heap_caps_malloc(128 * sizeof(Record), MALLOC_CAP_SPIRAM));
+//   while (!ring.push(rec)) ring.discard();   // drop oldest on overflow
+//   while (ring.pop(rec)) {}
+// ============================================================
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing: N must be a power of two");
+
+public:
+    // Producer side. Returns false if the ring is full (item not stored).
+    bool push(const T& item) {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        const uint32_t tail = m_tail.load(std::memory_order_acquire);
+        if ((uint32_t)(head - tail) >= N) return false;
+        m_buf[head & (N - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T& item) {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint32_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail) return false;
+        item = m_buf[tail & (N - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return (size_t)(uint32_t)(m_head.load(std::memory_order_acquire) -
+                                  m_tail.load(std::memory_order_acquire));
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T m_buf[N];
+    std::atomic<uint32_t> m_head{0};
+    std::atomic<uint32_t> m_tail{0};
+};
+
+template <typename T, size_t N>
+class MpmcRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "MpmcRing: N must be a power of two");
+
+public:
+    MpmcRing() {
+        for (size_t i = 0; i < N; i++) m_seq[i].store(i, std::memory_order_relaxed);
+    }
+
+    // Storage for N items; must be set before the first push/pop
+    void attach(T* storage) { m_buf = storage; }
+    bool ready() const { return m_buf != nullptr; }
+
+    // Returns false if the ring is full (item not stored)
+    bool push(const T& item) {
+        size_t pos = m_enq.load(std::memory_order_relaxed);
+        for (;;) {
+            const size_t seq = m_seq[pos & (N - 1)].load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_enq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_enq.load(std::memory_order_relaxed);
+            }
+        }
+        m_buf[pos & (N - 1)] = item;
+        m_seq[pos & (N - 1)].store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the ring is empty
+    bool pop(T& item) {
+        size_t pos;
+        if (!claim(pos)) return false;
+        item = m_buf[pos & (N - 1)];
+        m_seq[pos & (N - 1)].store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    // Drop the oldest item without copying it out
+    bool discard() {
+        size_t pos;
+        if (!claim(pos)) return false;
+        m_seq[pos & (N - 1)].store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        const size_t deq = m_deq.load(std::memory_order_acquire);   // First: enq >= deq
+        return m_enq.load(std::memory_order_acquire) - deq;
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    bool claim(size_t& pos) {
+        pos = m_deq.load(std::memory_order_relaxed);
+        for (;;) {
+            const size_t seq = m_seq[pos & (N - 1)].load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (m_deq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return true;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_deq.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    T* m_buf = nullptr;
+    std::atomic<size_t> m_seq[N];
+    std::atomic<size_t> m_enq{0};
+    std::atomic<size_t> m_deq{0};
+};
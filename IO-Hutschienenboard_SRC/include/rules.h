@@ -0,0 +1,102 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "pin_config.h"
+
+// ============================================================
+// Input -> output rule engine
+// Rules are written as text, compiled once (on save / at boot)
+// into a flat table of channel bitmasks and evaluated every scan
+// against the input and output images: a fixed number of AND /
+// OR / XOR operations per row, no parsing, no per-channel loops.
+//
+// Language (channels 1-based, ';' or newline separate rules,
+// '#' starts a comment, A1-A4 is a range):
+//
+//   E1 -> toggle A1 A2             impulse switch for two relays
+//   E2 | E3 -> stair 120 A5        stairwell light, each press restarts 120 s
+//   E12 -> off A1-A12              central off
+//   E9 -> on A1 A3, off A2         scene
+//   E4 -> on A6 if E5 & !E6        edge rule with an input condition
+//   E7 -> on A7 unless A8          interlock: not while A8 is on
+//   A10 = E10 & E11                output follows the inputs (AND)
+//   A11 = E10 | E11 unless A10     ... (OR) with interlock
+//
+// Edge rules fire on the rising edge of any trigger input, level
+// rules ('=') every scan. Rows run in text order on one output
+// image, so a later rule sees (and can override) an earlier one;
+// "unless" tests that image. The plain input mapping (inputMapping)
+// still works next to the rules.
+//
+// Usage:
+//   rules::Program p;
+//   rules::Error err;
+//   if (!rules::compile(text, p, &err)) printf("%s at %u", err.msg, err.pos);
+//   rules::Mask stair = 0;
+//   rules::Mask next = rules::evaluate(p.row, p.rows, in, rise, out, stair);
+//   // next ^ out: relays to switch, stair: (re)start p.stairSecs[ch]
+// ============================================================
+
+#define RULES_MAX      24      // Compiled rows
+#define RULES_TEXT_MAX 512     // Source text incl. NUL (stored in the config blob)
+
+namespace rules {
+
+// One compiled rule; M holds one bit per channel
+template <typename M>
+struct BasicRow {
+    M trig;         // Rising edge of any of these inputs, 0 = level rule
+    M inAll;        // Inputs that must be on
+    M inNone;       // Inputs that must be off
+    M inAny;        // At least one of these on (0 = no OR term)
+    M outNone;      // Interlock: outputs that must be off
+    M tog;          // Actions when the row fires
+    M set;
+    M clr;
+    M stair;        // Switched on, auto-off (re)started
+    M follow;       // Level rule: on while the condition holds, else off
+};
+
+// One pass over the rows. in: conditioned inputs, rise: rising
+// edges since the last pass, out: output image (incl. pending
+// requests). Returns the new output image; stair collects the
+// outputs whose stairwell timer restarts.
+template <typename M>
+M evaluate(const BasicRow<M>* row, uint8_t rows, M in, M rise, M out, M& stair) {
+    M next = out;
+    for (uint8_t k = 0; k < rows; k++) {
+        const BasicRow<M>& r = row[k];
+        // '&' / '|' on purpose: no branches on the image data
+        const bool cond = (((rise & r.trig) != 0) | (r.trig == 0)) &
+                          ((in & r.inAll) == r.inAll) & ((in & r.inNone) == 0) &
+                          (((in & r.inAny) != 0) | (r.inAny == 0)) & ((next & r.outNone) == 0);
+        const M fire = (M)0 - (M)cond;
+        next ^= r.tog & fire;
+        next |= (r.set | r.stair) & fire;
+        next &= ~(r.clr & fire);
+        next = (next & ~r.follow) | (r.follow & fire);
+        stair |= r.stair & fire;
+    }
+    return next;
+}
+
+typedef uint16_t Mask;
+typedef BasicRow<Mask> Row;
+
+static_assert(NUM_CHANNELS <= sizeof(Mask) * 8, "rules::Mask too narrow for NUM_CHANNELS");
+
+struct Program {
+    uint8_t  rows;
+    Row      row[RULES_MAX];
+    uint16_t stairSecs[NUM_CHANNELS];   // Stairwell time per output
+};
+
+struct Error {
+    uint16_t    pos;        // Byte offset in the text
+    const char* msg;        // German, static
+};
+
+// Text -> table; on error p is empty and err says where
+bool compile(const char* text, Program& p, Error* err = nullptr);
+
+} // namespace rules
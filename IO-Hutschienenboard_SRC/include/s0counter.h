@@ -0,0 +1,80 @@
+#pragma once
+#include <Arduino.h>
+#include "pin_config.h"
+
+// ============================================================
+// S0 energy meter counting
+// Channels in counter mode count rising edges (one edge = one
+// meter impulse). The first S0_PCNT_UNITS counter channels are
+// counted by the ESP32-S3 PCNT hardware (glitch filter on, edge
+// ISR muted); further channels fall back to the inputcap edges.
+//
+// Totals are 64-bit and kept in NVS (namespace "s0-count"),
+// written every S0_PERSIST_MS when changed and before a restart.
+// NVS writes stall for milliseconds: the changed totals are taken
+// under the IO lock, written after it is released.
+// Power follows from the interval between impulses:
+//   W = 3600 s/h * 1000 / (interval_s * impulses_per_kWh)
+// Without new impulses the value decays as if the next one
+// were just arriving (upper bound of the real load).
+//
+// Usage:
+//   s0counter::begin();                        // after inputcap::begin()
+//   s0counter::configure(ch, true, 1000);      // 1000 imp/kWh
+//   // In the IO scan cycle:
+//   if (ev is on a counter channel) s0counter::onEdge(ev.channel, ev.level, ev.tsUs);
+//   if (s0counter::poll(esp_timer_get_time())) stateChanged = true;
+//   // In a low-priority task:
+//   s0counter::Pending p;
+//   take ioLock; bool due = s0counter::takeChanged(p); give ioLock;
+//   if (due && !s0counter::write(p)) { take ioLock; s0counter::writeFailed(p); give ioLock; }
+//   // Before a restart: takeChanged(p, true)
+//
+// SIMULATE_HW: no PCNT, all counter channels use the edge path.
+// ============================================================
+
+#ifndef S0_PERSIST_MS
+#define S0_PERSIST_MS (15UL * 60UL * 1000UL)   // NVS write interval for totals
+#endif
+
+#define S0_PCNT_UNITS 4         // PCNT units of the ESP32-S3
+
+namespace s0counter {
+
+static const uint16_t IMP_DEFAULT = 1000;   // Impulses per kWh
+
+// Load totals from NVS
+void begin();
+
+// Enable / disable counter mode; returns true if a PCNT unit counts the channel
+bool configure(uint8_t ch, bool enabled, uint16_t impPerKwh);
+bool enabled(uint8_t ch);
+bool hardware(uint8_t ch);      // PCNT (true) or edge fallback (false)
+uint16_t impPerKwh(uint8_t ch);
+
+// Raw edge of a fallback channel (ignored for PCNT channels)
+void onEdge(uint8_t ch, bool level, int64_t tsUs);
+
+// Read PCNT, update power; true if totals/power changed
+bool poll(int64_t nowUs);
+
+uint64_t total(uint8_t ch);     // Impulses since commissioning
+uint32_t powerW(uint8_t ch);
+
+// Totals not yet in NVS
+struct Pending {
+    uint16_t mask;                      // Channels to write
+    uint64_t total[NUM_CHANNELS];
+};
+
+// IO lock held: changed totals into p, every S0_PERSIST_MS (force: now);
+// false = nothing to write
+bool takeChanged(Pending& p, bool force = false);
+
+// No lock: NVS writes; false = failed
+bool write(const Pending& p);
+
+// IO lock held: after a failed write(), p goes out with the next take
+void writeFailed(const Pending& p);
+
+} // namespace s0counter
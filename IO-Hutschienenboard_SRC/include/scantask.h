@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// Fixed-period scan task (PLC-style cycle)
+// Runs one cycle function every periodMs on a pinned core,
+// scheduled with xTaskDelayUntil so the period does not drift
+// with the cycle time. Cycle time, start jitter and overruns
+// are measured with esp_timer.
+//
+// Usage:
+//   scantask::begin(ioCycle, 2, APP_CPU_NUM, 10);
+//   scantask::Stats st = scantask::getStats();
+//
+// An overrun is a cycle that took longer than the period; the
+// schedule is then re-based instead of running cycles back-to-back.
+// ============================================================
+
+namespace scantask {
+
+typedef void (*CycleFn)();
+
+struct Stats {
+    uint32_t periodUs;      // Configured period
+    uint32_t lastUs;        // Execution time of the last cycle
+    uint32_t avgUs;         // Smoothed execution time
+    uint32_t maxUs;         // Longest cycle
+    uint32_t jitterMaxUs;   // Largest start deviation from the schedule
+    uint32_t overruns;      // Cycles longer than the period
+    uint32_t cycles;
+};
+
+bool begin(CycleFn fn, uint32_t periodMs, BaseType_t core, UBaseType_t priority,
+           uint32_t stackSize = 6144);
+
+Stats getStats();
+
+// Clear max values (cycle time, jitter)
+void resetMax();
+
+} // namespace scantask
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "pin_config.h"
+
+// ============================================================
+// WebSocket state protocol
+// Every frame carries a sequence number "seq". A full snapshot
+// ("full":true, arrays) is sent on connect and on request
+// ({"cmd":"resync"}); afterwards only changed fields/channels go
+// out as deltas, per-channel fields as {"<index>": value}.
+//
+//   full : {"seq":7,"full":true,"inputs":[...],"outputs":[...],...}
+//   delta: {"seq":8,"inputs":{"3":true},"outputs":{"5":false}}
+//
+// A client that sees a seq gap sends {"cmd":"resync"}.
+//
+// JSON is written straight into a caller-provided buffer (no heap):
+//   char buf[STATE_JSON_MAX];
+//   stateproto::JsonWriter w(buf, sizeof(buf));
+//   w.beginObject();
+//   stateproto::writeFull(w, snap, seq);
+//   w.key("sim"); w.addBool(true);      // caller-specific extras
+//   w.endObject();
+//   if (w.ok()) send(buf, w.length());
+// ============================================================
+
+#define STATE_JSON_MAX 1536
+
+namespace stateproto {
+
+// --- Complete board state as seen by the clients ---
+struct Snapshot {
+    uint16_t inputs;                       // bit i = input i
+    uint16_t outputs;                      // bit i = relay i
+    int8_t   mappings[NUM_CHANNELS];
+    uint32_t timers[NUM_CHANNELS];         // Auto-off seconds
+    uint32_t remaining[NUM_CHANNELS];      // Seconds until auto-off
+    uint8_t  inModes[NUM_CHANNELS];        // inputfilter::Mode
+    uint16_t inFilterMs[NUM_CHANNELS];     // Effective debounce / AC window
+    uint64_t counts[NUM_CHANNELS];         // S0 impulse totals
+    uint32_t power[NUM_CHANNELS];          // S0 power in W
+    uint16_t s0Imp[NUM_CHANNELS];          // S0 impulses per kWh
+    uint8_t  mcp;                          // bit m = MCP23017 #m ready
+    bool     ntp;
+    char     time[24];
+};
+
+// --- Changed-field mask ---
+enum Field : uint16_t {
+    F_INPUTS    = (1 << 0),
+    F_OUTPUTS   = (1 << 1),
+    F_MAPPINGS  = (1 << 2),
+    F_TIMERS    = (1 << 3),
+    F_REMAINING = (1 << 4),
+    F_MCP       = (1 << 5),
+    F_NTP       = (1 << 6),
+    F_INCONFIG  = (1 << 7),
+    F_COUNTERS  = (1 << 8),
+};
+
+// --- Minimal streaming JSON writer into a fixed buffer ---
+// Overflow sets ok() = false, the buffer stays NUL-terminated.
+class JsonWriter {
+public:
+    JsonWriter(char* buf, size_t cap);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const char* k);
+
+    void addBool(bool v);
+    void addInt(int32_t v);
+    void addUint(uint32_t v);
+    void addUint64(uint64_t v);
+    void addStr(const char* s);    // Escaped
+
+    bool ok() const { return m_ok; }
+    size_t length() const { return m_len; }
+    const char* c_str() const { return m_buf; }
+
+private:
+    void put(char c);
+    void putRaw(const char* s);
+    void sep();
+
+    char*    m_buf;
+    size_t   m_cap;
+    size_t   m_len;
+    bool     m_ok;
+    bool     m_afterKey;
+    uint8_t  m_depth;
+    uint16_t m_needComma;   // bit d = level d already has a member
+};
+
+// Fields that differ between two snapshots. "remaining" counts as
+// changed only where output or timer changed - the countdown itself
+// runs on the client. "time" never counts as a change.
+uint16_t diff(const Snapshot& prev, const Snapshot& cur);
+
+// Full snapshot members (inside an open object)
+void writeFull(JsonWriter& w, const Snapshot& s, uint32_t seq);
+
+// Delta prev -> cur members; returns false (nothing written) if nothing changed
+bool writeDelta(JsonWriter& w, const Snapshot& prev, const Snapshot& cur, uint32_t seq);
+
+} // namespace stateproto
@@ -6,6 +6,28 @@
 // Debug output via COM port (Serial0 = CH343 UART)
 // with NTP timestamps and per-category filtering
 //
+// Log calls only format the message and enqueue it into a lock-free
+// ring (PSRAM if available); a low-priority task on core 0 writes
+// it to the UART. When the ring is full the oldest line is dropped
+// and counted. Call dbg::flush() before a deliberate restart.
+//
+// Compile-time filter (build_flags), checked before the runtime mask:
+//   -DDBG_COMPILE_LEVEL=1        // 0=DEBUG 1=INFO 2=WARN 3=ERROR 4=NONE
+//   -DDBG_COMPILE_CATS=0x00FF    // Category bits kept in the binary
+// Calls below the level or outside the categories compile to nothing
+// (ERROR ignores the category mask, as at runtime). Arguments with side
+// effects are still evaluated - guard expensive ones with
+//   if (dbg::enabled(dbg::LVL_DEBUG, CAT_INPUT)) { ... }
+//
+// Lines at CRASHLOG_MIN_LEVEL and above are also kept in the
+// post-mortem buffer (crashlog.h), whatever the runtime filter says.
+//
+// Tokenized mode (-DDBG_TOKENIZED=1): no text is formatted on the
+// device. Each line goes out as a binary frame with the address of
+// its format string and the packed arguments (see logtoken.h);
+// tools/logdecode.py rebuilds the text from the firmware ELF:
+//   python tools/logdecode.py .pio/build/esp32s3/firmware.elf --port COM3
+//
 // Usage:
 //   dbg::begin();
 //   dbg::catEnable(dbg::CAT_RELAY, true);
@@ -16,6 +38,19 @@
 //   dbg::disableAll();                       // alle stumm (ausser ERROR)
 // ============================================================
 
+#ifndef DBG_COMPILE_LEVEL
+#define DBG_COMPILE_LEVEL 0
+#endif
+#ifndef DBG_COMPILE_CATS
+#define DBG_COMPILE_CATS 0xFFFF
+#endif
+#ifndef DBG_TOKENIZED
+#define DBG_TOKENIZED 0
+#endif
+
+#include "logtoken.h"
+#include "crashlog.h"
+
 namespace dbg {
 
 // --- Log Levels ---
@@ -58,17 +93,96 @@ void ntpSync(const char* timezone = "CET-1CEST,M3.5.0,M10.5.0/3",
 bool isTimeSynced();
 
 // --- Logging with category ---
-void debug(Category cat, const char* fmt, ...);
-void info(Category cat, const char* fmt, ...);
-void warn(Category cat, const char* fmt, ...);
-void error(Category cat, const char* fmt, ...);
+
+// int parameter: "uint8_t enum >= 0" would trip -Wtype-limits at level 0
+constexpr bool levelKept(int lvl) {
+    return lvl >= DBG_COMPILE_LEVEL;
+}
+
+// Site kept in the binary by DBG_COMPILE_LEVEL / DBG_COMPILE_CATS
+constexpr bool compiledIn(Level lvl, uint16_t cat) {
+    return levelKept(lvl) && lvl < LVL_NONE &&
+           (lvl == LVL_ERROR || (DBG_COMPILE_CATS & cat) != 0);
+}
+
+// Runtime filter state (set via begin / setLevel / cat*)
+extern Level g_minLevel;
+extern uint16_t g_catMask;
+
+// Compile-time and runtime filter
+inline bool enabled(Level lvl, uint16_t cat) {
+    return compiledIn(lvl, cat) && lvl >= g_minLevel &&
+           (lvl == LVL_ERROR || (g_catMask & cat) != 0);
+}
+
+// Formats and queues one line; use the wrappers below
+void logf(Level lvl, Category cat, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// Queues one tokenized record (fmt address + packed arguments)
+void logt(Level lvl, Category cat, const char* fmt, const uint8_t* args, uint8_t len, bool truncated);
+
+// Serial output if enabled; from CRASHLOG_MIN_LEVEL on also the
+// post-mortem buffer (independent of the runtime filter)
+template <typename... Args>
+inline void emit(Level lvl, Category cat, const char* fmt, Args... args) {
+    const bool out = enabled(lvl, cat);
+    const bool keep = lvl >= CRASHLOG_MIN_LEVEL;
+    if (!out && !keep) return;
+#if DBG_TOKENIZED
+    tok::Packer pk;
+    tok::packAll(pk, args...);
+    if (out) logt(lvl, cat, fmt, pk.buf, pk.len, pk.truncated);
+    if (keep) crashlog::record(lvl, cat, fmt, pk.buf, pk.len, pk.truncated);
+#else
+    if (keep) {
+        tok::Packer pk;
+        tok::packAll(pk, args...);
+        crashlog::record(lvl, cat, fmt, pk.buf, pk.len, pk.truncated);
+    }
+    if (out) logf(lvl, cat, fmt, args...);
+#endif
+}
+
+template <typename... Args>
+__attribute__((always_inline)) inline void debug(Category cat, const char* fmt, Args... args) {
+    if (compiledIn(LVL_DEBUG, cat)) emit(LVL_DEBUG, cat, fmt, args...);
+}
+
+template <typename... Args>
+__attribute__((always_inline)) inline void info(Category cat, const char* fmt, Args... args) {
+    if (compiledIn(LVL_INFO, cat)) emit(LVL_INFO, cat, fmt, args...);
+}
+
+template <typename... Args>
+__attribute__((always_inline)) inline void warn(Category cat, const char* fmt, Args... args) {
+    if (compiledIn(LVL_WARN, cat)) emit(LVL_WARN, cat, fmt, args...);
+}
+
+template <typename... Args>
+__attribute__((always_inline)) inline void error(Category cat, const char* fmt, Args... args) {
+    if (compiledIn(LVL_ERROR, cat)) emit(LVL_ERROR, cat, fmt, args...);
+}
 
 // --- Level control ---
 void setLevel(Level level);
 Level getLevel();
 
+// --- Log pipeline ---
+struct LogStats {
+    uint32_t queued;        // Lines accepted
+    uint32_t dropped;       // Oldest lines dropped on overflow
+    uint32_t pending;       // Lines waiting for the UART
+    uint32_t avgCycles;     // Smoothed cost of one log call (CPU cycles)
+    uint32_t maxCycles;
+};
+LogStats getLogStats();
+void flush();                     // Write all pending lines now (blocking)
+
 // --- Utilities ---
 String getTimestamp();
+void formatTimestamp(char* buf, size_t len);   // Same text, no heap (len >= 20)
+void formatTime(char* buf, size_t len, time_t sec, uint32_t ms);   // Recorded time
 const char* catName(Category cat);
+const char* levelName(Level lvl);
 
 } // namespace dbg
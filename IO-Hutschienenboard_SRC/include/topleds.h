@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// ============================================================
+// Top board status LEDs (MCP23017)
+// LED i shows relay i. Per channel it can also blink slowly (auto-off
+// timer running) or fast (relay driver fault, wins over everything).
+// The LED image is built from the caller's millisecond tick, so all
+// blinking LEDs share one phase. It is written only when it differs
+// from the last one, as one 2-byte OLATA/OLATB write through the
+// mcpport shadow. Steady LEDs cost no bus traffic, a blinking channel
+// two writes per period.
+//
+// Usage:
+//   topleds::begin(MCP_LEDS, MCP_ADDR[MCP_LEDS]);   // after mcpport::begin
+//   // Housekeeping:
+//   topleds::update(relays, timers, faults, millis());
+// ============================================================
+
+#ifndef LED_SLOW_MS
+#define LED_SLOW_MS 1000           // Blink period: timer running
+#endif
+#ifndef LED_FAST_MS
+#define LED_FAST_MS 250            // Blink period: fault
+#endif
+
+namespace topleds {
+
+// Configure the expander (outputs, all LEDs off); false = chip missing
+bool begin(uint8_t chip, uint8_t addr);
+bool ready();
+
+// Masks with bit i = channel i; true if the image was written
+bool update(uint16_t on, uint16_t slow, uint16_t fast, uint32_t nowMs);
+
+// LED image for the given masks at nowMs (no bus access)
+uint16_t compose(uint16_t on, uint16_t slow, uint16_t fast, uint32_t nowMs);
+
+uint32_t writeCount();     // Image writes since boot
+
+} // namespace topleds
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+class AsyncWebServer;
+
+// ============================================================
+// Web assets embedded in the firmware image
+// tools/embed_assets.py (PlatformIO pre-build script) gzips every
+// file in data/ and generates a byte array per file with a strong
+// ETag (SHA-256 prefix of the gzip bytes). Responses carry
+// Content-Encoding: gzip and the ETag; a request with a matching
+// If-None-Match gets an empty 304.
+//
+// Cache-Control: pages are "no-cache" (the browser revalidates,
+// a repeat load costs one conditional request). A request with
+// ?v=<etag> addresses exactly this content and is "immutable".
+//
+// Usage:
+//   webassets::begin(server);     // Before serveStatic() fallbacks
+//   webassets::Stats st = webassets::getStats();
+// ============================================================
+
+namespace webassets {
+
+struct Asset {
+    const char*    path;        // "/index.html"
+    const char*    type;        // MIME type
+    const uint8_t* data;        // gzip
+    uint32_t       len;
+    const char*    hash;        // 16 hex digits
+    const char*    etag;        // Quoted hash
+};
+
+struct Stats {
+    uint32_t sent;              // 200 with body
+    uint32_t notModified;       // 304
+};
+
+// Register one GET handler per asset ("/" serves /index.html)
+void begin(AsyncWebServer& server);
+
+const Asset* find(const char* path);
+uint8_t count();
+Stats getStats();
+
+} // namespace webassets
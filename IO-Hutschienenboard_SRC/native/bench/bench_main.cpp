@@ -0,0 +1,678 @@
+// ============================================================
+// Micro-benchmarks of the control logic hot paths (env:native)
+//
+//   pio run -e native && .pio/build/native/program
+//   .pio/build/native/program --save bench.txt         // record a baseline
+//   .pio/build/native/program --baseline bench.txt     // exit 1 on regression
+//
+// Each case runs for about BENCH_MIN_MS and reports ns per
+// operation (best of BENCH_REPEAT runs), plus heap allocations and
+// allocated bytes per operation over BENCH_ALLOC_OPS operations
+// (operator new is counted below; setup inside a case included).
+// Cases that model a wire format also report the bytes they put out
+// per operation (out/op).
+// With --baseline a case
+// slower than the recorded value by more than BENCH_TOLERANCE_PCT
+// (and BENCH_SLACK_NS, timer noise of the few-ns cases) fails the
+// run. Compare numbers from the same machine and build flags only.
+// ============================================================
+
+#include <Arduino.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "hal_native.h"
+#include "iologic.h"
+#include "inputfilter.h"
+#include "autooff.h"
+#include "stateproto.h"
+#include "binproto.h"
+#include "configblob.h"
+#include "rules.h"
+#include "pinmap.h"
+#include "cmdqueue.h"
+#include "swtools.h"
+#include "framepool.h"
+
+#ifndef BENCH_MIN_MS
+#define BENCH_MIN_MS 200
+#endif
+#ifndef BENCH_REPEAT
+#define BENCH_REPEAT 3
+#endif
+#ifndef BENCH_TOLERANCE_PCT
+#define BENCH_TOLERANCE_PCT 25
+#endif
+#ifndef BENCH_SLACK_NS
+#define BENCH_SLACK_NS 5.0
+#endif
+#ifndef BENCH_ALLOC_OPS
+#define BENCH_ALLOC_OPS 1000
+#endif
+
+typedef uint32_t (*BenchFn)(uint32_t n);   // Runs n operations, returns a checksum
+
+struct Bench {
+    const char* name;
+    BenchFn     fn;
+};
+
+static volatile uint32_t s_sink = 0;   // Keeps the results alive
+
+// --- Heap accounting (single-threaded) ---
+static uint64_t s_allocs = 0;
+static uint64_t s_allocBytes = 0;
+static uint64_t s_outBytes = 0;        // Wire bytes, added by the cases that produce any
+
+// noinline: keeps GCC from pairing the inlined free() with new (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(size_t size) {
+    s_allocs++;
+    s_allocBytes += size;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+// --- Setup ---
+
+static void setupLogic() {
+    nativehal::reset();
+    configblob::Config c;
+    configblob::defaults(c);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        iologic::inputMapping[i] = (int8_t)i;      // Input i toggles relay i
+        iologic::autoOffSeconds[i] = c.autoOffSeconds[i];
+        iologic::inputMode[i] = c.inputMode[i];
+        iologic::inputFilterMs[i] = c.inputFilterMs[i];
+        iologic::s0Imp[i] = c.s0Imp[i];
+        iologic::applyInputMode(i);
+    }
+    iologic::setRules("");
+}
+
+// Rule set of a fully used board: RULES_MAX rows, every rule kind,
+// within RULES_TEXT_MAX
+static const char* const RULE_TEXT =
+    "E1->toggle A1 A2\n"
+    "E2|E3->stair 120 A3\n"
+    "E4->on A4 A5,off A6\n"
+    "E5->on A6,off A4 A5\n"
+    "E6->on A7 if E7&!E8 unless A8\n"
+    "E7->on A8 unless A7\n"
+    "E8->off A7 A8\n"
+    "A9=E9&E10\n"
+    "A10=E9|E10|E11 unless A9\n"
+    "E11->toggle A11 if E12\n"
+    "E12->off A1-A12\n"
+    "E1->stair 60 A12 if E2\n"
+    "E2->toggle A1\n"
+    "E3->toggle A2\n"
+    "E4->toggle A3\n"
+    "E5->toggle A4\n"
+    "E6->toggle A5\n"
+    "E7->toggle A6\n"
+    "E8->toggle A7\n"
+    "E9->toggle A8\n"
+    "E10->toggle A9 unless A10\n"
+    "E11->toggle A10\n"
+    "A11=E1&E2&E3\n"
+    "A12=E4|E5 unless A1-A3\n";
+
+static void fillSnapshot(stateproto::Snapshot& s, uint32_t k) {
+    memset(&s, 0, sizeof(s));
+    s.inputs = (uint16_t)(k * 0x0101);
+    s.outputs = (uint16_t)(k * 0x0301);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        s.mappings[i] = (int8_t)(i ^ (k & 1));
+        s.timers[i] = 300;
+        s.remaining[i] = (k + i) % 300;
+        s.inFilterMs[i] = 20;
+        s.counts[i] = 1000000ULL + k;
+        s.power[i] = 1500 + i;
+        s.s0Imp[i] = 1000;
+    }
+    s.mcp = 3;
+    strcpy(s.time, "2024-01-01 12:00:00");
+}
+
+// --- Cases ---
+
+// DC input with contact bounce: 4 edges within the lockout, then settle
+static uint32_t benchFilterDc(uint32_t n) {
+    inputfilter::configure(0, inputfilter::MODE_DC, 0);
+    inputfilter::reset(0, false);
+    int64_t t = 0;
+    uint32_t changes = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const bool level = (k & 1) == 0;
+        t += (k % 4 == 3) ? 30000 : 500;
+        if (inputfilter::feed(0, level, t)) changes++;
+        changes += inputfilter::poll(t) ? 1 : 0;
+    }
+    return changes;
+}
+
+// AC input: 50 Hz edge train, one poll per edge
+static uint32_t benchFilterAc(uint32_t n) {
+    inputfilter::configure(1, inputfilter::MODE_AC, 0);
+    inputfilter::reset(1, false);
+    int64_t t = 0;
+    uint32_t changes = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        t += 10000;
+        if (inputfilter::feed(1, (k & 1) != 0, t)) changes++;
+        changes += inputfilter::poll(t) ? 1 : 0;
+    }
+    return changes;
+}
+
+// One scan with an edge on a mapped input (toggle -> relay request)
+static uint32_t benchScanEdge(uint32_t n) {
+    setupLogic();
+    uint32_t fx = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        nativehal::advance(25000);      // Past the DC lockout
+        nativehal::input((uint8_t)(k % NUM_CHANNELS), (k / NUM_CHANNELS) % 2 == 0);
+        fx += iologic::scan();
+    }
+    return fx;
+}
+
+// Idle scan: no edges, no timers (the common case every IO_SCAN_MS)
+static uint32_t benchScanIdle(uint32_t n) {
+    setupLogic();
+    uint32_t fx = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        nativehal::advance(2000);
+        fx += iologic::scan();
+    }
+    return fx;
+}
+
+static uint32_t benchExecute(uint32_t n) {
+    setupLogic();
+    binproto::Command c = {binproto::CMD_TOGGLE, 0, 0};
+    uint32_t fx = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        c.ch = (uint8_t)(k % NUM_CHANNELS);
+        fx += iologic::execute(c);
+    }
+    return fx;
+}
+
+// Arm all channels with spread deadlines, collect them
+static uint32_t benchAutoOff(uint32_t n) {
+    uint32_t due = 0;
+    int64_t t = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const uint8_t ch = (uint8_t)(k % NUM_CHANNELS);
+        autooff::arm(ch, 1 + (k * 7) % 5, t);
+        if (ch == NUM_CHANNELS - 1) {
+            t += 3000000;
+            due += autooff::takeExpired(t);
+        }
+    }
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) autooff::cancel(i);
+    return due;
+}
+
+static uint32_t benchWriteFull(uint32_t n) {
+    static char buf[STATE_JSON_MAX];
+    stateproto::Snapshot s;
+    fillSnapshot(s, 1);
+    uint32_t len = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        stateproto::writeFull(w, s, k);
+        w.endObject();
+        len += (uint32_t)w.length();
+    }
+    return len;
+}
+
+static uint32_t benchWriteDelta(uint32_t n) {
+    static char buf[STATE_JSON_MAX];
+    stateproto::Snapshot a, b;
+    fillSnapshot(a, 1);
+    fillSnapshot(b, 2);
+    uint32_t len = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        stateproto::writeDelta(w, (k & 1) ? a : b, (k & 1) ? b : a, k);
+        w.endObject();
+        len += (uint32_t)w.length();
+    }
+    return len;
+}
+
+// One broadcast frame as broadcastState() builds it: the delta goes
+// straight into a pooled shared message buffer; the last
+// WS_LAG_QUEUE_LEN frames are still held by a client send queue
+static uint32_t benchWsFrame(uint32_t n) {
+    static const size_t QUEUE = 4;              // WS_LAG_QUEUE_LEN
+    static FramePool<QUEUE + 2> pool;           // WS_FRAME_POOL
+    static FramePool<QUEUE + 2>::Buffer queued[QUEUE];
+    static bool ready = false;
+    if (!ready) {
+        pool.begin(STATE_JSON_MAX);
+        ready = true;
+    }
+    stateproto::Snapshot a, b;
+    fillSnapshot(a, 1);
+    fillSnapshot(b, 2);
+    uint32_t len = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        FramePool<QUEUE + 2>::Buffer msg = pool.take(STATE_JSON_MAX);
+        stateproto::JsonWriter w((char*)msg->data(), msg->size());
+        w.beginObject();
+        stateproto::writeDelta(w, (k & 1) ? a : b, (k & 1) ? b : a, k);
+        w.endObject();
+        msg->resize(w.length());
+        len += (uint32_t)msg->size();
+        queued[k % QUEUE] = msg;                // Oldest one sent, released
+    }
+    return len + pool.misses();
+}
+
+// Reference: buffer handling of the path before the JsonWriter.
+// serializeJson() into a String (ArduinoJson appends 32-byte chunks,
+// Arduino's String::concat() reallocates to the exact new length),
+// then ws.textAll() copies it into a shared message buffer. ArduinoJson
+// is not part of the native build, so the JsonDocument pool of that
+// path is missing here: a lower bound for the old cost.
+static uint32_t benchWsFrameStringRef(uint32_t n) {
+    static char buf[STATE_JSON_MAX];
+    stateproto::Snapshot a, b;
+    fillSnapshot(a, 1);
+    fillSnapshot(b, 2);
+    uint32_t len = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        stateproto::writeDelta(w, (k & 1) ? a : b, (k & 1) ? b : a, k);
+        w.endObject();
+
+        char* str = nullptr;                    // String, grown chunk by chunk
+        size_t strLen = 0;
+        for (size_t off = 0; off < w.length(); off += 32) {
+            const size_t chunk = w.length() - off < 32 ? w.length() - off : 32;
+            char* grown = new char[strLen + chunk + 1];
+            if (str) memcpy(grown, str, strLen);
+            memcpy(grown + strLen, buf + off, chunk);
+            strLen += chunk;
+            grown[strLen] = '\0';
+            delete[] str;
+            str = grown;
+        }
+        std::shared_ptr<std::vector<uint8_t>> msg =
+            std::make_shared<std::vector<uint8_t>>((const uint8_t*)str, (const uint8_t*)str + strLen);
+        delete[] str;
+        len += (uint32_t)msg->size();
+    }
+    return len;
+}
+
+// --- Log records ---
+// The same iologic call sites as a text line and as a tokenized frame,
+// each up to what the drain task hands the UART. Text: the caller's
+// vsnprintf (logf) plus the timestamped, colored line (writeRecord);
+// tokenized: packAll (emit) plus tok::encodeFrame (writeToken).
+
+static const time_t LOG_SEC = 1790000000;   // NTP-synced wall clock
+
+static const char* const LOG_COLOR[] = {"\033[36m", "\033[32m", "\033[33m", "\033[31m"};
+
+template <typename... Args>
+static size_t textRecord(char* line, size_t len, uint32_t ms, dbg::Level lvl, dbg::Category cat,
+                         const char* fmt, Args... args) {
+    char msg[256];                              // DBG_BUFSIZE
+    snprintf(msg, sizeof(msg), fmt, args...);
+    const time_t sec = LOG_SEC + ms / 1000;
+    struct tm ti;
+    gmtime_r(&sec, &ti);
+    char ts[24];
+    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &ti);
+    const int n = snprintf(line, len, "%s[%s] %s %-5s | %s\033[0m\r\n", LOG_COLOR[lvl], ts,
+                           dbg::levelName(lvl), dbg::catName(cat), msg);
+    return n < (int)len ? (size_t)n : len - 1;
+}
+
+template <typename... Args>
+static size_t tokenRecord(uint8_t* f, uint32_t ms, dbg::Level lvl, dbg::Category cat,
+                          const char* fmt, Args... args) {
+    tok::Packer pk;
+    tok::packAll(pk, args...);
+    return tok::encodeFrame(f, fmt, (uint32_t)(LOG_SEC + ms / 1000), ms, (uint8_t)lvl, (uint16_t)cat,
+                            pk.buf, pk.len, pk.truncated);
+}
+
+static uint32_t benchLogText(uint32_t n) {
+    static char line[320];
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const int ch = (int)(k % 12) + 1;
+        size_t len = 0;
+        switch (k & 3) {
+            case 0: len = textRecord(line, sizeof(line), k, dbg::LVL_INFO, dbg::CAT_RELAY,
+                                     "Relais %d: %s", ch, (k & 4) ? "EIN" : "AUS"); break;
+            case 1: len = textRecord(line, sizeof(line), k, dbg::LVL_DEBUG, dbg::CAT_INPUT,
+                                     "Eingang %d: steigende Flanke (%lld us)", ch, (long long)k * 1000); break;
+            case 2: len = textRecord(line, sizeof(line), k, dbg::LVL_INFO, dbg::CAT_TIMER,
+                                     "Auto-Aus: Relais %d nach %u s", ch, 300u); break;
+            default: len = textRecord(line, sizeof(line), k, dbg::LVL_ERROR, dbg::CAT_RELAY,
+                                      "Relais %d: MCP23017 #%d nicht bereit!", ch, 1); break;
+        }
+        s_outBytes += len;
+        sum += (uint32_t)len + (uint8_t)line[len - 3];
+    }
+    return sum;
+}
+
+static uint32_t benchLogToken(uint32_t n) {
+    static uint8_t f[DBG_TOK_FRAME_MAX];
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const int ch = (int)(k % 12) + 1;
+        size_t len = 0;
+        switch (k & 3) {
+            case 0: len = tokenRecord(f, k, dbg::LVL_INFO, dbg::CAT_RELAY,
+                                      "Relais %d: %s", ch, (k & 4) ? "EIN" : "AUS"); break;
+            case 1: len = tokenRecord(f, k, dbg::LVL_DEBUG, dbg::CAT_INPUT,
+                                      "Eingang %d: steigende Flanke (%lld us)", ch, (long long)k * 1000); break;
+            case 2: len = tokenRecord(f, k, dbg::LVL_INFO, dbg::CAT_TIMER,
+                                      "Auto-Aus: Relais %d nach %u s", ch, 300u); break;
+            default: len = tokenRecord(f, k, dbg::LVL_ERROR, dbg::CAT_RELAY,
+                                       "Relais %d: MCP23017 #%d nicht bereit!", ch, 1); break;
+        }
+        s_outBytes += len;
+        sum += (uint32_t)len + f[len - 1];
+    }
+    return sum;
+}
+
+static uint32_t benchBinState(uint32_t n) {
+    stateproto::Snapshot s;
+    fillSnapshot(s, 3);
+    binproto::StateFrame f;
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        binproto::encodeState(s, k, 0, f);
+        sum += f.seq;
+    }
+    return sum;
+}
+
+static uint32_t benchBinCommand(uint32_t n) {
+    binproto::Command c = {binproto::CMD_SET, 3, 1};
+    binproto::CommandFrame f;
+    binproto::encodeCommand(c, f);
+    uint32_t ok = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        binproto::Command out;
+        if (binproto::decodeCommand((const uint8_t*)&f, sizeof(f), out)) ok += out.ch;
+    }
+    return ok;
+}
+
+static uint32_t benchConfigBlob(uint32_t n) {
+    configblob::Config c;
+    configblob::defaults(c);
+    uint8_t buf[CFG_BLOB_MAX];
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        c.autoOffSeconds[k % CFG_BLOB_CHANNELS] = k;
+        const size_t len = configblob::encode(c, buf, sizeof(buf));
+        configblob::Config back;
+        sum += configblob::decode(buf, len, back);
+    }
+    return sum;
+}
+
+static uint32_t benchRulesCompile(uint32_t n) {
+    static rules::Program p;
+    uint32_t rows = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        if (rules::compile(RULE_TEXT, p)) rows += p.rows;
+    }
+    return rows;
+}
+
+// Pseudo-random image stream for the evaluation cases
+static inline uint32_t nextRandom(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// 12 channels, 24 rows: the rule step of one scan
+static uint32_t benchRulesEval12(uint32_t n) {
+    static rules::Program p;
+    rules::compile(RULE_TEXT, p);
+    uint32_t seed = 1;
+    rules::Mask out = 0;
+    rules::Mask in = 0;
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const rules::Mask prev = in;
+        in = (rules::Mask)(nextRandom(seed) & 0x0FFF);
+        rules::Mask stair = 0;
+        out = rules::evaluate(p.row, p.rows, in, (rules::Mask)(in & ~prev), out, stair);
+        sum += out + stair;
+    }
+    return sum;
+}
+
+// Same engine with 64-bit masks: 64 channels, RULES_MAX random rows
+static uint32_t benchRulesEval64(uint32_t n) {
+    static rules::BasicRow<uint64_t> row[RULES_MAX];
+    uint32_t seed = 7;
+    for (uint8_t k = 0; k < RULES_MAX; k++) {
+        rules::BasicRow<uint64_t>& r = row[k];
+        memset(&r, 0, sizeof(r));
+        const uint64_t a = ((uint64_t)nextRandom(seed) << 32) | nextRandom(seed);
+        const uint64_t b = ((uint64_t)nextRandom(seed) << 32) | nextRandom(seed);
+        if (k % 3 == 2) {
+            r.follow = b & 0x0F0F;
+            r.inAny = a & 0xFF;
+        } else {
+            r.trig = 1ULL << (k * 5 % 64);
+            r.inAll = a & (a >> 7) & (a >> 13);
+            r.outNone = b & (b >> 11) & (b >> 23);
+            r.tog = b & 0xFFFF0000ULL;
+            r.set = (b >> 32) & 0xFF;
+            r.clr = (b >> 40) & 0xFF00;
+        }
+    }
+    uint64_t out = 0;
+    uint64_t in = 0;
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const uint64_t prev = in;
+        in = ((uint64_t)nextRandom(seed) << 32) | nextRandom(seed);
+        uint64_t stair = 0;
+        out = rules::evaluate(row, RULES_MAX, in, in & ~prev, out, stair);
+        sum += (uint32_t)(out ^ (out >> 32)) + (uint32_t)stair;
+    }
+    return sum;
+}
+
+// GPIO IN registers -> input mask (the resync / boot read)
+static uint32_t benchPinGather(uint32_t n) {
+    uint32_t seed = 3;
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        sum += pinmap::gather(nextRandom(seed), k);
+    }
+    return sum;
+}
+
+// Lock-free image read of another task (LEDs, JSON)
+static uint32_t benchImageRead(uint32_t n) {
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        const procimage::Image img = iologic::image();
+        sum += img.in + img.out;
+    }
+    return sum;
+}
+
+// Handler side post + IO side pop of one command
+static uint32_t benchCmdQueue(uint32_t n) {
+    cmdqueue::begin();
+    binproto::Command c = {binproto::CMD_TOGGLE, 0, 0};
+    cmdqueue::Message m;
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        c.ch = (uint8_t)(k % NUM_CHANNELS);
+        cmdqueue::post(c);
+        if (cmdqueue::pop(m)) sum += m.cmd.ch;
+        cmdqueue::endCycle();
+    }
+    return sum;
+}
+
+// Scan with an edge and the full rule set active
+static uint32_t benchScanRules(uint32_t n) {
+    setupLogic();
+    iologic::setRules(RULE_TEXT);
+    uint32_t fx = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        nativehal::advance(25000);
+        nativehal::input((uint8_t)(k % NUM_CHANNELS), (k / NUM_CHANNELS) % 2 == 0);
+        fx += iologic::scan();
+    }
+    iologic::setRules("");
+    return fx;
+}
+
+static const Bench BENCHES[] = {
+    {"filter_dc_bounce", benchFilterDc},
+    {"filter_ac_50hz",   benchFilterAc},
+    {"scan_edge_toggle", benchScanEdge},
+    {"scan_idle",        benchScanIdle},
+    {"execute_toggle",   benchExecute},
+    {"autooff_arm_take", benchAutoOff},
+    {"json_full",        benchWriteFull},
+    {"json_delta",       benchWriteDelta},
+    {"ws_frame_pool",    benchWsFrame},
+    {"ws_frame_str_ref", benchWsFrameStringRef},
+    {"bin_state",        benchBinState},
+    {"bin_command",      benchBinCommand},
+    {"config_blob",      benchConfigBlob},
+    {"rules_compile",    benchRulesCompile},
+    {"rules_eval_12",    benchRulesEval12},
+    {"rules_eval_64",    benchRulesEval64},
+    {"scan_rules",       benchScanRules},
+    {"pin_gather",       benchPinGather},
+    {"image_read",       benchImageRead},
+    {"cmdq_post_pop",    benchCmdQueue},
+    {"log_text",         benchLogText},
+    {"log_token",        benchLogToken},
+};
+
+// --- Runner ---
+
+static double timeBench(const Bench& b, uint32_t n) {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point t0 = Clock::now();
+    s_sink += b.fn(n);
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+static double runBench(const Bench& b) {
+    uint32_t n = 1000;
+    double ns = timeBench(b, n);
+    while (ns < BENCH_MIN_MS * 1e6 && n < (1u << 30)) {     // Calibrate the count
+        n = ns < 1e6 ? n * 10 : (uint32_t)(n * (BENCH_MIN_MS * 1.2e6 / ns));
+        ns = timeBench(b, n);
+    }
+    for (uint8_t r = 1; r < BENCH_REPEAT; r++) {
+        const double t = timeBench(b, n);
+        if (t < ns) ns = t;
+    }
+    return ns / n;
+}
+
+static void countAllocs(const Bench& b, double& allocs, double& bytes, double& out) {
+    const uint64_t a0 = s_allocs;
+    const uint64_t b0 = s_allocBytes;
+    const uint64_t o0 = s_outBytes;
+    s_sink += b.fn(BENCH_ALLOC_OPS);
+    allocs = (double)(s_allocs - a0) / BENCH_ALLOC_OPS;
+    bytes = (double)(s_allocBytes - b0) / BENCH_ALLOC_OPS;
+    out = (double)(s_outBytes - o0) / BENCH_ALLOC_OPS;
+}
+
+static bool loadBaseline(const char* path, std::map<std::string, double>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char name[64];
+    double ns;
+    while (fscanf(f, "%63s %lf", name, &ns) == 2) out[name] = ns;
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* savePath = nullptr;
+    const char* basePath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) savePath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) basePath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--save file] [--baseline file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> base;
+    if (basePath && !loadBaseline(basePath, base)) {
+        fprintf(stderr, "Baseline %s nicht lesbar\n", basePath);
+        return 2;
+    }
+
+    dbg::begin(dbg::LVL_NONE, 0);   // Log formatting is not what we measure
+    nativehal::reset();
+    iologic::begin();
+
+    FILE* save = savePath ? fopen(savePath, "w") : nullptr;
+    int failed = 0;
+    printf("%-20s %12s %10s %10s %8s %12s\n", "case", "ns/op", "allocs/op", "B/op", "out/op", "baseline");
+    for (size_t k = 0; k < sizeof(BENCHES) / sizeof(BENCHES[0]); k++) {
+        const Bench& b = BENCHES[k];
+        const double ns = runBench(b);
+        double allocs, bytes, out;
+        countAllocs(b, allocs, bytes, out);
+        char outCol[16] = "-";
+        if (out > 0) snprintf(outCol, sizeof(outCol), "%.1f", out);
+        if (save) fprintf(save, "%s %.2f\n", b.name, ns);
+
+        std::map<std::string, double>::const_iterator it = base.find(b.name);
+        if (it == base.end()) {
+            printf("%-20s %12.2f %10.2f %10.1f %8s %12s\n", b.name, ns, allocs, bytes, outCol, "-");
+            continue;
+        }
+        const double pct = (ns / it->second - 1.0) * 100.0;
+        const bool slow = pct > BENCH_TOLERANCE_PCT && ns - it->second > BENCH_SLACK_NS;
+        printf("%-20s %12.2f %10.2f %10.1f %8s %12.2f %+6.1f%%%s\n", b.name, ns, allocs, bytes, outCol,
+               it->second, pct,
+               slow ? "  REGRESSION" : "");
+        if (slow) failed++;
+    }
+    if (save) fclose(save);
+
+    if (failed) {
+        printf("%d Fall/Faelle mehr als %d%% langsamer als die Baseline\n", failed, BENCH_TOLERANCE_PCT);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,369 @@
+#include "hal_native.h"
+#include "iologic.h"
+#include "pin_config.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// --- esp_timer on the virtual clock ---
+
+struct native_timer {
+    esp_timer_cb_t cb;
+    void* arg;
+    int64_t dueUs;      // -1 = stopped
+};
+
+namespace nativehal {
+
+struct Pulse {
+    bool    running;
+    bool    on;
+    int64_t dueUs;
+    bool    queued;     // Next request waits for this pulse
+    bool    queuedOn;
+};
+
+static int64_t s_now = 0;
+static std::vector<native_timer*> s_timers;
+
+static hal::Edge s_ring[NATIVE_EDGE_RING];
+static uint32_t s_head = 0;         // Next pop
+static uint32_t s_tail = 0;         // Next push
+static uint32_t s_dropped = 0;
+static bool s_level[NUM_CHANNELS];
+static uint16_t s_presses = 0;
+
+static Pulse s_pulse[NUM_CHANNELS];
+static bool s_contact[NUM_CHANNELS];
+static bool s_ready[NUM_CHANNELS];
+static int64_t s_relayDelayUs = 0;
+static uint32_t s_requests = 0;
+static uint32_t s_batches = 0;
+static uint32_t s_overruns = 0;
+static RelayFn s_relayFn = nullptr;
+
+static uint64_t s_count[NUM_CHANNELS];
+static bool s_countChanged = false;
+
+static std::map<std::string, std::vector<uint8_t> > s_store;
+
+static SendFn s_send = nullptr;
+static uint32_t s_frames = 0;
+static uint32_t s_bytes = 0;
+
+void reset() {
+    s_now = 0;
+    for (size_t k = 0; k < s_timers.size(); k++) s_timers[k]->dueUs = -1;
+    s_head = s_tail = s_dropped = 0;
+    s_presses = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        s_level[i] = false;
+        s_pulse[i] = Pulse();
+        s_contact[i] = false;
+        s_ready[i] = true;
+        s_count[i] = 0;
+    }
+    s_relayDelayUs = 0;
+    s_requests = s_batches = s_overruns = 0;
+    s_countChanged = false;
+    s_store.clear();
+    s_frames = s_bytes = 0;
+}
+
+// --- Relays ---
+
+static void startPulse(uint8_t ch, bool on) {
+    Pulse& p = s_pulse[ch];
+    p.running = true;
+    p.on = on;
+    p.dueUs = s_now + s_relayDelayUs;
+}
+
+// Pulse over: contact switched, next queued request starts
+static void finishPulse(uint8_t ch) {
+    Pulse& p = s_pulse[ch];
+    p.running = false;
+    s_contact[ch] = p.on;
+    if (s_relayFn) s_relayFn(ch, p.on, true);
+    iologic::onRelayDone(ch, p.on);
+    if (p.queued) {
+        p.queued = false;
+        startPulse(ch, p.queuedOn);
+    }
+}
+
+void setRelayDelayUs(int64_t us) {
+    s_relayDelayUs = us < 0 ? 0 : us;
+}
+
+void setRelayReady(uint8_t ch, bool ready) {
+    if (ch < NUM_CHANNELS) s_ready[ch] = ready;
+}
+
+bool relayOn(uint8_t ch) {
+    return ch < NUM_CHANNELS && s_contact[ch];
+}
+
+uint32_t relayRequests() {
+    return s_requests;
+}
+
+uint32_t relayBatches() {
+    return s_batches;
+}
+
+uint32_t relayOverruns() {
+    return s_overruns;
+}
+
+void onRelay(RelayFn fn) {
+    s_relayFn = fn;
+}
+
+// --- Clock ---
+
+int64_t nextEventUs() {
+    int64_t next = -1;
+    for (size_t k = 0; k < s_timers.size(); k++) {
+        const int64_t d = s_timers[k]->dueUs;
+        if (d >= 0 && (next < 0 || d < next)) next = d;
+    }
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (s_pulse[i].running && (next < 0 || s_pulse[i].dueUs < next)) next = s_pulse[i].dueUs;
+    }
+    return next;
+}
+
+void advanceTo(int64_t tsUs) {
+    for (;;) {
+        const int64_t next = nextEventUs();
+        if (next < 0 || next > tsUs) break;
+        if (next > s_now) s_now = next;
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (s_pulse[i].running && s_pulse[i].dueUs <= s_now) finishPulse(i);
+        }
+        for (size_t k = 0; k < s_timers.size(); k++) {
+            native_timer* t = s_timers[k];
+            if (t->dueUs < 0 || t->dueUs > s_now) continue;
+            t->dueUs = -1;      // One-shot; the callback may start it again
+            t->cb(t->arg);
+        }
+    }
+    if (tsUs > s_now) s_now = tsUs;
+}
+
+void advance(int64_t us) {
+    advanceTo(s_now + us);
+}
+
+// --- Inputs ---
+
+void press(uint8_t ch) {
+    if (ch < NUM_CHANNELS) s_presses |= (uint16_t)(1 << ch);
+}
+
+bool inputAt(uint8_t ch, bool level, int64_t tsUs) {
+    if (ch >= NUM_CHANNELS) return false;
+    s_level[ch] = level;
+    if (s_tail - s_head >= NATIVE_EDGE_RING) {
+        s_dropped++;
+        return false;
+    }
+    hal::Edge& e = s_ring[s_tail % NATIVE_EDGE_RING];
+    e.tsUs = tsUs;
+    e.channel = ch;
+    e.level = level ? 1 : 0;
+    s_tail++;
+    return true;
+}
+
+bool input(uint8_t ch, bool level) {
+    return inputAt(ch, level, s_now);
+}
+
+uint32_t inputPending() {
+    return s_tail - s_head;
+}
+
+// --- Transport ---
+
+void onSend(SendFn fn) {
+    s_send = fn;
+}
+
+uint32_t sentFrames() {
+    return s_frames;
+}
+
+uint32_t sentBytes() {
+    return s_bytes;
+}
+
+} // namespace nativehal
+
+// ============================================================
+// hal.h
+// ============================================================
+
+namespace hal {
+
+using namespace nativehal;
+
+int64_t nowUs() {
+    return s_now;
+}
+
+// Real time, not the virtual clock: what a piece of code costs here
+uint32_t cycles() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool inputPop(Edge& e) {
+    if (s_head == s_tail) return false;
+    e = s_ring[s_head % NATIVE_EDGE_RING];
+    s_head++;
+    return true;
+}
+
+uint16_t inputLevels() {
+    uint16_t m = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (s_level[i]) m |= (uint16_t)(1 << i);
+    }
+    return m;
+}
+
+uint32_t inputDropped() {
+    return s_dropped;
+}
+
+bool relayReady(uint8_t ch) {
+    return ch < NUM_CHANNELS && s_ready[ch];
+}
+
+void relayRequest(uint8_t ch, bool on) {
+    if (ch >= NUM_CHANNELS) return;
+    s_requests++;
+    if (s_relayFn) s_relayFn(ch, on, false);
+    Pulse& p = s_pulse[ch];
+    if (p.running) {
+        if (p.queued) s_overruns++;
+        p.queued = true;    // A newer request replaces a queued one
+        p.queuedOn = on;
+        return;
+    }
+    startPulse(ch, on);
+    if (s_relayDelayUs == 0) finishPulse(ch);
+}
+
+bool relayTarget(uint8_t ch, bool current) {
+    if (ch >= NUM_CHANNELS) return current;
+    const Pulse& p = s_pulse[ch];
+    if (p.queued) return p.queuedOn;
+    if (p.running) return p.on;
+    return current;
+}
+
+void relayBatch(bool begin) {
+    if (begin) s_batches++;
+}
+
+uint16_t buttonPresses() {
+    const uint16_t m = s_presses;
+    s_presses = 0;
+    return m;
+}
+
+bool counterConfigure(uint8_t ch, bool enabled, uint16_t impPerKwh) {
+    (void)ch;
+    (void)enabled;
+    (void)impPerKwh;
+    return false;       // Edge path only
+}
+
+void counterEdge(uint8_t ch, bool level, int64_t tsUs) {
+    (void)tsUs;
+    if (ch < NUM_CHANNELS && level) {
+        s_count[ch]++;
+        s_countChanged = true;
+    }
+}
+
+bool counterPoll(int64_t nowUs) {
+    (void)nowUs;
+    const bool changed = s_countChanged;
+    s_countChanged = false;
+    return changed;
+}
+
+uint64_t counterTotal(uint8_t ch) {
+    return ch < NUM_CHANNELS ? s_count[ch] : 0;
+}
+
+uint32_t counterPowerW(uint8_t ch) {
+    (void)ch;
+    return 0;
+}
+
+size_t storeRead(const char* key, uint8_t* buf, size_t cap) {
+    std::map<std::string, std::vector<uint8_t> >::const_iterator it = s_store.find(key);
+    if (it == s_store.end()) return 0;
+    const size_t n = it->second.size() < cap ? it->second.size() : cap;
+    memcpy(buf, it->second.data(), n);
+    return n;
+}
+
+bool storeWrite(const char* key, const uint8_t* buf, size_t len) {
+    s_store[key].assign(buf, buf + len);
+    return true;
+}
+
+void transportSend(uint32_t client, const uint8_t* data, size_t len, bool binary) {
+    s_frames++;
+    s_bytes += (uint32_t)len;
+    if (s_send) s_send(client, data, len, binary);
+}
+
+} // namespace hal
+
+// ============================================================
+// esp_timer.h / Arduino.h clock
+// ============================================================
+
+int64_t esp_timer_get_time() {
+    return nativehal::s_now;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    native_timer* t = new native_timer;
+    t->cb = args->callback;
+    t->arg = args->arg;
+    t->dueUs = -1;
+    nativehal::s_timers.push_back(t);
+    *out = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    if (!timer) return ESP_FAIL;
+    timer->dueUs = nativehal::s_now + (int64_t)timeoutUs;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) return ESP_FAIL;
+    timer->dueUs = -1;
+    return ESP_OK;
+}
+
+uint32_t millis() {
+    return (uint32_t)(nativehal::s_now / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t)nativehal::s_now;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+// ============================================================
+// Arduino core replacement for the native build (env:native)
+// Only what the portable modules use: fixed-width types, the
+// FreeRTOS critical-section macros (single-threaded: no-ops), a
+// minimal String and the millis()/micros() clock, which follows the
+// virtual clock of hal_native.
+// ============================================================
+
+#ifndef SIMULATE_HW
+#define SIMULATE_HW 1
+#endif
+
+#define HIGH 1
+#define LOW  0
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux)     ((void)(mux))
+#define portEXIT_CRITICAL(mux)      ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)  ((void)(mux))
+
+typedef void* TaskHandle_t;
+
+class String {
+public:
+    String(const char* s = "") : m_s(s ? s : "") {}
+    const char* c_str() const { return m_s.c_str(); }
+    size_t length() const { return m_s.size(); }
+    bool operator==(const char* s) const { return m_s == s; }
+
+private:
+    std::string m_s;
+};
+
+uint32_t millis();
+uint32_t micros();
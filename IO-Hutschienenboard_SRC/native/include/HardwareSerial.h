@@ -0,0 +1,2 @@
+#pragma once
+// Native build: the log goes to stderr (see native/log_native.cpp)
@@ -0,0 +1,6 @@
+#pragma once
+// Native build: no RTC memory or IRAM, the attributes vanish
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
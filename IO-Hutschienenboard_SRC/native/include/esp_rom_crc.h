@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+// Native build: same CRC-32 (IEEE 802.3, reflected) as the ESP32 ROM,
+// table-driven like the ROM code so benchmarks see a comparable cost
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (uint8_t k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320UL & (0 - (c & 1)));
+            table[i] = c;
+        }
+        ready = true;
+    }
+    crc = ~crc;
+    while (len--) crc = (crc >> 8) ^ table[(crc ^ *buf++) & 0xFF];
+    return ~crc;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "hal.h"
+
+// ============================================================
+// Native HAL (Linux, env:native)
+// Implements hal.h on a virtual clock: nothing happens until the
+// caller advances time. Input edges are queued like the inputcap
+// ring, relay requests complete after the configured pulse delay
+// (0 = inside the request), esp_timer callbacks fire in deadline
+// order, the store is a RAM map and sent frames go to a callback.
+//
+// Usage:
+//   nativehal::reset();
+//   nativehal::setRelayDelayUs(50000);           // bistable pulse
+//   nativehal::input(0, true);                   // edge at the current time
+//   nativehal::press(3);                         // top board button 4
+//   iologic::scan();
+//   nativehal::advance(2000);                    // 2 ms later
+// ============================================================
+
+#ifndef NATIVE_EDGE_RING
+#define NATIVE_EDGE_RING 128    // Queued edges before they are dropped (as inputcap)
+#endif
+
+namespace nativehal {
+
+typedef void (*SendFn)(uint32_t client, const uint8_t* data, size_t len, bool binary);
+typedef void (*RelayFn)(uint8_t ch, bool on, bool done);   // done: false = request, true = switched
+
+// Clock 0, inputs low, relays off and idle, no timers, store empty
+void reset();
+
+// --- Clock ---
+void advance(int64_t us);           // Fires due timers / relay completions on the way
+void advanceTo(int64_t tsUs);
+int64_t nextEventUs();              // Earliest pending timer or relay, -1 = none
+
+// --- Inputs ---
+bool input(uint8_t ch, bool level);             // Edge now; false = ring full (dropped)
+bool inputAt(uint8_t ch, bool level, int64_t tsUs);   // Edge with an earlier timestamp
+uint32_t inputPending();
+void press(uint8_t ch);             // Top board button (debounced press)
+
+// --- Relays ---
+void setRelayDelayUs(int64_t us);
+void setRelayReady(uint8_t ch, bool ready);
+bool relayOn(uint8_t ch);           // Contact state (after the pulse)
+uint32_t relayRequests();           // Requests since reset()
+uint32_t relayBatches();            // relayBatch(true) calls since reset()
+uint32_t relayOverruns();           // Queued requests replaced by a newer one
+void onRelay(RelayFn fn);           // Observer for requests and completions
+
+// --- Transport ---
+void onSend(SendFn fn);
+uint32_t sentFrames();
+uint32_t sentBytes();
+
+} // namespace nativehal
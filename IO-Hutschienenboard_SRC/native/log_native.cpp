@@ -0,0 +1,122 @@
+#include "swtools.h"
+#include "crashlog.h"
+#include <stdarg.h>
+
+// Native build: log lines go straight to stderr, no ring, no UART
+// task; the post-mortem buffer does not exist off-target.
+
+namespace dbg {
+
+Level g_minLevel = LVL_DEBUG;
+uint16_t g_catMask = CAT_ALL;
+
+const char* levelName(Level lvl) {
+    switch (lvl) {
+        case LVL_DEBUG: return "DBG";
+        case LVL_INFO:  return "INF";
+        case LVL_WARN:  return "WRN";
+        case LVL_ERROR: return "ERR";
+        default:        return "???";
+    }
+}
+
+const char* catName(Category cat) {
+    switch (cat) {
+        case CAT_SYSTEM: return "SYS";
+        case CAT_WIFI:   return "WIFI";
+        case CAT_NTP:    return "NTP";
+        case CAT_MCP:    return "MCP";
+        case CAT_RELAY:  return "RELAY";
+        case CAT_INPUT:  return "INPUT";
+        case CAT_WEB:    return "WEB";
+        case CAT_CONFIG: return "CONF";
+        case CAT_TIMER:  return "TIMER";
+        default:         return "???";
+    }
+}
+
+void begin(Level minLevel, uint16_t enabledCategories) {
+    g_minLevel = minLevel;
+    g_catMask = enabledCategories;
+}
+
+void catEnable(Category cat, bool enable) {
+    if (enable) {
+        g_catMask |= (uint16_t)cat;
+    } else {
+        g_catMask &= ~(uint16_t)cat;
+    }
+}
+
+void catSet(uint16_t mask) {
+    g_catMask = mask;
+}
+
+uint16_t catGet() {
+    return g_catMask;
+}
+
+void enableAll() {
+    g_catMask = CAT_ALL;
+}
+
+void disableAll() {
+    g_catMask = 0;
+}
+
+bool isTimeSynced() {
+    return false;
+}
+
+void formatTime(char* buf, size_t len, time_t sec, uint32_t ms) {
+    (void)sec;      // Virtual clock only
+    snprintf(buf, len, "%lu.%03lu", (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+}
+
+void formatTimestamp(char* buf, size_t len) {
+    formatTime(buf, len, 0, millis());
+}
+
+void setLevel(Level level) {
+    g_minLevel = level;
+}
+
+Level getLevel() {
+    return g_minLevel;
+}
+
+void logf(Level lvl, Category cat, const char* fmt, ...) {
+    char ts[24];
+    formatTimestamp(ts, sizeof(ts));
+    fprintf(stderr, "[%s] [%s] [%s] ", ts, levelName(lvl), catName(cat));
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+void logt(Level lvl, Category cat, const char* fmt, const uint8_t* args, uint8_t len, bool truncated) {
+    (void)args;
+    fprintf(stderr, "[%s] [%s] <%s> (%u Bytes%s)\n", levelName(lvl), catName(cat), fmt, len,
+            truncated ? ", gekuerzt" : "");
+}
+
+void flush() {
+    fflush(stderr);
+}
+
+} // namespace dbg
+
+namespace crashlog {
+
+void record(uint8_t lvl, uint16_t cat, const char* fmt, const uint8_t* args, uint8_t len, bool truncated) {
+    (void)lvl;
+    (void)cat;
+    (void)fmt;
+    (void)args;
+    (void)len;
+    (void)truncated;
+}
+
+} // namespace crashlog
@@ -0,0 +1,412 @@
+// ============================================================
+// Virtual-time simulator of the board logic (env:native-sim)
+// Runs iologic, the input filters, auto-off and the broadcast
+// pacing (framepace) on the native HAL: the IO scan every
+// SIM_SCAN_MS, the housekeeping/broadcast tick every SIM_HK_MS and
+// bistable relay pulses of SIM_PULSE_MS, all on a virtual clock.
+// The same trace and options always give the same numbers.
+//
+//   pio run -e native-sim
+//   .pio/build/native-sim/program --scenario mixed --seed 7 --duration 120
+//   .pio/build/native-sim/program --trace recorded.txt --timeline out.csv
+//   .pio/build/native-sim/program --scenario bounce --dump bounce.txt
+//   .pio/build/native-sim/program --scenario bounce --rules stairs.txt
+//
+// Reported distributions (virtual milliseconds):
+//   edge->request  raw input edge -> relay request (scan latency)
+//   edge->frame    raw input edge -> first frame showing the relay
+//   cmd->request   client command -> relay request (incl. command queue wait)
+//   cmd->frame     client command -> first frame showing the relay
+//   switch->frame  relay switched -> first frame showing it
+// and the events lost on the way (input ring overflow, rejected
+// commands, replaced relay requests, superseded changes, coalesced
+// frames). With
+// --rules a relay request in a scan without a mapped input edge is
+// put down to the earliest edge of that scan.
+// ============================================================
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+#include "hal_native.h"
+#include "iologic.h"
+#include "framepace.h"
+#include "cmdqueue.h"
+#include "stateproto.h"
+#include "configblob.h"
+#include "inputfilter.h"
+#include "swtools.h"
+#include "simtrace.h"
+
+#ifndef SIM_SCAN_MS
+#define SIM_SCAN_MS 2      // IO_SCAN_MS of the firmware
+#endif
+#ifndef SIM_HK_MS
+#define SIM_HK_MS 10       // HK_PERIOD_MS of the firmware
+#endif
+#ifndef SIM_PULSE_MS
+#define SIM_PULSE_MS RELAY_PULSE_MS
+#endif
+
+struct Options {
+    const char* scenario;
+    const char* tracePath;
+    const char* dumpPath;
+    const char* timelinePath;
+    const char* rulesPath;
+    uint32_t seed;
+    int64_t durationUs;
+    int64_t scanUs;
+    int64_t hkUs;
+    int64_t pulseUs;
+    bool log;
+};
+
+// --- Latency distribution ---
+
+class Dist {
+public:
+    explicit Dist(const char* name) : m_name(name) {}
+
+    void add(int64_t us) { m_v.push_back(us); }
+
+    void print() {
+        if (m_v.empty()) {
+            printf("%-14s %7u %8s %8s %8s %8s %8s\n", m_name, 0u, "-", "-", "-", "-", "-");
+            return;
+        }
+        std::sort(m_v.begin(), m_v.end());
+        printf("%-14s %7u %8.3f %8.3f %8.3f %8.3f %8.3f\n", m_name, (unsigned)m_v.size(),
+               m_v.front() / 1000.0, pct(50) / 1000.0, pct(90) / 1000.0, pct(99) / 1000.0,
+               m_v.back() / 1000.0);
+    }
+
+private:
+    // Nearest-rank percentile (m_v sorted)
+    int64_t pct(uint32_t p) const {
+        size_t rank = (m_v.size() * p + 99) / 100;
+        return m_v[rank ? rank - 1 : 0];
+    }
+
+    const char* m_name;
+    std::vector<int64_t> m_v;
+};
+
+// --- Attribution of relay changes to their cause ---
+
+enum Origin : uint8_t {
+    ORG_NONE = 0,
+    ORG_EDGE,
+    ORG_CMD,
+};
+
+struct Change {
+    uint8_t origin;
+    bool    on;
+    bool    switched;
+    int64_t srcUs;          // Edge / command time
+    int64_t switchedUs;
+};
+
+static Change s_change[NUM_CHANNELS];
+static int64_t s_rise[NUM_CHANNELS];    // First rising edge since the last scan, -1 = none
+static int64_t s_cmdUs = -1;            // Post time of the command being executed, -1 = none
+static bool s_inScan = false;
+static FILE* s_timeline = nullptr;
+
+static Dist s_edgeReq("edge->request");
+static Dist s_edgeFrame("edge->frame");
+static Dist s_cmdReq("cmd->request");
+static Dist s_cmdFrame("cmd->frame");
+static Dist s_switchFrame("switch->frame");
+static uint32_t s_superseded = 0;
+static uint32_t s_edges = 0;
+static uint32_t s_commands = 0;
+static uint32_t s_scans = 0;
+static uint32_t s_frames = 0;
+
+static void timeline(const char* event, int ch, long value) {
+    if (s_timeline) fprintf(s_timeline, "%lld,%s,%d,%ld\n", (long long)hal::nowUs(), event, ch, value);
+}
+
+static void onRelay(uint8_t ch, bool on, bool done) {
+    const int64_t now = hal::nowUs();
+    timeline(done ? "switched" : "request", ch, on);
+    Change& c = s_change[ch];
+    if (done) {
+        if (c.origin != ORG_NONE && c.on == on && !c.switched) {
+            c.switched = true;
+            c.switchedUs = now;
+        }
+        return;
+    }
+
+    int64_t src = -1;
+    uint8_t origin = ORG_NONE;
+    if (s_inScan) {
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (iologic::inputMapping[i] == ch && s_rise[i] >= 0) {
+                src = s_rise[i];
+                origin = ORG_EDGE;
+                s_rise[i] = -1;
+                break;
+            }
+        }
+        if (origin == ORG_NONE && iologic::ruleStats().rows) {
+            // Rule: the first edge of the scan (not consumed, it may drive more relays)
+            for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+                if (s_rise[i] >= 0 && (src < 0 || s_rise[i] < src)) src = s_rise[i];
+            }
+            if (src >= 0) origin = ORG_EDGE;
+        }
+    } else if (s_cmdUs >= 0) {
+        src = s_cmdUs;
+        origin = ORG_CMD;
+    }
+    if (origin == ORG_NONE) return;     // Auto-off, restore
+    if (c.origin != ORG_NONE) s_superseded++;
+    c.origin = origin;
+    c.on = on;
+    c.switched = false;
+    c.srcUs = src;
+    (origin == ORG_EDGE ? s_edgeReq : s_cmdReq).add(now - src);
+}
+
+// A frame went out with this output image
+static void onFrame(uint16_t outputs, size_t bytes) {
+    const int64_t now = hal::nowUs();
+    s_frames++;
+    timeline("frame", -1, (long)bytes);
+    for (uint8_t ch = 0; ch < NUM_CHANNELS; ch++) {
+        Change& c = s_change[ch];
+        if (c.origin == ORG_NONE || !c.switched) continue;
+        if (((outputs >> ch) & 1) != (c.on ? 1 : 0)) continue;
+        (c.origin == ORG_EDGE ? s_edgeFrame : s_cmdFrame).add(now - c.srcUs);
+        s_switchFrame.add(now - c.switchedUs);
+        c.origin = ORG_NONE;
+    }
+}
+
+// --- The two firmware tasks ---
+
+static void ioScan() {
+    uint8_t fx = 0;
+    bool commands = false;
+    cmdqueue::Message m;
+    while (cmdqueue::pop(m)) {
+        s_cmdUs = m.postUs;
+        fx |= iologic::execute(m.cmd);
+        s_cmdUs = -1;
+        commands = true;
+    }
+    cmdqueue::endCycle();
+    s_inScan = true;
+    fx |= iologic::scan();
+    s_inScan = false;
+    s_scans++;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) s_rise[i] = -1;
+    if ((fx & iologic::FX_STATE) || commands) framepace::request(millis());
+}
+
+static void housekeeping() {
+    static stateproto::Snapshot last;
+    static uint32_t seq = 0;
+    static char buf[STATE_JSON_MAX];
+    if (!framepace::tick(millis(), nullptr)) return;
+
+    stateproto::Snapshot snap;
+    iologic::capture(snap, hal::nowUs());
+    snap.mcp = 3;
+    snap.ntp = false;
+    dbg::formatTimestamp(snap.time, sizeof(snap.time));
+    stateproto::JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    const bool changed = stateproto::writeDelta(w, last, snap, seq + 1);
+    w.endObject();
+    if (!changed) return;
+    seq++;
+    last = snap;
+    hal::transportSend(0, (const uint8_t*)buf, w.length(), false);
+    onFrame(snap.outputs, w.length());
+}
+
+static void apply(const simtrace::Event& e) {
+    if (e.kind == simtrace::EV_INPUT) {
+        s_edges++;
+        timeline("in", e.ch, e.level);
+        if (nativehal::inputAt(e.ch, e.level != 0, e.tsUs) && e.level && s_rise[e.ch] < 0) {
+            s_rise[e.ch] = e.tsUs;
+        }
+        return;
+    }
+    s_commands++;
+    timeline(simtrace::commandName(e.cmd.cmd), e.cmd.ch, (long)e.cmd.value);
+    cmdqueue::post(e.cmd);  // Handler (async TCP task): the next IO scan executes it
+}
+
+// --- Setup / run ---
+
+static bool loadRules(const char* path) {
+    static char text[RULES_TEXT_MAX];
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Regeln %s nicht lesbar\n", path);
+        return false;
+    }
+    const size_t n = fread(text, 1, sizeof(text) - 1, f);
+    text[n] = '\0';
+    fclose(f);
+    rules::Error err;
+    if (!iologic::setRules(text, &err)) {
+        fprintf(stderr, "%s: %s (Zeichen %u)\n", path, err.msg, err.pos);
+        return false;
+    }
+    return true;
+}
+
+static bool setupBoard(const Options& o) {
+    dbg::begin(o.log ? dbg::LVL_INFO : dbg::LVL_NONE, dbg::CAT_ALL);
+    nativehal::reset();
+    nativehal::setRelayDelayUs(o.pulseUs);
+    nativehal::onRelay(onRelay);
+    cmdqueue::begin();
+
+    configblob::Config c;
+    configblob::defaults(c);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        iologic::inputMapping[i] = c.inputMapping[i];
+        iologic::autoOffSeconds[i] = c.autoOffSeconds[i];
+        iologic::inputMode[i] = c.inputMode[i];
+        iologic::inputFilterMs[i] = c.inputFilterMs[i];
+        iologic::s0Imp[i] = c.s0Imp[i];
+        iologic::applyInputMode(i);
+        s_rise[i] = -1;
+    }
+    if (o.rulesPath && !loadRules(o.rulesPath)) return false;
+    iologic::begin();
+    return true;
+}
+
+static void run(const std::vector<simtrace::Event>& trace, const Options& o) {
+    size_t next = 0;
+    int64_t nextScan = 0;
+    int64_t nextHk = 0;
+    for (;;) {
+        int64_t t = nextScan < nextHk ? nextScan : nextHk;
+        if (next < trace.size() && trace[next].tsUs < t) t = trace[next].tsUs;
+        if (t > o.durationUs) break;
+        nativehal::advanceTo(t);
+        while (next < trace.size() && trace[next].tsUs <= t) apply(trace[next++]);
+        if (nextScan <= t) {
+            ioScan();
+            nextScan += o.scanUs;
+        }
+        if (nextHk <= t) {
+            housekeeping();
+            nextHk += o.hkUs;
+        }
+    }
+}
+
+static void report(const Options& o) {
+    printf("Szenario %s, Seed %u, %.1f s virtuell, Scan %.1f ms, HK %.1f ms, Puls %.1f ms\n",
+           o.tracePath ? o.tracePath : o.scenario, o.seed, o.durationUs / 1e6,
+           o.scanUs / 1000.0, o.hkUs / 1000.0, o.pulseUs / 1000.0);
+    printf("%u Flanken, %u Kommandos, %u Scans, %u Relais-Anforderungen\n\n",
+           s_edges, s_commands, s_scans, nativehal::relayRequests());
+    printf("%-14s %7s %8s %8s %8s %8s %8s  [ms]\n", "latency", "count", "min", "p50", "p90", "p99", "max");
+    s_edgeReq.print();
+    s_edgeFrame.print();
+    s_cmdReq.print();
+    s_cmdFrame.print();
+    s_switchFrame.print();
+    printf("\n%-18s %8u  (input ring full)\n", "input_dropped", hal::inputDropped());
+    printf("%-18s %8u  (command queue full)\n", "cmd_rejected", cmdqueue::getStats().rejected);
+    printf("%-18s %8u  (queued relay request replaced)\n", "relay_overruns", nativehal::relayOverruns());
+    printf("%-18s %8u  (change replaced before a frame showed it)\n", "superseded", s_superseded);
+    printf("%-18s %8u  (changes merged into a pending frame)\n", "frames_coalesced", framepace::coalesced());
+    printf("%-18s %8u  (%u bytes)\n", "frames", s_frames, nativehal::sentBytes());
+    const iologic::RuleStats rs = iologic::ruleStats();
+    if (rs.rows) {
+        printf("%-18s %8u  (rule step avg %u ns, max %u ns, host time)\n", "rules", rs.rows,
+               rs.avgCycles, rs.maxCycles);
+    }
+}
+
+static bool parseArgs(int argc, char** argv, Options& o) {
+    o.scenario = "mixed";
+    o.tracePath = nullptr;
+    o.dumpPath = nullptr;
+    o.timelinePath = nullptr;
+    o.rulesPath = nullptr;
+    o.seed = 1;
+    o.durationUs = 60000000;
+    o.scanUs = SIM_SCAN_MS * 1000;
+    o.hkUs = SIM_HK_MS * 1000;
+    o.pulseUs = SIM_PULSE_MS * 1000;
+    o.log = false;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(a, "--log") == 0) {
+            o.log = true;
+            continue;
+        }
+        if (!v) return false;
+        i++;
+        if (strcmp(a, "--scenario") == 0) o.scenario = v;
+        else if (strcmp(a, "--trace") == 0) o.tracePath = v;
+        else if (strcmp(a, "--dump") == 0) o.dumpPath = v;
+        else if (strcmp(a, "--timeline") == 0) o.timelinePath = v;
+        else if (strcmp(a, "--rules") == 0) o.rulesPath = v;
+        else if (strcmp(a, "--seed") == 0) o.seed = (uint32_t)strtoul(v, nullptr, 0);
+        else if (strcmp(a, "--duration") == 0) o.durationUs = (int64_t)(atof(v) * 1e6);
+        else if (strcmp(a, "--scan-ms") == 0) o.scanUs = (int64_t)(atof(v) * 1000);
+        else if (strcmp(a, "--hk-ms") == 0) o.hkUs = (int64_t)(atof(v) * 1000);
+        else if (strcmp(a, "--pulse-ms") == 0) o.pulseUs = (int64_t)(atof(v) * 1000);
+        else return false;
+    }
+    return o.scanUs > 0 && o.hkUs > 0 && o.durationUs > 0;
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        fprintf(stderr, "usage: %s [--scenario bounce|ac|s0|storm|mixed] [--seed n] [--duration s]\n"
+                        "          [--trace file] [--dump file] [--timeline file.csv] [--rules file]\n"
+                        "          [--scan-ms ms] [--hk-ms ms] [--pulse-ms ms] [--log]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<simtrace::Event> trace;
+    if (o.tracePath) {
+        FILE* f = fopen(o.tracePath, "r");
+        if (!f || !simtrace::load(f, trace)) {
+            fprintf(stderr, "Trace %s nicht lesbar\n", o.tracePath);
+            return 2;
+        }
+        fclose(f);
+        o.durationUs = trace.empty() ? 0 : trace.back().tsUs + 1000000;   // Let the last change settle
+    } else if (!simtrace::generate(trace, o.scenario, o.seed, o.durationUs)) {
+        fprintf(stderr, "Unbekanntes Szenario: %s\n", o.scenario);
+        return 2;
+    }
+
+    if (o.dumpPath) {
+        FILE* f = fopen(o.dumpPath, "w");
+        if (!f) return 2;
+        simtrace::save(trace, f);
+        fclose(f);
+    }
+    if (o.timelinePath) {
+        s_timeline = fopen(o.timelinePath, "w");
+        if (!s_timeline) return 2;
+        fprintf(s_timeline, "t_us,event,ch,value\n");
+    }
+
+    if (!setupBoard(o)) return 2;
+    run(trace, o);
+    report(o);
+    if (s_timeline) fclose(s_timeline);
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include "simtrace.h"
+#include <string.h>
+#include <algorithm>
+#include "pin_config.h"
+#include "inputfilter.h"
+
+namespace simtrace {
+
+static const char* const MODE_NAMES[] = {"dc", "ac", "s0"};
+
+// --- Deterministic random numbers ---
+
+struct Rng {
+    uint32_t s;
+
+    explicit Rng(uint32_t seed) : s(seed ? seed : 0x9E3779B9UL) {}
+
+    uint32_t next() {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+
+    // lo..hi inclusive
+    int64_t range(int64_t lo, int64_t hi) {
+        return lo + (int64_t)(next() % (uint32_t)(hi - lo + 1));
+    }
+};
+
+// --- Building blocks ---
+
+static void addInput(std::vector<Event>& out, int64_t t, uint8_t ch, bool level) {
+    Event e = {};
+    e.tsUs = t;
+    e.kind = EV_INPUT;
+    e.ch = ch;
+    e.level = level ? 1 : 0;
+    out.push_back(e);
+}
+
+static void addCommand(std::vector<Event>& out, int64_t t, uint8_t cmd, uint8_t ch, int32_t value) {
+    Event e = {};
+    e.tsUs = t;
+    e.kind = EV_COMMAND;
+    e.cmd.cmd = cmd;
+    e.cmd.ch = ch;
+    e.cmd.value = value;
+    out.push_back(e);
+}
+
+// Contact closing or opening with a few bounces, ends at level
+static int64_t addBouncy(std::vector<Event>& out, Rng& rng, int64_t t, uint8_t ch, bool level) {
+    const int64_t flips = rng.range(1, 3) * 2;   // Even: the last edge has the final level
+    for (int64_t k = 0; k < flips; k++) {
+        addInput(out, t, ch, (k % 2 == 0) ? level : !level);
+        t += rng.range(50, 1500);
+    }
+    addInput(out, t, ch, level);
+    return t;
+}
+
+// Push button on a dry contact, pressed every 0.3 .. 3 s
+static void genBounce(std::vector<Event>& out, Rng& rng, uint8_t ch, uint8_t relay, int64_t dur) {
+    addCommand(out, 0, binproto::CMD_INMODE, ch, inputfilter::MODE_DC);
+    addCommand(out, 0, binproto::CMD_MAP, ch, relay);
+    int64_t t = rng.range(100000, 1000000);
+    while (t < dur) {
+        t = addBouncy(out, rng, t, ch, true);
+        t += rng.range(80000, 800000);
+        t = addBouncy(out, rng, t, ch, false);
+        t += rng.range(300000, 3000000);
+    }
+}
+
+// 8 VAC through the optocoupler: 50 Hz pulse train while switched on
+static void genAc(std::vector<Event>& out, Rng& rng, uint8_t ch, uint8_t relay, int64_t dur) {
+    addCommand(out, 0, binproto::CMD_INMODE, ch, inputfilter::MODE_AC);
+    addCommand(out, 0, binproto::CMD_MAP, ch, relay);
+    int64_t t = rng.range(100000, 1000000);
+    while (t < dur) {
+        const int64_t end = t + rng.range(500000, 5000000);
+        for (int64_t p = t; p < end && p < dur; p += 20000) {
+            const int64_t jitter = rng.range(0, 300);
+            addInput(out, p + jitter, ch, true);
+            addInput(out, p + jitter + rng.range(6000, 10000), ch, false);
+        }
+        t = end + rng.range(500000, 5000000);
+    }
+}
+
+// S0 meter: 30 ms impulses, load changes and fast bursts
+static void genS0(std::vector<Event>& out, Rng& rng, uint8_t ch, int64_t dur) {
+    addCommand(out, 0, binproto::CMD_INMODE, ch, inputfilter::MODE_COUNTER);
+    int64_t t = rng.range(10000, 500000);
+    int64_t interval = rng.range(100000, 2000000);
+    int64_t burst = 0;
+    while (t < dur) {
+        addInput(out, t, ch, true);
+        addInput(out, t + 30000, ch, false);
+        if (burst > 0) {
+            burst--;
+            t += rng.range(40000, 60000);
+            continue;
+        }
+        if (rng.range(0, 19) == 0) burst = rng.range(20, 100);
+        if (rng.range(0, 9) == 0) interval = rng.range(100000, 2000000);
+        t += interval;
+    }
+}
+
+// Bursts of client commands on the given relays
+static void genStorm(std::vector<Event>& out, Rng& rng, uint8_t first, uint8_t count, int64_t dur) {
+    int64_t t = rng.range(200000, 1000000);
+    while (t < dur) {
+        const int64_t n = rng.range(20, 200);
+        for (int64_t k = 0; k < n && t < dur; k++) {
+            const uint8_t ch = (uint8_t)(first + rng.range(0, count - 1));
+            const int64_t kind = rng.range(0, 9);
+            if (kind < 7) addCommand(out, t, binproto::CMD_TOGGLE, ch, 0);
+            else if (kind < 9) addCommand(out, t, binproto::CMD_SET, ch, (int32_t)rng.range(0, 1));
+            else addCommand(out, t, binproto::CMD_TIMER, ch, (int32_t)rng.range(0, 10));
+            t += rng.range(100, 2000);
+        }
+        t += rng.range(1000000, 4000000);
+    }
+}
+
+static bool eventBefore(const Event& a, const Event& b) {
+    return a.tsUs < b.tsUs;
+}
+
+bool generate(std::vector<Event>& out, const char* scenario, uint32_t seed, int64_t durationUs) {
+    Rng rng(seed);
+    out.clear();
+    if (strcmp(scenario, "bounce") == 0) {
+        for (uint8_t i = 0; i < 4; i++) genBounce(out, rng, i, i, durationUs);
+    } else if (strcmp(scenario, "ac") == 0) {
+        for (uint8_t i = 0; i < 4; i++) genAc(out, rng, i, i, durationUs);
+    } else if (strcmp(scenario, "s0") == 0) {
+        for (uint8_t i = 0; i < 4; i++) genS0(out, rng, i, durationUs);
+    } else if (strcmp(scenario, "storm") == 0) {
+        genStorm(out, rng, 0, NUM_CHANNELS, durationUs);
+    } else if (strcmp(scenario, "mixed") == 0) {
+        addCommand(out, 0, binproto::CMD_TIMER, 0, 5);
+        for (uint8_t i = 0; i < 4; i++) genBounce(out, rng, i, i, durationUs);
+        for (uint8_t i = 4; i < 6; i++) genAc(out, rng, i, i, durationUs);
+        for (uint8_t i = 6; i < 8; i++) genS0(out, rng, i, durationUs);
+        genStorm(out, rng, 8, 4, durationUs);
+    } else {
+        return false;
+    }
+    std::stable_sort(out.begin(), out.end(), eventBefore);
+    return true;
+}
+
+// --- Text form ---
+
+const char* commandName(uint8_t cmd) {
+    switch (cmd) {
+        case binproto::CMD_TOGGLE: return "toggle";
+        case binproto::CMD_SET:    return "set";
+        case binproto::CMD_MAP:    return "map";
+        case binproto::CMD_TIMER:  return "timer";
+        case binproto::CMD_INMODE: return "inmode";
+        case binproto::CMD_S0IMP:  return "s0imp";
+        case binproto::CMD_ALLOFF: return "alloff";
+        default:                   return "?";
+    }
+}
+
+static bool parseCommand(const char* name, const char* args, binproto::Command& c) {
+    int a = 0;
+    int b = 0;
+    char mode[8] = "";
+    c.ch = 0;
+    c.value = 0;
+    if (strcmp(name, "toggle") == 0) {
+        c.cmd = binproto::CMD_TOGGLE;
+        if (sscanf(args, "%d", &a) != 1) return false;
+    } else if (strcmp(name, "set") == 0) {
+        c.cmd = binproto::CMD_SET;
+        if (sscanf(args, "%d %d", &a, &b) != 2) return false;
+    } else if (strcmp(name, "map") == 0) {
+        c.cmd = binproto::CMD_MAP;
+        if (sscanf(args, "%d %d", &a, &b) != 2) return false;
+    } else if (strcmp(name, "timer") == 0) {
+        c.cmd = binproto::CMD_TIMER;
+        if (sscanf(args, "%d %d", &a, &b) != 2) return false;
+    } else if (strcmp(name, "s0imp") == 0) {
+        c.cmd = binproto::CMD_S0IMP;
+        if (sscanf(args, "%d %d", &a, &b) != 2) return false;
+    } else if (strcmp(name, "inmode") == 0) {
+        c.cmd = binproto::CMD_INMODE;
+        if (sscanf(args, "%d %7s %d", &a, mode, &b) < 2) return false;
+        int m = -1;
+        for (int k = 0; k < 3; k++) {
+            if (strcmp(mode, MODE_NAMES[k]) == 0) m = k;
+        }
+        if (m < 0) return false;
+        b = m | (b << 8);
+    } else if (strcmp(name, "alloff") == 0) {
+        c.cmd = binproto::CMD_ALLOFF;
+    } else {
+        return false;
+    }
+    c.ch = (uint8_t)a;
+    c.value = b;
+    return true;
+}
+
+bool load(FILE* f, std::vector<Event>& out) {
+    char line[160];
+    unsigned lineNo = 0;
+    out.clear();
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        long long ts;
+        char kind[8];
+        int used = 0;
+        if (sscanf(line, " %lld %7s %n", &ts, kind, &used) < 2) {
+            if (strspn(line, " \t\r\n") == strlen(line)) continue;     // Blank
+            fprintf(stderr, "Trace Zeile %u: ungueltig\n", lineNo);
+            return false;
+        }
+        const char* rest = line + used;
+        Event e = {};
+        e.tsUs = ts;
+        bool ok = false;
+        if (strcmp(kind, "in") == 0) {
+            int ch;
+            int level;
+            ok = sscanf(rest, "%d %d", &ch, &level) == 2 && ch >= 0 && ch < NUM_CHANNELS;
+            e.kind = EV_INPUT;
+            e.ch = (uint8_t)ch;
+            e.level = level ? 1 : 0;
+        } else if (strcmp(kind, "cmd") == 0) {
+            char name[12];
+            int n = 0;
+            e.kind = EV_COMMAND;
+            ok = sscanf(rest, "%11s %n", name, &n) == 1 && parseCommand(name, rest + n, e.cmd);
+        }
+        if (!ok) {
+            fprintf(stderr, "Trace Zeile %u: ungueltig\n", lineNo);
+            return false;
+        }
+        out.push_back(e);
+    }
+    std::stable_sort(out.begin(), out.end(), eventBefore);
+    return true;
+}
+
+void save(const std::vector<Event>& t, FILE* f) {
+    fprintf(f, "# t_us kind args (IO-Hutschienenboard simulator trace)\n");
+    for (size_t k = 0; k < t.size(); k++) {
+        const Event& e = t[k];
+        if (e.kind == EV_INPUT) {
+            fprintf(f, "%lld in %u %u\n", (long long)e.tsUs, e.ch, e.level);
+            continue;
+        }
+        const binproto::Command& c = e.cmd;
+        fprintf(f, "%lld cmd %s", (long long)e.tsUs, commandName(c.cmd));
+        switch (c.cmd) {
+            case binproto::CMD_TOGGLE:
+                fprintf(f, " %u", c.ch);
+                break;
+            case binproto::CMD_INMODE:
+                fprintf(f, " %u %s %d", c.ch, MODE_NAMES[(c.value & 0xFF) % 3], (int)(c.value >> 8));
+                break;
+            case binproto::CMD_ALLOFF:
+                break;
+            default:
+                fprintf(f, " %u %d", c.ch, (int)c.value);
+                break;
+        }
+        fputc('\n', f);
+    }
+}
+
+} // namespace simtrace
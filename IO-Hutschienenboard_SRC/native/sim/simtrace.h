@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "binproto.h"
+
+// ============================================================
+// Input / command traces for the simulator (env:native-sim)
+// A trace is a time-ordered list of raw input edges and client
+// commands. Text form, one event per line, '#' starts a comment:
+//
+//   # t_us    kind  args
+//   0         cmd   map 0 0          # same names/args as the JSON commands
+//   0         cmd   inmode 4 ac 0
+//   1250000   in    0 1              # raw edge: channel, level
+//   1250400   in    0 0
+//   2000000   cmd   toggle 9
+//
+// Commands: toggle ch | set ch 0/1 | map in out | timer ch secs |
+//           inmode ch dc/ac/s0 ms | s0imp ch imp | alloff
+//
+// The generators are seeded (xorshift32), so a scenario and a
+// seed always give the same trace on every machine.
+//
+// Usage:
+//   std::vector<simtrace::Event> t;
+//   simtrace::generate(t, "mixed", 42, 60000000);
+//   simtrace::save(t, f);    // replay later with simtrace::load()
+// ============================================================
+
+namespace simtrace {
+
+enum Kind : uint8_t {
+    EV_INPUT = 0,       // ch, value = level
+    EV_COMMAND,         // cmd (binproto::Command)
+};
+
+struct Event {
+    int64_t tsUs;
+    uint8_t kind;
+    uint8_t ch;         // EV_INPUT
+    uint8_t level;      // EV_INPUT
+    binproto::Command cmd;
+};
+
+// Parse a text trace; false (with a message on stderr) on a bad line
+bool load(FILE* f, std::vector<Event>& out);
+void save(const std::vector<Event>& t, FILE* f);
+
+// Synthetic scenario: "bounce", "ac", "s0", "storm" or "mixed"
+bool generate(std::vector<Event>& out, const char* scenario, uint32_t seed, int64_t durationUs);
+
+const char* commandName(uint8_t cmd);
+
+} // namespace simtrace
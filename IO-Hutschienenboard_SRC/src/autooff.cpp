@@ -0,0 +1,223 @@
+#include "autooff.h"
+#include "pin_config.h"
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+
+#define AUTOOFF_MAGIC 0x414F4646UL   // "AOFF"
+
+namespace autooff {
+
+struct Entry {
+    int64_t startUs;
+    int64_t durationUs;
+};
+
+// Survives warm resets (not initialized at boot)
+struct RtcImage {
+    uint32_t magic;
+    uint32_t crc;                    // Over armed + entry
+    uint16_t armed;                  // bit i = channel i armed
+    Entry    entry[NUM_CHANNELS];
+    int64_t  heartbeatUs;            // Last "alive" time
+    int64_t  heartbeatInv;           // ~heartbeatUs, torn-write check
+};
+
+static RTC_NOINIT_ATTR RtcImage s_rtc;
+
+static Entry s_entry[NUM_CHANNELS];
+static uint8_t s_order[NUM_CHANNELS];   // Armed channels, earliest deadline first
+static uint8_t s_count = 0;
+static uint16_t s_restored = 0;
+static DueFn s_due = nullptr;
+static esp_timer_handle_t s_timer = nullptr;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Helpers (call with s_mux held) ---
+
+static inline int64_t deadline(uint8_t ch) {
+    return s_entry[ch].startUs + s_entry[ch].durationUs;
+}
+
+static uint32_t imageCrc(const RtcImage& img) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)&img.armed, sizeof(img.armed));
+    return esp_rom_crc32_le(crc, (const uint8_t*)img.entry, sizeof(img.entry));
+}
+
+static void saveImage() {
+    uint16_t mask = 0;
+    for (uint8_t k = 0; k < s_count; k++) mask |= (uint16_t)(1 << s_order[k]);
+    s_rtc.armed = mask;
+    memcpy(s_rtc.entry, s_entry, sizeof(s_entry));
+    s_rtc.crc = imageCrc(s_rtc);
+    s_rtc.magic = AUTOOFF_MAGIC;
+}
+
+static int8_t indexOf(uint8_t ch) {
+    for (uint8_t k = 0; k < s_count; k++) {
+        if (s_order[k] == ch) return (int8_t)k;
+    }
+    return -1;
+}
+
+static void removeAt(uint8_t k) {
+    for (; k + 1 < s_count; k++) s_order[k] = s_order[k + 1];
+    s_count--;
+}
+
+// Insert keeping the deadline order (stable for equal deadlines)
+static void insert(uint8_t ch) {
+    const int64_t d = deadline(ch);
+    uint8_t k = s_count;
+    while (k > 0 && deadline(s_order[k - 1]) > d) {
+        s_order[k] = s_order[k - 1];
+        k--;
+    }
+    s_order[k] = ch;
+    s_count++;
+}
+
+static void armTimer() {
+    if (!s_timer) return;
+    esp_timer_stop(s_timer);
+    if (s_count == 0) return;
+    const int64_t now = esp_timer_get_time();
+    const int64_t next = deadline(s_order[0]);
+    esp_timer_start_once(s_timer, next > now ? (uint64_t)(next - now) : 1);
+}
+
+// --- Timer callback (esp_timer task) ---
+
+static void onTimer(void*) {
+    if (s_due) s_due();
+}
+
+// --- Init ---
+
+void begin(DueFn due, bool restore) {
+    s_due = due;
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.name = "autooff";
+    esp_timer_create(&args, &s_timer);
+
+    // Restore from RTC memory: each timer keeps the time it had left at the last heartbeat
+    const bool valid = s_rtc.magic == AUTOOFF_MAGIC && s_rtc.crc == imageCrc(s_rtc) &&
+                       s_rtc.heartbeatInv == ~s_rtc.heartbeatUs;
+    const int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_mux);
+    s_count = 0;
+    s_restored = 0;
+    if (valid && restore) {
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (!((s_rtc.armed >> i) & 1)) continue;
+            const Entry& e = s_rtc.entry[i];
+            const int64_t elapsed = s_rtc.heartbeatUs - e.startUs;
+            if (elapsed < 0 || elapsed >= e.durationUs) continue;   // Expired during the reset
+            s_entry[i].durationUs = e.durationUs;
+            s_entry[i].startUs = now - elapsed;
+            insert(i);
+            s_restored |= (uint16_t)(1 << i);
+        }
+    }
+    saveImage();
+    s_rtc.heartbeatUs = now;
+    s_rtc.heartbeatInv = ~now;
+    armTimer();
+    portEXIT_CRITICAL(&s_mux);
+}
+
+uint16_t restoredMask() {
+    return s_restored;
+}
+
+// --- Scheduling ---
+
+void arm(uint8_t ch, uint32_t seconds, int64_t nowUs) {
+    if (ch >= NUM_CHANNELS) return;
+    portENTER_CRITICAL(&s_mux);
+    const int8_t k = indexOf(ch);
+    if (k >= 0) removeAt((uint8_t)k);
+    if (seconds > 0) {
+        s_entry[ch].startUs = nowUs;
+        s_entry[ch].durationUs = (int64_t)seconds * 1000000LL;
+        insert(ch);
+    }
+    saveImage();
+    armTimer();
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void retime(uint8_t ch, uint32_t seconds) {
+    if (ch >= NUM_CHANNELS) return;
+    portENTER_CRITICAL(&s_mux);
+    const int8_t k = indexOf(ch);
+    if (k >= 0) {
+        removeAt((uint8_t)k);
+        if (seconds > 0) {
+            s_entry[ch].durationUs = (int64_t)seconds * 1000000LL;
+            insert(ch);
+        }
+        saveImage();
+        armTimer();
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void cancel(uint8_t ch) {
+    if (ch >= NUM_CHANNELS) return;
+    portENTER_CRITICAL(&s_mux);
+    const int8_t k = indexOf(ch);
+    if (k >= 0) {
+        removeAt((uint8_t)k);
+        saveImage();
+        armTimer();
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+bool armed(uint8_t ch) {
+    portENTER_CRITICAL(&s_mux);
+    const bool a = indexOf(ch) >= 0;
+    portEXIT_CRITICAL(&s_mux);
+    return a;
+}
+
+uint32_t remainingSeconds(uint8_t ch, int64_t nowUs) {
+    uint32_t s = 0;
+    portENTER_CRITICAL(&s_mux);
+    if (indexOf(ch) >= 0) {
+        const int64_t left = deadline(ch) - nowUs;
+        if (left > 0) s = (uint32_t)((left + 999999LL) / 1000000LL);
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return s;
+}
+
+uint16_t takeExpired(int64_t nowUs) {
+    uint16_t due = 0;
+    portENTER_CRITICAL(&s_mux);
+    uint8_t n = 0;
+    while (n < s_count && deadline(s_order[n]) <= nowUs) {
+        due |= (uint16_t)(1 << s_order[n]);
+        n++;
+    }
+    if (n) {
+        for (uint8_t k = n; k < s_count; k++) s_order[k - n] = s_order[k];
+        s_count -= n;
+        saveImage();
+    }
+    armTimer();     // Also covers a callback that fired a little early
+    portEXIT_CRITICAL(&s_mux);
+    return due;
+}
+
+void heartbeat(int64_t nowUs) {
+    // No lock: a torn pair fails the ~ check and only costs the restore
+    s_rtc.heartbeatUs = nowUs;
+    s_rtc.heartbeatInv = ~nowUs;
+}
+
+} // namespace autooff
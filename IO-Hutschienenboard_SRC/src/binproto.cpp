@@ -0,0 +1,41 @@
+#include "binproto.h"
+#include <string.h>
+
+namespace binproto {
+
+void encodeState(const stateproto::Snapshot& s, uint32_t seq, uint8_t flags, StateFrame& out) {
+    out.version = BINPROTO_VERSION;
+    out.type = MSG_STATE;
+    out.channels = NUM_CHANNELS;
+    out.flags = flags;
+    if (s.ntp) out.flags |= SF_NTP;
+    if (s.mcp & 1) out.flags |= SF_MCP1;
+    if (s.mcp & 2) out.flags |= SF_MCP2;
+    out.seq = seq;
+    out.inputs = s.inputs;
+    out.outputs = s.outputs;
+    memcpy(out.mappings, s.mappings, sizeof(out.mappings));
+    memcpy(out.timers, s.timers, sizeof(out.timers));
+    memcpy(out.remaining, s.remaining, sizeof(out.remaining));
+}
+
+bool decodeCommand(const uint8_t* data, size_t len, Command& out) {
+    if (len != sizeof(CommandFrame)) return false;
+    CommandFrame f;
+    memcpy(&f, data, sizeof(f));
+    if (f.version != BINPROTO_VERSION || f.type != MSG_COMMAND) return false;
+    out.cmd = f.cmd;
+    out.ch = f.ch;
+    out.value = f.value;
+    return true;
+}
+
+void encodeCommand(const Command& c, CommandFrame& out) {
+    out.version = BINPROTO_VERSION;
+    out.type = MSG_COMMAND;
+    out.cmd = c.cmd;
+    out.ch = c.ch;
+    out.value = c.value;
+}
+
+} // namespace binproto
@@ -0,0 +1,153 @@
+#include "buttons.h"
+#include "pin_config.h"
+#include "mcpport.h"
+#include "swtools.h"
+#include <atomic>
+
+#define BTN_MASK ((uint16_t)((1u << NUM_CHANNELS) - 1))
+
+namespace buttons {
+
+static uint8_t s_chip = 0;
+static uint8_t s_intPin = 0;
+static bool s_ready = false;
+static TaskHandle_t s_task = nullptr;
+static std::atomic<uint16_t> s_pending{0};    // Presses not yet taken by the scan
+
+// Task state
+static uint16_t s_state = 0;                  // Debounced, 1 = down
+static uint16_t s_locked = 0;                 // Buttons within their lockout
+static uint32_t s_lockUntil[NUM_CHANNELS];
+static uint32_t s_reads = 0;
+static uint32_t s_presses = 0;
+static uint32_t s_bounces = 0;
+
+// --- ISR ---
+
+#if !SIMULATE_HW
+static void IRAM_ATTR onInt() {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+#endif
+
+// --- Debounce (button task) ---
+
+static void debounce(uint16_t level, uint32_t now) {
+    for (uint16_t m = s_locked; m; m &= (uint16_t)(m - 1)) {
+        const uint8_t b = (uint8_t)__builtin_ctz(m);
+        if ((int32_t)(now - s_lockUntil[b]) >= 0) s_locked &= (uint16_t)~(1u << b);
+    }
+    for (uint16_t diff = (uint16_t)(level ^ s_state); diff; diff &= (uint16_t)(diff - 1)) {
+        const uint8_t b = (uint8_t)__builtin_ctz(diff);
+        const uint16_t bit = (uint16_t)(1u << b);
+        if (s_locked & bit) {
+            s_bounces++;
+            continue;
+        }
+        s_state ^= bit;
+        s_locked |= bit;
+        s_lockUntil[b] = now + BTN_DEBOUNCE_MS;
+        if (level & bit) {
+            s_presses++;
+            s_pending.fetch_or(bit, std::memory_order_release);
+            dbg::debug(dbg::CAT_INPUT, "Taste %d gedrueckt", b + 1);
+        }
+    }
+}
+
+// One burst: INTFA/B, INTCAPA/B, GPIOA/B (reading clears the interrupt)
+static bool readButtons() {
+    uint8_t r[6];
+    if (!mcpport::readRegs(s_chip, mcpport::REG_INTFA, r, sizeof(r))) return false;
+    s_reads++;
+    const uint16_t intf = (uint16_t)(r[0] | (r[1] << 8));
+    const uint16_t cap = (uint16_t)(r[2] | (r[3] << 8));
+    const uint16_t gpio = (uint16_t)(r[4] | (r[5] << 8));
+    // Pins that interrupted: level at the interrupt (short presses), others: now
+    const uint16_t level = (uint16_t)((cap & intf) | (gpio & ~intf));
+    debounce(level & BTN_MASK, millis());
+    return true;
+}
+
+// Ticks until the first lockout ends, portMAX_DELAY if none
+static TickType_t settleWait() {
+    if (!s_locked) return portMAX_DELAY;
+    const uint32_t now = millis();
+    int32_t first = BTN_DEBOUNCE_MS;
+    for (uint16_t m = s_locked; m; m &= (uint16_t)(m - 1)) {
+        const int32_t left = (int32_t)(s_lockUntil[__builtin_ctz(m)] - now);
+        if (left < first) first = left;
+    }
+    return first > 0 ? pdMS_TO_TICKS(first) + 1 : 0;
+}
+
+static void buttonTask(void*) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, settleWait());     // Interrupt or end of a lockout
+        const bool ok = readButtons();
+#if !SIMULATE_HW
+        // INT still low: a change after the read, or the read failed and
+        // the interrupt is still latched (no new falling edge will come)
+        if (digitalRead(s_intPin) == LOW) {
+            if (!ok) vTaskDelay(pdMS_TO_TICKS(BTN_RETRY_MS));
+            xTaskNotifyGive(s_task);
+        }
+#else
+        (void)ok;
+#endif
+    }
+}
+
+// --- Init ---
+
+bool begin(uint8_t chip, uint8_t addr, uint8_t intPin) {
+    s_chip = chip;
+    s_intPin = intPin;
+    s_ready = mcpport::addInputChip(chip, addr, BTN_MASK);
+    if (!s_ready) return false;
+    uint8_t r[2];
+    if (mcpport::readRegs(chip, mcpport::REG_GPIOA, r, sizeof(r))) {
+        s_state = (uint16_t)((r[0] | (r[1] << 8)) & BTN_MASK);    // Held at boot: no press
+    }
+    xTaskCreate(buttonTask, "buttons", 3072, nullptr, 5, &s_task);
+#if !SIMULATE_HW
+    pinMode(intPin, INPUT_PULLUP);      // INT is open drain
+    attachInterrupt(intPin, onInt, FALLING);
+    xTaskNotifyGive(s_task);            // Initial state, clears a pending INT
+#endif
+    return true;
+}
+
+bool ready() {
+    return s_ready;
+}
+
+// --- IO task ---
+
+uint16_t takePresses() {
+    if (!s_pending.load(std::memory_order_relaxed)) return 0;
+    return s_pending.exchange(0, std::memory_order_acquire);
+}
+
+Stats getStats() {
+    Stats s;
+    s.reads = s_reads;
+    s.presses = s_presses;
+    s.bounces = s_bounces;
+    s.held = s_state;
+    return s;
+}
+
+// --- Simulation ---
+
+#if SIMULATE_HW
+void inject(uint8_t ch) {
+    if (ch >= NUM_CHANNELS) return;
+    s_presses++;
+    s_pending.fetch_or((uint16_t)(1u << ch), std::memory_order_release);
+}
+#endif
+
+} // namespace buttons
@@ -0,0 +1,100 @@
+#include "cmdqueue.h"
+#include "ringbuf.h"
+#include "hal.h"
+
+#define CMDQ_HIST_BUCKETS 24       // Up to 8 s, above lands in the last bucket
+
+namespace cmdqueue {
+
+// Log2 latency histogram, updated from any task
+struct Hist {
+    std::atomic<uint32_t> bucket[CMDQ_HIST_BUCKETS];
+    std::atomic<uint32_t> maxUs;
+
+    void add(uint32_t us) {
+        uint8_t k = 0;
+        while (k < CMDQ_HIST_BUCKETS - 1 && (us >> k) != 0) k++;
+        bucket[k].fetch_add(1, std::memory_order_relaxed);
+        uint32_t m = maxUs.load(std::memory_order_relaxed);
+        while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+    }
+
+    // Upper bound of the bucket holding the pct-th percentile
+    uint32_t percentile(uint8_t pct) const {
+        uint32_t count[CMDQ_HIST_BUCKETS];
+        uint32_t total = 0;
+        for (uint8_t k = 0; k < CMDQ_HIST_BUCKETS; k++) {
+            count[k] = bucket[k].load(std::memory_order_relaxed);
+            total += count[k];
+        }
+        if (total == 0) return 0;
+        const uint32_t rank = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+        uint32_t seen = 0;
+        for (uint8_t k = 0; k < CMDQ_HIST_BUCKETS; k++) {
+            seen += count[k];
+            if (seen >= rank) return (1u << k) - 1;
+        }
+        return maxUs.load(std::memory_order_relaxed);
+    }
+};
+
+static MpmcRing<Message, CMDQ_SIZE> s_ring;
+static Message s_storage[CMDQ_SIZE];
+static std::atomic<uint32_t> s_posted{0};
+static std::atomic<uint32_t> s_rejected{0};
+static std::atomic<uint32_t> s_maxDepth{0};
+static Hist s_wait;         // Static storage: zero-initialized
+static Hist s_handler;
+static uint8_t s_popped = 0;       // This cycle (IO task only)
+
+void begin() {
+    s_ring.attach(s_storage);
+}
+
+bool post(const binproto::Command& c) {
+    Message m;
+    m.cmd = c;
+    m.postUs = hal::nowUs();
+    if (!s_ring.ready() || !s_ring.push(m)) {
+        s_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    s_posted.fetch_add(1, std::memory_order_relaxed);
+    const uint32_t depth = (uint32_t)s_ring.size();
+    uint32_t m0 = s_maxDepth.load(std::memory_order_relaxed);
+    while (depth > m0 && !s_maxDepth.compare_exchange_weak(m0, depth, std::memory_order_relaxed)) {}
+    return true;
+}
+
+bool pop(Message& m) {
+    if (s_popped >= CMDQ_DRAIN_MAX || !s_ring.ready() || !s_ring.pop(m)) return false;
+    s_popped++;
+    s_wait.add((uint32_t)(hal::nowUs() - m.postUs));
+    return true;
+}
+
+void endCycle() {
+    s_popped = 0;
+}
+
+void noteHandler(uint32_t us) {
+    s_handler.add(us);
+}
+
+Stats getStats() {
+    Stats s;
+    s.depth = (uint32_t)s_ring.size();
+    s.maxDepth = s_maxDepth.load(std::memory_order_relaxed);
+    s.posted = s_posted.load(std::memory_order_relaxed);
+    s.rejected = s_rejected.load(std::memory_order_relaxed);
+    s.waitP50Us = s_wait.percentile(50);
+    s.waitP99Us = s_wait.percentile(99);
+    s.waitMaxUs = s_wait.maxUs.load(std::memory_order_relaxed);
+    s.handlerP50Us = s_handler.percentile(50);
+    s.handlerP90Us = s_handler.percentile(90);
+    s.handlerP99Us = s_handler.percentile(99);
+    s.handlerMaxUs = s_handler.maxUs.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // namespace cmdqueue
@@ -0,0 +1,156 @@
+#include "configblob.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <esp_rom_crc.h>
+#include "inputfilter.h"
+#include "s0counter.h"
+
+#define CFG_BLOB_MAGIC 0x46434F49UL   // "IOCF"
+
+namespace configblob {
+
+// Payload size of each version (index = version)
+static const uint16_t VERSION_SIZE[CFG_BLOB_VERSION + 1] = {
+    0,
+    offsetof(Config, rules),    // 1
+    sizeof(Config),             // 2
+};
+
+static_assert(sizeof(Config) <= 0xFFFF, "Config too large for the size field");
+
+static inline uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// Fixups for fields that changed meaning, applied after the tail defaults
+static void migrate(Config& c, uint16_t from) {
+    (void)c;
+    (void)from;     // None yet (version 2 only appended the rules)
+}
+
+void defaults(Config& c) {
+    memset(&c, 0, sizeof(c));
+    for (uint8_t i = 0; i < CFG_BLOB_CHANNELS; i++) {
+        c.inputMapping[i] = -1;
+        c.autoOffSeconds[i] = 0;
+        c.inputMode[i] = inputfilter::MODE_DC;
+        c.inputFilterMs[i] = 0;
+        c.s0Imp[i] = s0counter::IMP_DEFAULT;
+    }
+}
+
+Result decode(const uint8_t* buf, size_t len, Config& c, uint16_t* version) {
+    defaults(c);
+    if (version) *version = 0;
+    if (!buf || len == 0) return EMPTY;
+    if (len < CFG_BLOB_HEADER || get32(buf) != CFG_BLOB_MAGIC) return CORRUPT;
+
+    const uint16_t ver = get16(buf + 4);
+    const uint16_t size = get16(buf + 6);
+    if (ver == 0 || size > len - CFG_BLOB_HEADER) return CORRUPT;
+    if (ver <= CFG_BLOB_VERSION && size != VERSION_SIZE[ver]) return CORRUPT;
+    if (ver > CFG_BLOB_VERSION && size < sizeof(Config)) return CORRUPT;   // Newer must only append
+    if (esp_rom_crc32_le(0, buf + CFG_BLOB_HEADER, size) != get32(buf + 8)) return CORRUPT;
+
+    const Config* src = (const Config*)(buf + CFG_BLOB_HEADER);
+    memcpy(&c, src, size < sizeof(Config) ? size : sizeof(Config));
+    c.ssid[sizeof(c.ssid) - 1] = '\0';
+    c.pass[sizeof(c.pass) - 1] = '\0';
+    c.rules[sizeof(c.rules) - 1] = '\0';
+    if (version) *version = ver;
+
+    if (ver < CFG_BLOB_VERSION) {
+        migrate(c, ver);
+        return MIGRATED;
+    }
+    return OK;
+}
+
+size_t encode(const Config& c, uint8_t* buf, size_t cap) {
+    if (cap < CFG_BLOB_MAX) return 0;
+    memcpy(buf + CFG_BLOB_HEADER, &c, sizeof(Config));
+    put32(buf, CFG_BLOB_MAGIC);
+    put16(buf + 4, CFG_BLOB_VERSION);
+    put16(buf + 6, (uint16_t)sizeof(Config));
+    put32(buf + 8, esp_rom_crc32_le(0, buf + CFG_BLOB_HEADER, sizeof(Config)));
+    return CFG_BLOB_MAX;
+}
+
+// --- Layout before the blob ---
+
+// Per-channel keys: prefix + channel (0-based)
+static const char* const LEGACY_PREFIX[] = {"map", "auto", "imode", "ifilt", "s0imp"};
+static const KeyType LEGACY_TYPE[] = {KEY_I8, KEY_U32, KEY_U8, KEY_U16, KEY_U16};
+enum { L_MAP, L_AUTO, L_IMODE, L_IFILT, L_S0IMP, L_COUNT };
+
+// Old value of channel i if stored and within lo..hi
+static bool legacyNum(const LegacyReader& r, uint8_t k, uint8_t i, int64_t lo, int64_t hi, int64_t& v) {
+    char key[12];
+    snprintf(key, sizeof(key), "%s%u", LEGACY_PREFIX[k], (unsigned)i);
+    return r.num(key, LEGACY_TYPE[k], v) && v >= lo && v <= hi;
+}
+
+static void legacyStr(const LegacyReader& r, const char* key, char* out, size_t cap) {
+    if (!r.str(key, out, cap)) out[0] = '\0';
+    out[cap - 1] = '\0';
+}
+
+bool hasLegacy(const LegacyReader& r) {
+    char s[2];
+    int64_t v = 0;
+    return r.str("ssid", s, sizeof(s)) || r.num("map0", KEY_I8, v);
+}
+
+void readLegacy(const LegacyReader& r, Config& c) {
+    defaults(c);
+    legacyStr(r, "ssid", c.ssid, sizeof(c.ssid));
+    legacyStr(r, "pass", c.pass, sizeof(c.pass));
+    for (uint8_t i = 0; i < CFG_BLOB_CHANNELS; i++) {
+        int64_t v = 0;
+        if (legacyNum(r, L_MAP, i, -1, CFG_BLOB_CHANNELS - 1, v)) c.inputMapping[i] = (int8_t)v;
+        if (legacyNum(r, L_AUTO, i, 0, 0xFFFFFFFFLL, v)) c.autoOffSeconds[i] = (uint32_t)v;
+        if (legacyNum(r, L_IMODE, i, 0, inputfilter::MODE_COUNTER, v)) c.inputMode[i] = (uint8_t)v;
+        if (legacyNum(r, L_IFILT, i, 0, 0xFFFF, v)) c.inputFilterMs[i] = (uint16_t)v;
+        if (legacyNum(r, L_S0IMP, i, 0, 0xFFFF, v)) c.s0Imp[i] = (uint16_t)v;
+    }
+}
+
+void forEachLegacyKey(void (*fn)(const char* key)) {
+    char key[12];
+    fn("ssid");
+    fn("pass");
+    for (uint8_t k = 0; k < L_COUNT; k++) {
+        for (uint8_t i = 0; i < CFG_BLOB_CHANNELS; i++) {
+            snprintf(key, sizeof(key), "%s%u", LEGACY_PREFIX[k], (unsigned)i);
+            fn(key);
+        }
+    }
+}
+
+Result load(const uint8_t* buf, size_t len, const LegacyReader& legacy, Config& c,
+            uint16_t* version, Result* blob) {
+    const Result r = decode(buf, len, c, version);
+    if (blob) *blob = r;
+    if (r == OK || r == MIGRATED || !hasLegacy(legacy)) return r;
+    readLegacy(legacy, c);
+    return LEGACY;
+}
+
+} // namespace configblob
@@ -0,0 +1,381 @@
+#include "crashlog.h"
+#include "swtools.h"
+#include "stateproto.h"
+#include <stdarg.h>
+#include <time.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_ota_ops.h>
+#include <esp_heap_caps.h>
+#include <soc/soc_memory_layout.h>
+
+#define CRASHLOG_MAGIC 0x43524C47UL   // "CRLG"
+
+namespace crashlog {
+
+struct Entry {
+    const char* fmt;
+    uint32_t ms;                     // millis()
+    uint32_t sec;                    // Wall clock (valid from 2017 on)
+    uint16_t cat;
+    uint8_t  lvl;                    // | DBG_TOK_TRUNCATED
+    uint8_t  len;
+    uint8_t  args[CRASHLOG_ARGS];
+};
+
+// Survives warm resets (not initialized at boot)
+struct RtcImage {
+    uint32_t magic;
+    uint32_t crc;                    // Over build, boots, head
+    uint32_t build;                  // Firmware identity, format addresses are only valid for it
+    uint32_t boots;
+    uint32_t head;                   // Records written (slot = head % CRASHLOG_ENTRIES)
+    Entry    entry[CRASHLOG_ENTRIES];
+};
+
+static RTC_NOINIT_ATTR RtcImage s_rtc;
+
+static bool s_started = false;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static esp_reset_reason_t s_reason = ESP_RST_UNKNOWN;
+
+// Previous run, oldest first
+static Entry* s_prev = nullptr;
+static uint16_t s_prevCount = 0;
+static uint32_t s_prevLost = 0;
+
+static uint32_t buildId() {
+    const esp_app_desc_t* d = esp_ota_get_app_description();
+    uint32_t id;
+    memcpy(&id, d->app_elf_sha256, sizeof(id));
+    return id;
+}
+
+static uint32_t headerCrc(const RtcImage& img) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)&img.build, sizeof(img.build));
+    crc = esp_rom_crc32_le(crc, (const uint8_t*)&img.boots, sizeof(img.boots));
+    return esp_rom_crc32_le(crc, (const uint8_t*)&img.head, sizeof(img.head));
+}
+
+// --- Init ---
+
+void begin() {
+    s_reason = esp_reset_reason();
+    const uint32_t build = buildId();
+    // Entries are not covered (one CRC per record would be too slow); their
+    // len is clamped below and the renderer bounds-checks every argument
+    const bool known = s_rtc.magic == CRASHLOG_MAGIC && s_rtc.crc == headerCrc(s_rtc);
+
+    if (known && s_rtc.build == build && s_rtc.head > 0) {
+        const uint32_t n = s_rtc.head < CRASHLOG_ENTRIES ? s_rtc.head : CRASHLOG_ENTRIES;
+        void* buf = heap_caps_malloc(n * sizeof(Entry), MALLOC_CAP_SPIRAM);
+        if (!buf) buf = heap_caps_malloc(n * sizeof(Entry), MALLOC_CAP_8BIT);
+        if (buf) {
+            s_prev = (Entry*)buf;
+            const uint32_t first = s_rtc.head - n;
+            for (uint32_t k = 0; k < n; k++) {
+                Entry& e = s_prev[k];
+                e = s_rtc.entry[(first + k) % CRASHLOG_ENTRIES];
+                if (e.len > CRASHLOG_ARGS) e.len = CRASHLOG_ARGS;   // Garbled: Renderer reads args[len]
+            }
+            s_prevCount = (uint16_t)n;
+            s_prevLost = first;
+        }
+    }
+
+    s_rtc.boots = known ? s_rtc.boots + 1 : 1;
+    s_rtc.build = build;
+    s_rtc.head = 0;
+    s_rtc.crc = headerCrc(s_rtc);
+    s_rtc.magic = CRASHLOG_MAGIC;
+    s_started = true;
+}
+
+// --- Recording ---
+
+void record(uint8_t lvl, uint16_t cat, const char* fmt, const uint8_t* args, uint8_t len, bool truncated) {
+    if (!s_started) return;
+    if (len > CRASHLOG_ARGS) {
+        len = CRASHLOG_ARGS;        // Cut args render as "<?>"
+        truncated = true;
+    }
+    if (truncated) lvl |= DBG_TOK_TRUNCATED;
+    const uint32_t ms = millis();
+    const uint32_t sec = (uint32_t)time(nullptr);
+
+    portENTER_CRITICAL(&s_mux);
+    Entry& e = s_rtc.entry[s_rtc.head % CRASHLOG_ENTRIES];
+    e.fmt = fmt;
+    e.ms = ms;
+    e.sec = sec;
+    e.cat = cat;
+    e.lvl = lvl;
+    e.len = len;
+    memcpy(e.args, args, len);
+    s_rtc.head++;                   // Only complete entries count after a reset
+    s_rtc.crc = headerCrc(s_rtc);
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// --- Read out ---
+
+uint32_t bootCount() {
+    return s_rtc.boots;
+}
+
+int resetReason() {
+    return (int)s_reason;
+}
+
+const char* resetReasonName() {
+    switch (s_reason) {
+        case ESP_RST_POWERON:   return "POWERON";
+        case ESP_RST_EXT:       return "EXT";
+        case ESP_RST_SW:        return "SW";
+        case ESP_RST_PANIC:     return "PANIC";
+        case ESP_RST_INT_WDT:   return "INT_WDT";
+        case ESP_RST_TASK_WDT:  return "TASK_WDT";
+        case ESP_RST_WDT:       return "WDT";
+        case ESP_RST_DEEPSLEEP: return "DEEPSLEEP";
+        case ESP_RST_BROWNOUT:  return "BROWNOUT";
+        case ESP_RST_SDIO:      return "SDIO";
+        default:                return "UNKNOWN";
+    }
+}
+
+bool previousValid() {
+    return s_prevCount > 0;
+}
+
+uint32_t lostCount(bool current) {
+    if (!current) return s_prevLost;
+    portENTER_CRITICAL(&s_mux);
+    const uint32_t head = s_rtc.head;
+    portEXIT_CRITICAL(&s_mux);
+    return head > CRASHLOG_ENTRIES ? head - CRASHLOG_ENTRIES : 0;
+}
+
+// printf over the packed arguments, same rules as tools/logdecode.py
+class Renderer {
+public:
+    Renderer(char* out, size_t cap, const uint8_t* args, uint8_t len)
+        : m_out(out), m_cap(cap), m_pos(0), m_args(args), m_len(len), m_at(0), m_bad(false) {
+        m_out[0] = '\0';
+    }
+
+    void append(const char* s) {
+        putStr(s);
+    }
+
+    void run(const char* f) {
+        while (*f) {
+            if (*f != '%') {
+                put(*f++);
+                continue;
+            }
+            const char* start = f++;
+            if (*f == '%') {
+                put(*f++);
+                continue;
+            }
+            char spec[24];
+            size_t n = 0;
+            spec[n++] = '%';
+            while (*f && strchr("-+ #0", *f)) addSpec(spec, n, *f++);
+            if (!number(f, spec, n)) break;
+            if (*f == '.') {
+                addSpec(spec, n, *f++);
+                if (!number(f, spec, n)) break;
+            }
+            bool wide = false;
+            bool half = false;
+            bool byte = false;
+            while (*f && strchr("hljztL", *f)) {
+                if (*f == 'j' || (f[0] == 'l' && f[1] == 'l')) wide = true;
+                if (*f == 'h') {
+                    byte = half;
+                    half = true;
+                }
+                if (f[0] == 'l' && f[1] == 'l') f++;
+                f++;
+            }
+            const char conv = *f;
+            if (!conv || !strchr("diouxXcsfFeEgGp", conv)) {
+                putStr(start, f);     // Unknown conversion: copy as is
+                continue;
+            }
+            f++;
+            convert(spec, n, conv, wide, half, byte);
+        }
+    }
+
+private:
+    void put(char c) {
+        if (m_pos + 1 < m_cap) {
+            m_out[m_pos++] = c;
+            m_out[m_pos] = '\0';
+        }
+    }
+
+    void putStr(const char* s, const char* end = nullptr) {
+        while (*s && s != end) put(*s++);
+    }
+
+    void putFmt(const char* spec, ...) __attribute__((format(printf, 2, 3))) {
+        if (m_pos + 1 >= m_cap) return;
+        va_list ap;
+        va_start(ap, spec);
+        const int r = vsnprintf(m_out + m_pos, m_cap - m_pos, spec, ap);
+        va_end(ap);
+        if (r > 0) m_pos += (size_t)r < m_cap - m_pos ? (size_t)r : m_cap - m_pos - 1;
+    }
+
+    static void addSpec(char* spec, size_t& n, char c) {
+        if (n < 12) spec[n++] = c;
+    }
+
+    bool take(void* dst, size_t n) {
+        if (m_bad || m_at + n > m_len) {
+            m_bad = true;
+            return false;
+        }
+        memcpy(dst, m_args + m_at, n);
+        m_at += n;
+        return true;
+    }
+
+    // Width / precision: digits or '*' (packed int)
+    bool number(const char*& f, char* spec, size_t& n) {
+        if (*f == '*') {
+            f++;
+            int32_t v = 0;
+            if (!take(&v, 4)) return true;
+            char tmp[12];
+            snprintf(tmp, sizeof(tmp), "%d", (int)(v < 0 ? 0 : v > 99 ? 99 : v));
+            for (const char* p = tmp; *p; p++) addSpec(spec, n, *p);
+            return true;
+        }
+        while (*f >= '0' && *f <= '9') addSpec(spec, n, *f++);
+        return *f != '\0';
+    }
+
+    void convert(char* spec, size_t n, char conv, bool wide, bool half, bool byte) {
+        if (m_bad) {
+            putStr("<?>");
+            return;
+        }
+        if (conv == 's') {
+            const char* s = (const char*)m_args + m_at;
+            const void* nul = memchr(s, '\0', m_len - m_at);
+            if (!nul) {
+                m_bad = true;
+                putStr("<?>");
+                return;
+            }
+            m_at += (size_t)((const char*)nul - s) + 1;
+            spec[n++] = 's';
+            spec[n] = '\0';
+            putFmt(spec, s);
+            return;
+        }
+        if (conv == 'p') {
+            uint32_t v;
+            if (take(&v, 4)) putFmt("0x%08lx", (unsigned long)v);
+            else putStr("<?>");
+            return;
+        }
+        if (strchr("fFeEgG", conv)) {
+            double v;
+            if (!take(&v, 8)) {
+                putStr("<?>");
+                return;
+            }
+            spec[n++] = conv;
+            spec[n] = '\0';
+            putFmt(spec, v);
+            return;
+        }
+
+        // Integer: 4 bytes, 8 for ll / j; printed as long long
+        int64_t v = 0;
+        const bool sign = conv == 'd' || conv == 'i';
+        if (wide) {
+            if (!take(&v, 8)) {
+                putStr("<?>");
+                return;
+            }
+        } else {
+            uint32_t w;
+            if (!take(&w, 4)) {
+                putStr("<?>");
+                return;
+            }
+            v = sign ? (int64_t)(int32_t)w : (int64_t)w;
+        }
+        if (byte) v = sign ? (int64_t)(int8_t)v : (int64_t)(uint8_t)v;
+        else if (half) v = sign ? (int64_t)(int16_t)v : (int64_t)(uint16_t)v;
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = conv;
+        spec[n] = '\0';
+        putFmt(spec, (long long)v);
+    }
+
+    char*          m_out;
+    size_t         m_cap;
+    size_t         m_pos;
+    const uint8_t* m_args;
+    uint8_t        m_len;
+    size_t         m_at;
+    bool           m_bad;
+};
+
+static void writeEntry(stateproto::JsonWriter& w, const Entry& e) {
+    char ts[24];
+    char msg[160];
+    const uint8_t lvl = e.lvl & ~DBG_TOK_TRUNCATED;
+    dbg::formatTime(ts, sizeof(ts), (time_t)e.sec, e.ms);
+    if (esp_ptr_in_drom(e.fmt)) {
+        Renderer r(msg, sizeof(msg), e.args, e.len);
+        r.run(e.fmt);
+        if (e.lvl & DBG_TOK_TRUNCATED) r.append(" <...>");
+    } else {
+        snprintf(msg, sizeof(msg), "<fmt 0x%08lx?>", (unsigned long)(uintptr_t)e.fmt);
+    }
+
+    w.beginObject();
+    w.key("t");
+    w.addStr(ts);
+    w.key("lvl");
+    w.addStr(lvl == CRASHLOG_LVL_TRACE ? "EVT" : dbg::levelName((dbg::Level)lvl));
+    w.key("cat");
+    w.addStr(dbg::catName((dbg::Category)e.cat));
+    w.key("msg");
+    w.addStr(msg);
+    w.endObject();
+}
+
+void writeEntries(stateproto::JsonWriter& w, bool current) {
+    w.beginArray();
+    if (!current) {
+        for (uint16_t k = 0; k < s_prevCount; k++) writeEntry(w, s_prev[k]);
+    } else {
+        portENTER_CRITICAL(&s_mux);
+        const uint32_t head = s_rtc.head;
+        portEXIT_CRITICAL(&s_mux);
+        const uint32_t first = head > CRASHLOG_ENTRIES ? head - CRASHLOG_ENTRIES : 0;
+        for (uint32_t seq = first; seq < head; seq++) {
+            Entry e;
+            bool live;
+            portENTER_CRITICAL(&s_mux);
+            live = s_rtc.head - seq <= CRASHLOG_ENTRIES;   // Not overwritten meanwhile
+            if (live) e = s_rtc.entry[seq % CRASHLOG_ENTRIES];
+            portEXIT_CRITICAL(&s_mux);
+            if (live) writeEntry(w, e);
+        }
+    }
+    w.endArray();
+}
+
+} // namespace crashlog
@@ -0,0 +1,39 @@
+#include "framepace.h"
+
+namespace framepace {
+
+static volatile bool s_pending = false;
+static uint32_t s_pendingSince = 0;
+static uint32_t s_lastFrameMs = 0;
+static uint32_t s_coalesced = 0;
+
+void request(uint32_t nowMs) {
+    if (s_pending) {
+        s_coalesced++;
+        return;
+    }
+    s_pendingSince = nowMs;
+    s_pending = true;
+}
+
+bool tick(uint32_t nowMs, StaleFn stale) {
+    if (nowMs - s_lastFrameMs < 1000UL / WS_MAX_FPS) return false;
+    if (s_pending) {
+        if (nowMs - s_pendingSince < WS_COALESCE_MS) return false;
+        s_pending = false;
+    } else if (!stale || !stale()) {
+        return false;
+    }
+    s_lastFrameMs = nowMs;
+    return true;
+}
+
+bool pending() {
+    return s_pending;
+}
+
+uint32_t coalesced() {
+    return s_coalesced;
+}
+
+} // namespace framepace
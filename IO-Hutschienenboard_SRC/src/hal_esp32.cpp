@@ -0,0 +1,125 @@
+#include "hal.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <Preferences.h>
+#include <ESPAsyncWebServer.h>
+#include "pin_config.h"
+#include "inputcap.h"
+#include "relaypulse.h"
+#include "mcpport.h"
+#include "s0counter.h"
+#include "buttons.h"
+
+#define HAL_STORE_NS "io-config"
+
+extern AsyncWebSocket ws;   // main.cpp
+
+namespace hal {
+
+// --- Clock ---
+
+int64_t nowUs() {
+    return esp_timer_get_time();
+}
+
+uint32_t cycles() {
+    return ESP.getCycleCount();
+}
+
+// --- GPIO input ---
+
+bool inputPop(Edge& e) {
+    inputcap::Event ev;
+    if (!inputcap::pop(ev)) return false;
+    e.tsUs = ev.tsUs;
+    e.channel = ev.channel;
+    e.level = ev.level;
+    return true;
+}
+
+uint16_t inputLevels() {
+    return inputcap::levels();
+}
+
+uint32_t inputDropped() {
+    return inputcap::droppedCount();
+}
+
+// --- Relay driver ---
+
+bool relayReady(uint8_t ch) {
+    return mcpport::ready(RELAY_PINS[ch].mcpIndex);
+}
+
+void relayRequest(uint8_t ch, bool on) {
+    relaypulse::request(ch, on);
+}
+
+bool relayTarget(uint8_t ch, bool current) {
+    return relaypulse::target(ch, current);
+}
+
+void relayBatch(bool begin) {
+    if (begin) mcpport::hold();     // One write per MCP for the whole batch
+    else mcpport::release();
+}
+
+// --- Top board buttons ---
+
+uint16_t buttonPresses() {
+    return buttons::takePresses();
+}
+
+// --- Pulse counter ---
+
+bool counterConfigure(uint8_t ch, bool enabled, uint16_t impPerKwh) {
+    return s0counter::configure(ch, enabled, impPerKwh);
+}
+
+void counterEdge(uint8_t ch, bool level, int64_t tsUs) {
+    s0counter::onEdge(ch, level, tsUs);
+}
+
+bool counterPoll(int64_t nowUs) {
+    return s0counter::poll(nowUs);
+}
+
+uint64_t counterTotal(uint8_t ch) {
+    return s0counter::total(ch);
+}
+
+uint32_t counterPowerW(uint8_t ch) {
+    return s0counter::powerW(ch);
+}
+
+// --- Persistence (NVS) ---
+
+size_t storeRead(const char* key, uint8_t* buf, size_t cap) {
+    Preferences p;
+    if (!p.begin(HAL_STORE_NS, true)) return 0;
+    const size_t n = p.isKey(key) ? p.getBytes(key, buf, cap) : 0;
+    p.end();
+    return n;
+}
+
+bool storeWrite(const char* key, const uint8_t* buf, size_t len) {
+    Preferences p;
+    if (!p.begin(HAL_STORE_NS, false)) return false;
+    const bool ok = p.putBytes(key, buf, len) == len;
+    p.end();
+    return ok;
+}
+
+// --- Transport (WebSocket) ---
+
+void transportSend(uint32_t client, const uint8_t* data, size_t len, bool binary) {
+    if (client == 0) {
+        if (binary) ws.binaryAll(data, len);
+        else ws.textAll(data, len);
+    } else {
+        if (binary) ws.binary(client, data, len);
+        else ws.text(client, data, len);
+    }
+}
+
+} // namespace hal
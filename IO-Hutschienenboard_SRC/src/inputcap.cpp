@@ -0,0 +1,143 @@
+#include "inputcap.h"
+#include "pin_config.h"
+#include "pinmap.h"
+#include "ringbuf.h"
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <driver/gpio.h>
+
+// Ring capacity: 128 edges = ~107 ms of 50 Hz AC on all 12 inputs
+// (~1200 edges/s), far above the IO_SCAN_MS drain period.
+#define CAP_RING_SIZE 128
+
+namespace inputcap {
+
+static SpscRing<Event, CAP_RING_SIZE> s_ring;
+static std::atomic<uint32_t> s_dropped{0};
+static TaskHandle_t s_notifyTask = nullptr;
+
+// Pin numbers copied to DRAM so the ISR never touches flash
+static DRAM_ATTR uint8_t s_pin[NUM_CHANNELS];
+
+#if SIMULATE_HW
+static bool s_simLevel[NUM_CHANNELS] = {false};
+static portMUX_TYPE s_simMux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// --- ISR ---
+
+static inline bool IRAM_ATTR store(uint8_t ch, uint8_t level) {
+    Event ev;
+    ev.tsUs = esp_timer_get_time();
+    ev.channel = ch;
+    ev.level = level;
+    if (!s_ring.push(ev)) {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+#if !SIMULATE_HW
+static_assert(!pinmap::USES_IN1, "onEdge() reads GPIO_IN_REG only: input pins must be < 32");
+
+static void IRAM_ATTR onEdge(void* arg) {
+    const uint8_t ch = (uint8_t)(uintptr_t)arg;
+    // All input pins are < 32 (asserted above) -> GPIO_IN_REG holds their level
+    const uint8_t level = (REG_READ(GPIO_IN_REG) >> s_pin[ch]) & 1;
+    if (store(ch, level) && s_notifyTask) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(s_notifyTask, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+// --- Init ---
+
+void begin(TaskHandle_t notifyTask) {
+    s_notifyTask = notifyTask;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        s_pin[i] = INPUT_PINS[i];
+        pinMode(s_pin[i], INPUT);
+#if !SIMULATE_HW
+        attachInterruptArg(s_pin[i], onEdge, (void*)(uintptr_t)i, CHANGE);
+#endif
+    }
+}
+
+// --- Consumer side ---
+
+bool pop(Event& ev) {
+    return s_ring.pop(ev);
+}
+
+void wait(uint32_t timeoutMs) {
+    if (!s_ring.empty()) return;
+    if (s_notifyTask) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    } else {
+        delay(timeoutMs);
+    }
+}
+
+uint16_t levels() {
+#if SIMULATE_HW
+    uint16_t m = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (s_simLevel[i]) m |= (uint16_t)(1 << i);
+    }
+    return m;
+#else
+    return pinmap::gather(REG_READ(GPIO_IN_REG), pinmap::USES_IN1 ? REG_READ(GPIO_IN1_REG) : 0);
+#endif
+}
+
+bool level(uint8_t ch) {
+    if (ch >= NUM_CHANNELS) return false;
+#if SIMULATE_HW
+    return s_simLevel[ch];
+#else
+    return (REG_READ(GPIO_IN_REG) >> s_pin[ch]) & 1;
+#endif
+}
+
+void setIsrEnabled(uint8_t ch, bool enabled) {
+    if (ch >= NUM_CHANNELS) return;
+#if !SIMULATE_HW
+    if (enabled) {
+        gpio_intr_enable((gpio_num_t)s_pin[ch]);
+    } else {
+        gpio_intr_disable((gpio_num_t)s_pin[ch]);
+    }
+#else
+    (void)enabled;
+#endif
+}
+
+// --- Statistics ---
+
+uint32_t droppedCount() {
+    return s_dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t pendingCount() {
+    return (uint32_t)s_ring.size();
+}
+
+// --- Simulation ---
+
+#if SIMULATE_HW
+bool inject(uint8_t ch, bool level) {
+    if (ch >= NUM_CHANNELS) return false;
+    // Several tasks may inject -> serialize producers
+    portENTER_CRITICAL(&s_simMux);
+    s_simLevel[ch] = level;
+    const bool ok = store(ch, level ? 1 : 0);
+    portEXIT_CRITICAL(&s_simMux);
+    if (ok && s_notifyTask) xTaskNotifyGive(s_notifyTask);
+    return ok;
+}
+#endif
+
+} // namespace inputcap
@@ -0,0 +1,123 @@
+#include "inputfilter.h"
+
+namespace inputfilter {
+
+struct Channel {
+    int64_t  lastEdgeUs;    // Last raw edge (AC presence)
+    int64_t  lockUntilUs;   // End of the DC bounce lockout
+    uint16_t ms;            // Configured filter time, 0 = default
+    uint8_t  mode;
+    bool     raw;           // Last raw level seen
+    bool     stable;        // Conditioned state
+    bool     locked;        // DC lockout running
+};
+
+static Channel s_ch[NUM_CHANNELS];
+
+static int64_t windowUs(const Channel& c) {
+    uint16_t ms = c.ms;
+    if (c.mode == MODE_AC) {
+        if (ms == 0) ms = AC_DEFAULT_MS;
+        if (ms < AC_MIN_MS) ms = AC_MIN_MS;
+    } else if (ms == 0) {
+        ms = DC_DEFAULT_MS;
+    }
+    return (int64_t)ms * 1000;
+}
+
+// --- Configuration ---
+
+void configure(uint8_t ch, Mode mode, uint16_t filterMs) {
+    if (ch >= NUM_CHANNELS) return;
+    Channel& c = s_ch[ch];
+    c.mode = mode;
+    c.ms = filterMs;
+    c.locked = false;
+}
+
+Mode mode(uint8_t ch) {
+    return ch < NUM_CHANNELS ? (Mode)s_ch[ch].mode : MODE_DC;
+}
+
+uint16_t filterMs(uint8_t ch) {
+    return ch < NUM_CHANNELS ? (uint16_t)(windowUs(s_ch[ch]) / 1000) : 0;
+}
+
+void reset(uint8_t ch, bool level) {
+    if (ch >= NUM_CHANNELS) return;
+    Channel& c = s_ch[ch];
+    c.raw = level;
+    c.stable = level;
+    c.locked = false;
+    c.lastEdgeUs = 0;
+}
+
+// --- Edges ---
+
+bool feed(uint8_t ch, bool level, int64_t tsUs) {
+    if (ch >= NUM_CHANNELS) return false;
+    Channel& c = s_ch[ch];
+    c.raw = level;
+
+    if (c.mode == MODE_AC) {
+        // Any edge proves AC presence
+        c.lastEdgeUs = tsUs;
+        if (c.stable) return false;
+        c.stable = true;
+        return true;
+    }
+
+    // DC: leading edge counts, bounces inside the lockout are ignored
+    if (c.locked && tsUs < c.lockUntilUs) return false;
+    c.locked = false;
+    if (level == c.stable) return false;
+    c.stable = level;
+    c.locked = true;
+    c.lockUntilUs = tsUs + windowUs(c);
+    return true;
+}
+
+// --- Timeouts ---
+
+uint16_t poll(int64_t nowUs) {
+    uint16_t changed = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        Channel& c = s_ch[i];
+
+        if (c.mode == MODE_AC) {
+            // Missing pulse: no edge within the window and the line is idle
+            if (c.stable && !c.raw && nowUs - c.lastEdgeUs >= windowUs(c)) {
+                c.stable = false;
+                changed |= (uint16_t)(1 << i);
+            }
+            continue;
+        }
+
+        if (!c.locked || nowUs < c.lockUntilUs) continue;
+        c.locked = false;
+        // Level settled differently than the leading edge said
+        if (c.raw != c.stable) {
+            c.stable = c.raw;
+            c.locked = true;
+            c.lockUntilUs = nowUs + windowUs(c);
+            changed |= (uint16_t)(1 << i);
+        }
+    }
+    return changed;
+}
+
+// --- State ---
+
+bool state(uint8_t ch) {
+    return ch < NUM_CHANNELS && s_ch[ch].stable;
+}
+
+uint16_t states() {
+    uint16_t m = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (s_ch[i].stable) m |= (uint16_t)(1 << i);
+    }
+    return m;
+}
+
+} // namespace inputfilter
@@ -0,0 +1,392 @@
+#include "iologic.h"
+#include <string.h>
+#include <atomic>
+#include "hal.h"
+#include "inputfilter.h"
+#include "autooff.h"
+#include "s0counter.h"
+#include "swtools.h"
+#include "crashlog.h"
+
+namespace iologic {
+
+int8_t inputMapping[NUM_CHANNELS];
+uint32_t autoOffSeconds[NUM_CHANNELS] = {0};
+uint8_t inputMode[NUM_CHANNELS] = {0};
+uint16_t inputFilterMs[NUM_CHANNELS] = {0};
+uint16_t s0Imp[NUM_CHANNELS] = {0};
+char rulesText[RULES_TEXT_MAX] = "";
+
+static volatile bool s_autoOffDue = false;      // Set by the autooff timer, handled in scan()
+static volatile uint16_t s_autoOffRestore = 0;  // Relays switched back on with a restored timer (AUTOOFF_RESTORE)
+static volatile bool s_relayCommitted = false;  // Set by the relay driver, consumed in scan()
+static uint32_t s_lastDropped = 0;
+
+// Published image: inputs (scan) | committed outputs (relay driver) << 16
+static std::atomic<uint32_t> s_io{0};
+static procimage::Image s_img = {0, 0, 0, 0};   // Image of the running scan (lock holder only)
+static uint16_t s_changed = 0;                  // Inputs that changed in the running scan
+
+static rules::Program s_rules;
+static uint16_t s_stairPending = 0;     // Stairwell relays switching on, armed by scan() (IO task only)
+static uint32_t s_ruleAvgCycles = 0;
+static uint32_t s_ruleMaxCycles = 0;
+
+static void onAutoOffDue() {
+    s_autoOffDue = true;
+}
+
+static inline uint16_t committedOutputs() {
+    return procimage::outputsOf(s_io.load(std::memory_order_acquire));
+}
+
+// Scan image inputs -> published word (only the lock holder writes the input half)
+static void publishInputs() {
+    const uint16_t published = procimage::inputsOf(s_io.load(std::memory_order_relaxed));
+    s_io.fetch_xor((uint32_t)(uint16_t)(published ^ s_img.in), std::memory_order_release);
+}
+
+procimage::Image image() {
+    const uint32_t word = s_io.load(std::memory_order_acquire);
+    procimage::Image img = {procimage::inputsOf(word), procimage::outputsOf(word), 0, 0};
+    return img;
+}
+
+// --- Init ---
+
+void begin() {
+    autooff::begin(onAutoOffDue);
+    s_autoOffRestore = autooff::restoredMask();
+    const int64_t bootUs = hal::nowUs();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (!(s_autoOffRestore & (1 << i))) continue;
+        dbg::warn(dbg::CAT_TIMER, "Auto-Aus A%d nach Reset wiederhergestellt: noch %u s",
+                  i + 1, autooff::remainingSeconds(i, bootUs));
+        setRelay(i, true);
+    }
+    s_lastDropped = hal::inputDropped();
+}
+
+// --- Relays ---
+
+void setRelay(uint8_t ch, bool on) {
+    if (ch >= NUM_CHANNELS) return;
+    if (!hal::relayReady(ch)) {
+        dbg::error(dbg::CAT_RELAY, "Relais %d: MCP23017 #%d nicht bereit!", ch + 1,
+                   RELAY_PINS[ch].mcpIndex + 1);
+        return;
+    }
+    // Returns immediately, the output image follows when the pulse is over
+    hal::relayRequest(ch, on);
+}
+
+void toggleRelay(uint8_t ch) {
+    setRelay(ch, !hal::relayTarget(ch, (committedOutputs() >> ch) & 1));
+}
+
+// Pulse completed: the relay has switched, commit the new state
+void onRelayDone(uint8_t ch, bool on) {
+    const uint16_t bit = (uint16_t)(1 << ch);
+    if (on) s_io.fetch_or((uint32_t)bit << 16, std::memory_order_release);
+    else s_io.fetch_and(~((uint32_t)bit << 16), std::memory_order_release);
+    if (!on) {
+        autooff::cancel(ch);
+    } else if (s_autoOffRestore & bit) {
+        s_autoOffRestore &= ~bit;   // Keep the deadline restored after the reset
+    } else {
+        autooff::arm(ch, autoOffSeconds[ch], hal::nowUs());
+    }
+    s_relayCommitted = true;
+    dbg::info(dbg::CAT_RELAY, "Relais %d: %s", ch + 1, on ? "EIN" : "AUS");
+}
+
+uint32_t remainingAutoOff(uint8_t ch, int64_t nowUs) {
+    if (ch >= NUM_CHANNELS) return 0;
+    if (!((committedOutputs() >> ch) & 1)) return 0;
+    return autooff::remainingSeconds(ch, nowUs);
+}
+
+uint16_t timerMask() {
+    uint16_t m = 0;
+    const uint16_t out = committedOutputs();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (((out >> i) & 1) && autooff::armed(i)) m |= (uint16_t)(1 << i);
+    }
+    return m;
+}
+
+// --- Inputs ---
+
+void applyInputMode(uint8_t ch) {
+    inputfilter::configure(ch, (inputfilter::Mode)inputMode[ch], inputFilterMs[ch]);
+    const bool counter = inputMode[ch] == inputfilter::MODE_COUNTER;
+    const bool hw = hal::counterConfigure(ch, counter, s0Imp[ch]);
+    const uint16_t bit = (uint16_t)(1 << ch);
+    s_img.in &= ~bit;       // Counter inputs never drive relays
+    if (counter) {
+        dbg::info(dbg::CAT_INPUT, "Eingang %d: S0-Zaehler (%s, %u Imp/kWh)", ch + 1,
+                  hw ? "PCNT" : "ISR", s0Imp[ch] ? s0Imp[ch] : s0counter::IMP_DEFAULT);
+    } else {
+        inputfilter::reset(ch, (hal::inputLevels() >> ch) & 1);
+        if (inputfilter::state(ch)) s_img.in |= bit;
+    }
+    publishInputs();
+}
+
+// Conditioned input may have changed: update the scan image
+static void onInputChanged(uint8_t i, int64_t edgeUs) {
+    const uint16_t bit = (uint16_t)(1 << i);
+    const bool current = inputfilter::state(i);
+    if (current == ((s_img.in & bit) != 0)) return;
+    s_img.in ^= bit;
+    s_changed |= bit;
+    crashlog::trace(dbg::CAT_INPUT, "Eingang %d: %s", i + 1, current ? "EIN" : "AUS");
+    if (current && dbg::enabled(dbg::LVL_DEBUG, dbg::CAT_INPUT)) {
+        dbg::debug(dbg::CAT_INPUT, "Eingang %d: steigende Flanke (%lld us)",
+                   i + 1, (long long)(hal::nowUs() - edgeUs));
+    }
+}
+
+// --- Rules ---
+
+bool setRules(const char* text, rules::Error* err) {
+    static rules::Program compiled;     // Caller holds the lock, keep it off the stack
+    const char* src = text ? text : "";
+    if (!rules::compile(src, compiled, err)) return false;
+    activateRules(src, compiled);
+    return true;
+}
+
+void activateRules(const char* text, const rules::Program& p) {
+    s_rules = p;
+    memcpy(rulesText, text, strlen(text) + 1);  // compile() checked the length
+    s_stairPending = 0;
+    s_ruleMaxCycles = 0;
+    dbg::info(dbg::CAT_CONFIG, "Regeln: %u aktiv", s_rules.rows);
+}
+
+RuleStats ruleStats() {
+    RuleStats st;
+    st.rows = s_rules.rows;
+    st.avgCycles = s_ruleAvgCycles;
+    st.maxCycles = s_ruleMaxCycles;
+    return st;
+}
+
+// Rule table on the process image; returns true if relays were requested
+static bool evalRules(int64_t nowUs) {
+    const uint32_t c0 = hal::cycles();
+    rules::Mask out = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (hal::relayTarget(i, (s_img.out >> i) & 1)) out |= (rules::Mask)(1 << i);
+    }
+    rules::Mask stair = 0;
+    const rules::Mask next = rules::evaluate(s_rules.row, s_rules.rows, s_img.in, s_img.rise, out, stair);
+    const rules::Mask change = next ^ out;
+    if (change | stair) {
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            const rules::Mask bit = (rules::Mask)(1 << i);
+            if (stair & bit) {
+                // Already on: restart the time now, else once it has switched
+                if (s_img.out & bit) autooff::arm(i, s_rules.stairSecs[i], nowUs);
+                else s_stairPending |= bit;
+            }
+            if (change & bit) setRelay(i, (next & bit) != 0);
+        }
+    }
+    const uint32_t cycles = hal::cycles() - c0;
+    s_ruleAvgCycles = s_ruleAvgCycles ? s_ruleAvgCycles + ((int32_t)cycles - (int32_t)s_ruleAvgCycles) / 16 : cycles;
+    if (cycles > s_ruleMaxCycles) s_ruleMaxCycles = cycles;
+    return change != 0;
+}
+
+// Stairwell relays requested by a rule: once committed, the rule time
+// replaces the auto-off onRelayDone() armed; dropped if the switch-on
+// was withdrawn (off requested, relay not ready)
+static void armStairs(int64_t nowUs) {
+    for (uint16_t p = s_stairPending; p; p &= (uint16_t)(p - 1)) {
+        const uint8_t i = (uint8_t)__builtin_ctz(p);
+        const uint16_t bit = (uint16_t)(1 << i);
+        if (s_img.out & bit) autooff::arm(i, s_rules.stairSecs[i], nowUs);
+        else if (hal::relayTarget(i, false)) continue;     // Still switching
+        s_stairPending &= ~bit;
+    }
+}
+
+// --- Scan ---
+
+uint8_t scan() {
+    bool stateChanged = false;
+    uint8_t fx = 0;
+    hal::relayBatch(true);      // Outputs of this scan go out together
+
+    // --- Read inputs ---
+    // Drain captured input edges through the DC/AC conditioning
+    uint16_t prevIn = s_img.in;
+    s_changed = 0;
+    hal::Edge ev;
+    while (hal::inputPop(ev)) {
+        if (inputMode[ev.channel] == inputfilter::MODE_COUNTER) {
+            hal::counterEdge(ev.channel, ev.level, ev.tsUs);
+            continue;
+        }
+        if (inputfilter::feed(ev.channel, ev.level, ev.tsUs)) onInputChanged(ev.channel, ev.tsUs);
+    }
+    const int64_t nowUs = hal::nowUs();
+    for (uint16_t timedOut = inputfilter::poll(nowUs); timedOut; timedOut &= (uint16_t)(timedOut - 1)) {
+        onInputChanged((uint8_t)__builtin_ctz(timedOut), nowUs);
+    }
+    if (hal::counterPoll(nowUs)) stateChanged = true;
+
+    const uint32_t dropped = hal::inputDropped();
+    if (dropped != s_lastDropped) {
+        dbg::warn(dbg::CAT_INPUT, "Eingangs-Ringpuffer voll: %u Flanken verworfen", dropped - s_lastDropped);
+        s_lastDropped = dropped;
+        // Resync with the real pin levels, edges in between are lost
+        const uint16_t raw = hal::inputLevels();
+        uint16_t dc = 0;
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (inputfilter::mode(i) == inputfilter::MODE_DC) {
+                inputfilter::reset(i, (raw >> i) & 1);
+                dc |= (uint16_t)(1 << i);
+            }
+        }
+        s_img.in = (uint16_t)((s_img.in & ~dc) | (raw & dc));
+        prevIn = (uint16_t)((prevIn & ~dc) | (raw & dc));    // No edges from a resync
+        s_changed &= ~dc;
+        publishInputs();
+        stateChanged = true;
+    }
+
+    // Edges of all channels at once
+    s_img.out = committedOutputs();
+    if (s_stairPending) armStairs(nowUs);
+    procimage::latchEdges(s_img, prevIn, s_changed);
+    if (s_changed) {
+        publishInputs();
+        stateChanged = true;
+    }
+
+    // --- Evaluate ---
+    // Rising edge of a mapped input toggles its relay (impulse switch)
+    for (uint16_t rise = s_img.rise; rise; rise &= (uint16_t)(rise - 1)) {
+        const int8_t out = inputMapping[__builtin_ctz(rise)];
+        if (out >= 0 && out < NUM_CHANNELS) toggleRelay((uint8_t)out);
+    }
+    // Top board button i toggles relay i
+    for (uint16_t press = hal::buttonPresses(); press; press &= (uint16_t)(press - 1)) {
+        const uint8_t ch = (uint8_t)__builtin_ctz(press);
+        crashlog::trace(dbg::CAT_INPUT, "Taste %d", ch + 1);
+        toggleRelay(ch);
+    }
+    if (s_rules.rows && evalRules(nowUs)) stateChanged = true;
+
+    // Auto-off deadlines reached (the timer wakes us, no per-channel scan)
+    autooff::heartbeat(nowUs);
+    if (s_autoOffDue) {
+        s_autoOffDue = false;
+        const uint16_t due = autooff::takeExpired(hal::nowUs()) & committedOutputs();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (!(due & (1 << i))) continue;
+            dbg::info(dbg::CAT_TIMER, "Auto-Aus: Relais %d nach %u s", i + 1, autoOffSeconds[i]);
+            setRelay(i, false);
+            stateChanged = true;
+        }
+    }
+
+    // Relay pulses completed in the background -> publish new state
+    if (s_relayCommitted) {
+        s_relayCommitted = false;
+        fx |= FX_RELAY;
+        stateChanged = true;
+    }
+
+    // --- Write outputs ---
+    hal::relayBatch(false);
+    if (stateChanged) fx |= FX_STATE;
+    return fx;
+}
+
+// --- Commands ---
+
+uint8_t execute(const binproto::Command& c) {
+    uint8_t fx = 0;
+    switch (c.cmd) {
+        case binproto::CMD_TOGGLE:
+            if (c.ch < NUM_CHANNELS) toggleRelay(c.ch);
+            break;
+        case binproto::CMD_SET:
+            if (c.ch < NUM_CHANNELS) setRelay(c.ch, c.value != 0);
+            break;
+        case binproto::CMD_MAP:
+            if (c.ch < NUM_CHANNELS && c.value >= -1 && c.value < NUM_CHANNELS) {
+                inputMapping[c.ch] = (int8_t)c.value;
+                dbg::info(dbg::CAT_CONFIG, "Mapping E%d -> A%d", c.ch + 1, (int)c.value + 1);
+                fx |= FX_CONFIG;
+            }
+            break;
+        case binproto::CMD_TIMER:
+            if (c.ch < NUM_CHANNELS && c.value >= 0) {
+                autoOffSeconds[c.ch] = (uint32_t)c.value;
+                if (autooff::armed(c.ch)) {
+                    autooff::retime(c.ch, autoOffSeconds[c.ch]);
+                } else if ((committedOutputs() >> c.ch) & 1) {
+                    autooff::arm(c.ch, autoOffSeconds[c.ch], hal::nowUs());
+                }
+                dbg::info(dbg::CAT_TIMER, "Auto-Aus A%d: %u s", c.ch + 1, autoOffSeconds[c.ch]);
+                fx |= FX_CONFIG;
+            }
+            break;
+        case binproto::CMD_INMODE: {
+            const uint8_t mode = (uint8_t)(c.value & 0xFF);
+            if (c.ch < NUM_CHANNELS && mode <= inputfilter::MODE_COUNTER) {
+                static const char* const NAMES[] = {"DC", "AC", "S0"};
+                inputMode[c.ch] = mode;
+                inputFilterMs[c.ch] = (uint16_t)(c.value >> 8);
+                applyInputMode(c.ch);
+                dbg::info(dbg::CAT_INPUT, "Eingang %d: Modus %s, %u ms", c.ch + 1,
+                          NAMES[mode], inputfilter::filterMs(c.ch));
+                fx |= FX_CONFIG;
+            }
+            break;
+        }
+        case binproto::CMD_S0IMP:
+            if (c.ch < NUM_CHANNELS && c.value > 0 && c.value <= 65535) {
+                s0Imp[c.ch] = (uint16_t)c.value;
+                applyInputMode(c.ch);
+                fx |= FX_CONFIG;
+            }
+            break;
+        case binproto::CMD_ALLOFF:
+            dbg::info(dbg::CAT_RELAY, "Alle Relais AUS");
+            hal::relayBatch(true);  // All RESET pulses in one write per MCP
+            for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+                if (hal::relayTarget(i, (committedOutputs() >> i) & 1)) setRelay(i, false);
+            }
+            hal::relayBatch(false);
+            break;
+        default:
+            break;
+    }
+    return fx;
+}
+
+// --- Snapshot ---
+
+void capture(stateproto::Snapshot& s, int64_t nowUs) {
+    const procimage::Image img = image();
+    s.inputs = img.in;
+    s.outputs = img.out;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        s.mappings[i] = inputMapping[i];
+        s.timers[i] = autoOffSeconds[i];
+        s.remaining[i] = remainingAutoOff(i, nowUs);
+        s.inModes[i] = inputMode[i];
+        s.inFilterMs[i] = inputfilter::filterMs(i);
+        s.counts[i] = hal::counterTotal(i);
+        s.power[i] = hal::counterPowerW(i);
+        s.s0Imp[i] = s0Imp[i] ? s0Imp[i] : s0counter::IMP_DEFAULT;
+    }
+}
+
+} // namespace iologic
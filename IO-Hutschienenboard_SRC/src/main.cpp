@@ -3,20 +3,38 @@
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <esp_netif.h>
+#include <esp_heap_caps.h>
 #include <lwip/ip4_addr.h>
 #include <dhcpserver/dhcpserver.h>
 #include <ESPAsyncWebServer.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
-#if !SIMULATE_HW
-#include <Adafruit_MCP23X17.h>
-#endif
 #include "pin_config.h"
 #include "swtools.h"
 #include "statusled.h"
+#include "inputcap.h"
+#include "relaypulse.h"
+#include "mcpport.h"
+#include "stateproto.h"
+#include "binproto.h"
+#include "inputfilter.h"
+#include "s0counter.h"
+#include "scantask.h"
+#include "crashlog.h"
+#include "configblob.h"
+#include "webassets.h"
+#include "hal.h"
+#include "iologic.h"
+#include "framepace.h"
+#include "cmdqueue.h"
+#include "buttons.h"
+#include "topleds.h"
+#include "framepool.h"
+#include <atomic>
 
 using namespace dbg;
+using namespace iologic;   // I/O image and relay control (iologic.h)
 
 // ============================================================
 // WiFi Configuration - AP mode for initial setup
@@ -28,6 +46,39 @@ const IPAddress AP_GATEWAY(192, 168, 50, 1);
 const IPAddress AP_SUBNET(255, 255, 255, 0);
 const bool ENABLE_DHCP_DIAG = false;
 
+// ============================================================
+// WebSocket broadcast tuning (override via build_flags)
+// WS_COALESCE_MS / WS_MAX_FPS: see framepace.h
+// ============================================================
+#ifndef WS_LAG_QUEUE_LEN
+#define WS_LAG_QUEUE_LEN 4         // Queued messages before a client counts as lagging
+#endif
+#ifndef WS_FRAME_POOL
+#define WS_FRAME_POOL (WS_LAG_QUEUE_LEN + 2)   // Preallocated frames: a full queue + the one in hand
+#endif
+
+// ============================================================
+// Task layout (override via build_flags)
+// IO scan task on the app core, network/housekeeping on core 0
+// ============================================================
+#ifndef IO_SCAN_MS
+#define IO_SCAN_MS 2               // PLC scan period (1..5 ms)
+#endif
+#ifndef IO_TASK_PRIO
+#define IO_TASK_PRIO 10            // Above loopTask, below the WiFi stack
+#endif
+#ifndef HK_PERIOD_MS
+#define HK_PERIOD_MS 10            // Housekeeping / broadcast period
+#endif
+#define IO_TASK_CORE APP_CPU_NUM
+#define HK_TASK_CORE PRO_CPU_NUM
+
+// async_tcp runs at CONFIG_ASYNC_TCP_PRIORITY (10) and, unpinned, would
+// time-slice with the scan task on the app core: platformio.ini pins it
+// to core 0 with the network stack
+static_assert(CONFIG_ASYNC_TCP_RUNNING_CORE == HK_TASK_CORE || IO_TASK_PRIO > CONFIG_ASYNC_TCP_PRIORITY,
+              "async_tcp shares the IO core at the scan task's priority");
+
 String sta_ssid = "";
 String sta_pass = "";
 
@@ -38,33 +89,20 @@ AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
 Preferences prefs;
 
-#if !SIMULATE_HW
-Adafruit_MCP23X17 mcp[2];
-#endif
 bool mcpReady[2] = {false, false};
 
-bool relayState[NUM_CHANNELS] = {false};
-bool inputState[NUM_CHANNELS] = {false};
-bool inputStatePrev[NUM_CHANNELS] = {false};
-
-int8_t inputMapping[NUM_CHANNELS];
-
-uint32_t autoOffSeconds[NUM_CHANNELS] = {0};
-unsigned long relayOnTimestamp[NUM_CHANNELS] = {0};
+// Guards the I/O image (iologic): held by the scan cycle and by commands
+// arriving from the async TCP task
+SemaphoreHandle_t ioLock = nullptr;
+volatile bool ledUpdatePending = false;   // Set by the IO task, LED logic touches WiFi/ws
 
-uint32_t getRemainingAutoOffSeconds(uint8_t ch, unsigned long nowMs) {
-    if (ch >= NUM_CHANNELS) return 0;
-    if (!relayState[ch]) return 0;
-    if (autoOffSeconds[ch] == 0) return 0;
-    if (relayOnTimestamp[ch] == 0) return 0;
-
-    const unsigned long totalMs = (unsigned long)autoOffSeconds[ch] * 1000UL;
-    const unsigned long elapsedMs = nowMs - relayOnTimestamp[ch];
-    if (elapsedMs >= totalMs) return 0;
-
-    const unsigned long remainingMs = totalMs - elapsedMs;
-    return (remainingMs + 999UL) / 1000UL;
-}
+// WiFi credentials from a client; the housekeeping task stores them and restarts
+struct WifiRequest {
+    char ssid[33];
+    char pass[65];
+};
+WifiRequest wifiRequest;
+std::atomic<bool> wifiRequestPending{false};
 
 // ============================================================
 // Helper: determine correct LED state based on system status
@@ -77,10 +115,7 @@ void updateLedState() {
     }
 #endif
 
-    bool anyRelayOn = false;
-    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        if (relayState[i]) { anyRelayOn = true; break; }
-    }
+    const bool anyRelayOn = iologic::image().out != 0;
 
     bool wsClients = ws.count() > 0;
 
@@ -100,192 +135,632 @@ void updateLedState() {
 // ============================================================
 // MCP23017 Init
 // ============================================================
+static_assert(MCP_SLOTS <= MCP_MAX_CHIPS, "mcpport has fewer chip slots than the board map");
+
 void setupMCP() {
 #if SIMULATE_HW
-    mcpReady[0] = true;
-    mcpReady[1] = true;
-    dbg::warn(CAT_MCP, "*** SIMULATE_HW: MCP23017 simuliert ***");
+    dbg::warn(CAT_MCP, "*** SIMULATE_HW: MCP23017 simuliert (Mock-Bus) ***");
 #else
     Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+#endif
+    mcpport::begin(Wire);
 
-    const uint8_t addrs[2] = {MCP_ADDR_1, MCP_ADDR_2};
+    const uint8_t relayChips[2] = {MCP_RELAY_1, MCP_RELAY_2};
     for (uint8_t m = 0; m < 2; m++) {
-        if (mcp[m].begin_I2C(addrs[m], &Wire)) {
+        const uint8_t addr = MCP_ADDR[relayChips[m]];
+        if (mcpport::addOutputChip(relayChips[m], addr)) {
             mcpReady[m] = true;
-            dbg::info(CAT_MCP, "MCP23017 #%d (0x%02X) OK", m + 1, addrs[m]);
-            for (uint8_t p = 0; p < 16; p++) {
-                mcp[m].pinMode(p, OUTPUT);
-                mcp[m].digitalWrite(p, LOW);
-            }
+            dbg::info(CAT_MCP, "MCP23017 #%d (0x%02X) OK", m + 1, addr);
         } else {
-            dbg::error(CAT_MCP, "MCP23017 #%d (0x%02X) NICHT GEFUNDEN!", m + 1, addrs[m]);
+            dbg::error(CAT_MCP, "MCP23017 #%d (0x%02X) NICHT GEFUNDEN!", m + 1, addr);
         }
     }
-#endif
+    if (buttons::begin(MCP_BUTTONS, MCP_ADDR[MCP_BUTTONS], BUTTON_INT_PIN)) {
+        dbg::info(CAT_MCP, "MCP23017 Tasten (0x%02X) OK, INT an GPIO%d", MCP_ADDR[MCP_BUTTONS], BUTTON_INT_PIN);
+    } else {
+        dbg::warn(CAT_MCP, "MCP23017 Tasten (0x%02X) nicht gefunden - keine Tasten", MCP_ADDR[MCP_BUTTONS]);
+    }
+    if (topleds::begin(MCP_LEDS, MCP_ADDR[MCP_LEDS])) {
+        dbg::info(CAT_MCP, "MCP23017 LEDs (0x%02X) OK", MCP_ADDR[MCP_LEDS]);
+    } else {
+        dbg::warn(CAT_MCP, "MCP23017 LEDs (0x%02X) nicht gefunden - keine Status-LEDs", MCP_ADDR[MCP_LEDS]);
+    }
+}
+
+// Top board LEDs: relay image, running timers (slow) and driver faults (fast);
+// the bus sees a write only when the LED image changes
+void topLedTick(uint16_t timers, uint32_t now) {
+    uint16_t faults = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (!hal::relayReady(i)) faults |= (uint16_t)(1 << i);
+    }
+    topleds::update(iologic::image().out, timers, faults, now);
 }
 
 // ============================================================
 // Relay Control via MCP23017
 // ============================================================
-void setRelay(uint8_t ch, bool on) {
-    if (ch >= NUM_CHANNELS) return;
-
+// Coil driver for the pulse scheduler (pulse start and end), staged in the MCP shadow
+void driveRelayCoil(uint8_t ch, bool on, bool active) {
 #if SIMULATE_HW
-    dbg::debug(CAT_RELAY, "[SIM] Relais %d: Puls auf %s-Pin", ch + 1, on ? "SET" : "RESET");
-#else
-    const RelayPinDef& rp = RELAY_PINS[ch];
-    if (!mcpReady[rp.mcpIndex]) {
-        dbg::error(CAT_RELAY, "Relais %d: MCP23017 #%d nicht bereit!", ch + 1, rp.mcpIndex + 1);
-        return;
+    if (active) {
+        dbg::debug(CAT_RELAY, "[SIM] Relais %d: Puls auf %s-Pin", ch + 1, on ? "SET" : "RESET");
     }
-
-    uint8_t pin = on ? rp.setPin : rp.resetPin;
-    mcp[rp.mcpIndex].digitalWrite(pin, HIGH);
-    delay(RELAY_PULSE_MS);
-    mcp[rp.mcpIndex].digitalWrite(pin, LOW);
 #endif
-
-    relayState[ch] = on;
-    relayOnTimestamp[ch] = on ? millis() : 0;
-    dbg::info(CAT_RELAY, "Relais %d: %s", ch + 1, on ? "EIN" : "AUS");
-
-    updateLedState();
+    const RelayPinDef& rp = RELAY_PINS[ch];
+    mcpport::write(rp.mcpIndex, on ? rp.setPin : rp.resetPin, active);
 }
 
-void toggleRelay(uint8_t ch) {
-    setRelay(ch, !relayState[ch]);
+void flushRelayCoils() {
+    mcpport::flush();
 }
 
 // ============================================================
 // Configuration persistence (NVS)
+// The configuration is one CRC-protected, versioned blob (see
+// configblob.h) under a single key: boot reads it with one getBytes().
+// Changes only mark it dirty; the housekeeping task writes it
+// CONFIG_COMMIT_MS after the last change, so a burst of UI changes
+// ends in one small NVS write. Restart paths commit right away.
 // ============================================================
-void loadConfig() {
-    prefs.begin("io-config", true);
-    sta_ssid = prefs.getString("ssid", "");
-    sta_pass = prefs.getString("pass", "");
+#define CONFIG_COMMIT_MS 2000UL    // Debounce before the NVS commit
+#define CONFIG_NS        "io-config"   // Legacy keys (the HAL store uses the same namespace)
+#define CONFIG_KEY       "cfg"
+#define CONFIG_READ_MAX  1024      // Also fits a larger blob of a newer firmware
+
+static_assert(NUM_CHANNELS == CFG_BLOB_CHANNELS, "Config blob layout is for 12 channels");
+static_assert(RULES_TEXT_MAX == CFG_BLOB_RULES, "Config blob layout is for 512 bytes of rules");
+
+volatile bool cfgPending = false;      // Changed since the last commit
+volatile uint32_t cfgChangedMs = 0;
+
+SemaphoreHandle_t cfgLock = nullptr;   // One NVS session at a time
+uint8_t cfgStored[CFG_BLOB_MAX];       // Blob as it is in NVS (identical commits are skipped)
+size_t cfgStoredLen = 0;
+uint32_t cfgCommits = 0;               // NVS writes
+uint32_t cfgBytes = 0;                 // Bytes written
+
+// Call with ioLock held (or before the tasks run)
+void configFromGlobals(configblob::Config& c) {
+    configblob::defaults(c);
+    strlcpy(c.ssid, sta_ssid.c_str(), sizeof(c.ssid));
+    strlcpy(c.pass, sta_pass.c_str(), sizeof(c.pass));
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        c.inputMapping[i] = inputMapping[i];
+        c.autoOffSeconds[i] = autoOffSeconds[i];
+        c.inputMode[i] = inputMode[i];
+        c.inputFilterMs[i] = inputFilterMs[i];
+        c.s0Imp[i] = s0Imp[i];
+    }
+    strlcpy(c.rules, rulesText, sizeof(c.rules));
+}
 
+void configToGlobals(const configblob::Config& c) {
+    sta_ssid = c.ssid;
+    sta_pass = c.pass;
     for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        String key = "map" + String(i);
-        inputMapping[i] = prefs.getChar(key.c_str(), -1);
-        key = "auto" + String(i);
-        autoOffSeconds[i] = prefs.getUInt(key.c_str(), 0);
+        inputMapping[i] = c.inputMapping[i];
+        autoOffSeconds[i] = c.autoOffSeconds[i];
+        inputMode[i] = c.inputMode[i];
+        inputFilterMs[i] = c.inputFilterMs[i];
+        s0Imp[i] = c.s0Imp[i];
+        applyInputMode(i);
+    }
+    rules::Error err;
+    if (!setRules(c.rules, &err)) {
+        dbg::error(CAT_CONFIG, "Gespeicherte Regeln ungueltig: %s (Zeichen %u)", err.msg, err.pos);
     }
-    prefs.end();
-    dbg::info(CAT_CONFIG, "Konfiguration geladen (SSID: '%s')", sta_ssid.c_str());
 }
 
-void saveConfig() {
-    prefs.begin("io-config", false);
-    prefs.putString("ssid", sta_ssid);
-    prefs.putString("pass", sta_pass);
+// Layout before the blob: one NVS key per value, read through configblob::load()
+bool readLegacyNum(const char* key, configblob::KeyType type, int64_t& v) {
+    if (!prefs.isKey(key)) return false;
+    switch (type) {
+        case configblob::KEY_I8:  v = prefs.getChar(key, 0); break;
+        case configblob::KEY_U8:  v = prefs.getUChar(key, 0); break;
+        case configblob::KEY_U16: v = prefs.getUShort(key, 0); break;
+        case configblob::KEY_U32: v = prefs.getUInt(key, 0); break;
+    }
+    return true;
+}
 
-    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        String key = "map" + String(i);
-        prefs.putChar(key.c_str(), inputMapping[i]);
-        key = "auto" + String(i);
-        prefs.putUInt(key.c_str(), autoOffSeconds[i]);
+bool readLegacyStr(const char* key, char* out, size_t cap) {
+    if (!prefs.isKey(key)) return false;
+    strlcpy(out, prefs.getString(key, "").c_str(), cap);
+    return true;
+}
+
+void removeLegacyKey(const char* key) {
+    prefs.remove(key);
+}
+
+void loadConfig() {
+    static uint8_t buf[CONFIG_READ_MAX];
+    configblob::Config c;
+    uint16_t version = 0;
+    const uint32_t t0 = micros();
+
+    const size_t len = hal::storeRead(CONFIG_KEY, buf, sizeof(buf));
+    prefs.begin(CONFIG_NS, false);
+    const configblob::LegacyReader legacyKeys = {readLegacyNum, readLegacyStr};
+    configblob::Result blob = configblob::EMPTY;
+    const configblob::Result r = configblob::load(buf, len, legacyKeys, c, &version, &blob);
+    if (blob == configblob::CORRUPT) {
+        dbg::error(CAT_CONFIG, "Konfigurationsblob beschaedigt (%u Bytes)", (unsigned)len);
+    }
+    const bool legacy = r == configblob::LEGACY;
+    if (r == configblob::MIGRATED) {
+        dbg::info(CAT_CONFIG, "Konfiguration v%u -> v%u migriert", version, CFG_BLOB_VERSION);
+    } else if (legacy) {
+        dbg::info(CAT_CONFIG, "Konfiguration aus Einzel-Schluesseln uebernommen");
+    } else if (r == configblob::CORRUPT) {
+        dbg::warn(CAT_CONFIG, "Standardkonfiguration aktiv");
+    }
+    const bool store = r == configblob::MIGRATED || legacy || r == configblob::CORRUPT;
+
+    size_t n = configblob::encode(c, cfgStored, sizeof(cfgStored));
+    if (store) {
+        if (hal::storeWrite(CONFIG_KEY, cfgStored, n)) {
+            if (legacy) configblob::forEachLegacyKey(removeLegacyKey);
+        } else {
+            dbg::error(CAT_CONFIG, "Konfiguration konnte nicht gespeichert werden");
+            n = 0;
+        }
+    } else if (r == configblob::EMPTY) {
+        n = 0;      // Nothing in NVS yet
     }
+    cfgStoredLen = n;
     prefs.end();
-    dbg::debug(CAT_CONFIG, "Konfiguration gespeichert");
+
+    configToGlobals(c);
+    dbg::info(CAT_CONFIG, "Konfiguration geladen (SSID: '%s', %lu us)",
+              sta_ssid.c_str(), (unsigned long)(micros() - t0));
+}
+
+// Call with ioLock held
+void markConfigDirty() {
+    cfgChangedMs = millis();
+    cfgPending = true;
+}
+
+// Write the blob (flash writes take milliseconds: never with ioLock held)
+void commitConfig() {
+    xSemaphoreTake(cfgLock, portMAX_DELAY);
+
+    configblob::Config c;
+    xSemaphoreTake(ioLock, portMAX_DELAY);
+    cfgPending = false;     // Later changes mark again
+    configFromGlobals(c);
+    xSemaphoreGive(ioLock);
+
+    uint8_t buf[CFG_BLOB_MAX];
+    const size_t n = configblob::encode(c, buf, sizeof(buf));
+    if (n == cfgStoredLen && memcmp(buf, cfgStored, n) == 0) {
+        xSemaphoreGive(cfgLock);    // Changed and changed back
+        return;
+    }
+
+    const uint32_t t0 = millis();
+    const bool ok = hal::storeWrite(CONFIG_KEY, buf, n);
+    if (ok) {
+        memcpy(cfgStored, buf, n);
+        cfgStoredLen = n;
+        cfgCommits++;
+        cfgBytes += n;
+    } else {
+        cfgChangedMs = millis();
+        cfgPending = true;
+        dbg::error(CAT_CONFIG, "NVS-Schreibfehler, erneuter Versuch in %lu ms", CONFIG_COMMIT_MS);
+    }
+    xSemaphoreGive(cfgLock);
+    dbg::debug(CAT_CONFIG, "Konfiguration gespeichert: %u Bytes in %lu ms",
+               (unsigned)n, (unsigned long)(millis() - t0));
+}
+
+// Housekeeping: commit once the changes have settled
+void configTick(uint32_t now) {
+    if (cfgPending && now - cfgChangedMs >= CONFIG_COMMIT_MS) commitConfig();
 }
 
 // ============================================================
 // WebSocket
 // ============================================================
-String buildStateJson() {
-    JsonDocument doc;
-    JsonArray inputs = doc["inputs"].to<JsonArray>();
-    JsonArray outputs = doc["outputs"].to<JsonArray>();
-    JsonArray mappings = doc["mappings"].to<JsonArray>();
-    JsonArray timers = doc["timers"].to<JsonArray>();
-    JsonArray remaining = doc["remaining"].to<JsonArray>();
-    JsonArray mcpStatus = doc["mcp"].to<JsonArray>();
-    unsigned long now = millis();
+stateproto::Snapshot lastSentState;   // Baseline for the next delta frame
+uint32_t stateSeq = 0;                // Sequence number of the last broadcast frame
+SemaphoreHandle_t stateLock = nullptr;   // Guards the two above
+
+void captureState(stateproto::Snapshot& s) {
+    xSemaphoreTake(ioLock, portMAX_DELAY);
+    iologic::capture(s, hal::nowUs());
+    s.mcp = (mcpReady[0] ? 1 : 0) | (mcpReady[1] ? 2 : 0);
+    xSemaphoreGive(ioLock);
+    s.ntp = dbg::isTimeSynced();
+    dbg::formatTimestamp(s.time, sizeof(s.time));
+}
 
-    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        inputs.add(inputState[i]);
-        outputs.add(relayState[i]);
-        mappings.add(inputMapping[i]);
-        timers.add(autoOffSeconds[i]);
-        remaining.add(getRemainingAutoOffSeconds(i, now));
-    }
-    mcpStatus.add(mcpReady[0]);
-    mcpStatus.add(mcpReady[1]);
-    doc["time"] = dbg::getTimestamp();
-    doc["ntp"] = dbg::isTimeSynced();
+// Full snapshot members, labelled with the frame it belongs to
+void writeFullState(stateproto::JsonWriter& w, const stateproto::Snapshot& snap, uint32_t seq) {
+    stateproto::writeFull(w, snap, seq);
 #if SIMULATE_HW
-    doc["sim"] = true;
+    w.key("sim");
+    w.addBool(true);
 #endif
+}
+
+// --- Per-client protocol / backpressure state ---
+#define MAX_WS_CLIENTS 8
+
+struct WsClientInfo {
+    uint32_t id;        // 0 = free slot
+    bool     binary;    // Negotiated the "bin1" subprotocol
+    bool     stale;     // Skipped frames while lagging, needs a full snapshot
+};
+
+WsClientInfo wsClients[MAX_WS_CLIENTS] = {};   // Guarded by stateLock
+
+// --- Broadcast statistics (pacing: framepace.h) ---
+uint32_t wsFramesSent = 0;        // Broadcast frames formatted
+uint32_t wsSkipped = 0;           // Frames skipped for lagging clients
+
+// Broadcast buffers, reused once the library has sent them (housekeeping task)
+FramePool<WS_FRAME_POOL> jsonFrames;      // Delta and catch-up snapshots
+FramePool<WS_FRAME_POOL> binFrames;       // StateFrame
+
+WsClientInfo* findClient(uint32_t id) {
+    for (uint8_t i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (wsClients[i].id == id) return &wsClients[i];
+    }
+    return nullptr;
+}
+
+// false = table full; broadcasts only reach clients listed here
+bool addClient(uint32_t id) {
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    WsClientInfo* info = findClient(0);
+    if (info) *info = {id, false, false};
+    xSemaphoreGive(stateLock);
+    return info != nullptr;
+}
+
+void removeClient(uint32_t id) {
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    WsClientInfo* info = findClient(id);
+    if (info) *info = {0, false, false};
+    xSemaphoreGive(stateLock);
+}
+
+void setBinaryClient(uint32_t id, bool binary) {
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    WsClientInfo* info = findClient(id);
+    if (info) info->binary = binary;
+    xSemaphoreGive(stateLock);
+}
+
+bool isBinaryClient(uint32_t id) {
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    WsClientInfo* info = findClient(id);
+    const bool binary = info && info->binary;
+    xSemaphoreGive(stateLock);
+    return binary;
+}
+
+void buildStateFrame(const stateproto::Snapshot& snap, uint32_t seq, binproto::StateFrame& frame) {
+#if SIMULATE_HW
+    binproto::encodeState(snap, seq, binproto::SF_SIM, frame);
+#else
+    binproto::encodeState(snap, seq, 0, frame);
+#endif
+}
+
+// State of the last broadcast frame and its sequence number: the
+// baseline the next delta is diffed against
+uint32_t sentState(stateproto::Snapshot& snap) {
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    snap = lastSentState;
+    const uint32_t seq = stateSeq;
+    xSemaphoreGive(stateLock);
+    return seq;
+}
+
+// Full snapshot to one client in its negotiated format. Not a fresh
+// capture: a change undone before the next broadcast would never show
+// up in a delta, the client would keep it.
+void sendFullState(AsyncWebSocketClient* client) {
+    stateproto::Snapshot snap;
+    const uint32_t seq = sentState(snap);
+    if (isBinaryClient(client->id())) {
+        binproto::StateFrame frame;
+        buildStateFrame(snap, seq, frame);
+        hal::transportSend(client->id(), (const uint8_t*)&frame, sizeof(frame), true);
+    } else {
+        char buf[STATE_JSON_MAX];
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        writeFullState(w, snap, seq);
+        w.endObject();
+        hal::transportSend(client->id(), (const uint8_t*)buf, w.length(), false);
+    }
+}
+
+// Mark the state as changed; the frame goes out from broadcastTick()
+void requestBroadcast() {
+    framepace::request(millis());
+}
+
+// Send the newest state to every client. JSON clients get a delta,
+// binary clients the fixed-size StateFrame. A client whose send queue
+// is backed up skips frames and gets a full snapshot once it drained.
+// Each frame is formatted once, straight into the reference-counted
+// message buffer all clients share - no staging copy, no per-client copies,
+// and the buffers come from the pools (no heap traffic in steady state).
+void broadcastState() {
+    stateproto::Snapshot snap;
+    captureState(snap);
+    AsyncWebSocketSharedBuffer text = jsonFrames.take(STATE_JSON_MAX);
+
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    stateproto::JsonWriter w((char*)text->data(), text->size());
+    w.beginObject();
+    const bool changed = stateproto::writeDelta(w, lastSentState, snap, stateSeq + 1);
+    w.endObject();
+    text->resize(w.length());
+    if (changed && !w.ok()) {
+        xSemaphoreGive(stateLock);
+        dbg::error(CAT_WEB, "State-Frame zu gross (> %u Bytes)", STATE_JSON_MAX);
+        return;
+    }
+    if (changed) {
+        stateSeq++;
+        lastSentState = snap;
+        wsFramesSent++;
+    }
+    const uint32_t seq = stateSeq;      // snap is lastSentState now (or equal to it)
+    WsClientInfo clients[MAX_WS_CLIENTS];
+    memcpy(clients, wsClients, sizeof(clients));
+    xSemaphoreGive(stateLock);
+
+    // Clients are addressed by id through the library's own locked calls
+    // (client(), text(), binary()): walking ws.getClients() from this task
+    // races with connects / disconnects in the async TCP task.
+    AsyncWebSocketSharedBuffer full, bin;
+    uint32_t skipped = 0;
+    for (uint8_t i = 0; i < MAX_WS_CLIENTS; i++) {
+        WsClientInfo& info = clients[i];
+        if (info.id == 0) continue;
+        if (!changed && !info.stale) continue;
+
+        AsyncWebSocketClient* c = ws.client(info.id);   // nullptr once disconnected
+        if (!c) continue;
+        if (c->queueLen() >= WS_LAG_QUEUE_LEN) {
+            // Lagging: drop this frame, catch up with a snapshot later
+            if (changed) skipped++;
+            info.stale = true;
+            continue;
+        }
+
+        if (info.binary) {
+            if (!bin) {
+                bin = binFrames.take(sizeof(binproto::StateFrame));
+                buildStateFrame(snap, seq, *(binproto::StateFrame*)bin->data());   // Packed: any alignment
+            }
+            ws.binary(info.id, bin);
+        } else if (info.stale) {
+            if (!full) {
+                full = jsonFrames.take(STATE_JSON_MAX);
+                stateproto::JsonWriter fw((char*)full->data(), full->size());
+                fw.beginObject();
+                writeFullState(fw, snap, seq);
+                fw.endObject();
+                full->resize(fw.length());
+            }
+            ws.text(info.id, full);
+        } else {
+            ws.text(info.id, text);
+        }
+        info.stale = false;
+    }
+
+    // Write the lag state back; slots may have changed hands meanwhile
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (clients[i].id == 0) continue;
+        WsClientInfo* info = findClient(clients[i].id);
+        if (info) info->stale = clients[i].stale;
+    }
+    wsSkipped += skipped;
+    xSemaphoreGive(stateLock);
+}
+
+bool anyStaleClient() {
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    bool stale = false;
+    for (uint8_t i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (wsClients[i].id != 0 && wsClients[i].stale) stale = true;
+    }
+    xSemaphoreGive(stateLock);
+    return stale;
+}
 
-    String json;
-    serializeJson(doc, json);
-    return json;
+// Call from loop(): sends at most one frame per window / rate slot
+void broadcastTick() {
+    if (framepace::tick(millis(), anyStaleClient)) broadcastState();
+}
+
+// Commands shared by the JSON and the binary protocol: the IO task
+// executes them, the handler returns at once
+void queueCommand(const binproto::Command& c) {
+    if (!cmdqueue::post(c)) {
+        dbg::warn(CAT_WEB, "Kommando-Warteschlange voll: 0x%02X (Kanal %u) verworfen", c.cmd, c.ch + 1);
+    }
 }
 
-void sendState() {
-    ws.textAll(buildStateJson());
+// Compile and activate client rules, result fields into w:
+// "ok", then "rows" or "error" / "pos" (byte offset in the text)
+bool applyRules(const char* text, stateproto::JsonWriter& w) {
+    // Compiled without the lock (the scan keeps running), async_tcp task only
+    static rules::Program compiled;
+    rules::Error err;
+    const bool ok = rules::compile(text, compiled, &err);
+    if (ok) {
+        xSemaphoreTake(ioLock, portMAX_DELAY);
+        activateRules(text, compiled);
+        markConfigDirty();
+        xSemaphoreGive(ioLock);
+    }
+    const uint8_t rows = compiled.rows;
+
+    w.key("ok");
+    w.addBool(ok);
+    if (ok) {
+        w.key("rows");
+        w.addUint(rows);
+    } else {
+        dbg::warn(CAT_CONFIG, "Regeln abgelehnt: %s (Zeichen %u)", err.msg, err.pos);
+        w.key("error");
+        w.addStr(err.msg);
+        w.key("pos");
+        w.addUint(err.pos);
+    }
+    return ok;
+}
+
+void onBinaryMessage(AsyncWebSocketClient* client, uint8_t* data, size_t len) {
+    binproto::Command c;
+    if (!binproto::decodeCommand(data, len, c)) {
+        dbg::warn(CAT_WEB, "WebSocket Client #%u: ungueltiger Binaer-Frame (%u Bytes)", client->id(), (unsigned)len);
+        return;
+    }
+    dbg::debug(CAT_WEB, "WS Binaer-Kommando: 0x%02X", c.cmd);
+
+    if (c.cmd == binproto::CMD_HELLO && c.value != BINPROTO_VERSION) {
+        // Stays on its current protocol; a newer client can retry with bin1
+        dbg::warn(CAT_WEB, "WebSocket Client #%u: Binaerprotokoll v%ld nicht unterstuetzt (v%d)", client->id(),
+                  (long)c.value, BINPROTO_VERSION);
+        return;
+    }
+    if (c.cmd == binproto::CMD_HELLO || c.cmd == binproto::CMD_RESYNC) {
+        setBinaryClient(client->id(), true);
+        sendFullState(client);
+        return;
+    }
+    queueCommand(c);
+}
+
+void onTextMessage(AsyncWebSocketClient* client, uint8_t* data, size_t len) {
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, data, len);
+    if (err) return;
+
+    const char* cmd = doc["cmd"];
+    if (!cmd) return;
+
+    dbg::debug(CAT_WEB, "WS Kommando: %s", cmd);
+
+    binproto::Command c = {0xFF, 0, 0};
+    if (strcmp(cmd, "hello") == 0) {
+        const char* proto = doc["proto"] | "json";
+        const bool binary = strcmp(proto, "bin1") == 0;
+        dbg::info(CAT_WEB, "WebSocket Client #%u: Protokoll %s", client->id(), binary ? "bin1" : "json");
+        setBinaryClient(client->id(), binary);
+        sendFullState(client);
+        return;
+    } else if (strcmp(cmd, "resync") == 0) {
+        dbg::debug(CAT_WEB, "WebSocket Client #%u: Resync", client->id());
+        sendFullState(client);
+        return;
+    } else if (strcmp(cmd, "toggle") == 0) {
+        c.cmd = binproto::CMD_TOGGLE;
+        c.ch = doc["ch"].as<uint8_t>();
+    } else if (strcmp(cmd, "set") == 0) {
+        c.cmd = binproto::CMD_SET;
+        c.ch = doc["ch"].as<uint8_t>();
+        c.value = doc["val"].as<bool>() ? 1 : 0;
+    } else if (strcmp(cmd, "map") == 0) {
+        c.cmd = binproto::CMD_MAP;
+        c.ch = doc["input"].as<uint8_t>();
+        c.value = doc["output"].as<int8_t>();
+    } else if (strcmp(cmd, "timer") == 0) {
+        c.cmd = binproto::CMD_TIMER;
+        c.ch = doc["ch"].as<uint8_t>();
+        c.value = doc["secs"].as<int32_t>();
+    } else if (strcmp(cmd, "inmode") == 0) {
+        const char* mode = doc["mode"] | "dc";
+        c.cmd = binproto::CMD_INMODE;
+        c.ch = doc["ch"].as<uint8_t>();
+        uint8_t m = inputfilter::MODE_DC;
+        if (strcmp(mode, "ac") == 0) m = inputfilter::MODE_AC;
+        else if (strcmp(mode, "s0") == 0) m = inputfilter::MODE_COUNTER;
+        c.value = m | ((int32_t)doc["ms"].as<uint16_t>() << 8);
+    } else if (strcmp(cmd, "s0imp") == 0) {
+        c.cmd = binproto::CMD_S0IMP;
+        c.ch = doc["ch"].as<uint8_t>();
+        c.value = doc["imp"].as<int32_t>();
+    } else if (strcmp(cmd, "alloff") == 0) {
+        c.cmd = binproto::CMD_ALLOFF;
+    } else if (strcmp(cmd, "rules") == 0) {
+        // Answer only to the sender: {"rules":{"ok":...}}
+        char buf[160];
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        w.key("rules");
+        w.beginObject();
+        applyRules(doc["text"] | "", w);
+        w.endObject();
+        w.endObject();
+        hal::transportSend(client->id(), (const uint8_t*)buf, w.length(), false);
+        return;
+    } else if (strcmp(cmd, "wifi") == 0) {
+        // NVS write and restart take seconds: wifiTick() does them
+        if (wifiRequestPending.load(std::memory_order_acquire)) return;
+        strlcpy(wifiRequest.ssid, doc["ssid"] | "", sizeof(wifiRequest.ssid));
+        strlcpy(wifiRequest.pass, doc["pass"] | "", sizeof(wifiRequest.pass));
+        wifiRequestPending.store(true, std::memory_order_release);
+        return;
+#if SIMULATE_HW
+    } else if (strcmp(cmd, "siminput") == 0) {
+        uint8_t ch = doc["ch"];
+        bool val = doc["val"];
+        if (ch < NUM_CHANNELS && !inputcap::inject(ch, val)) {
+            dbg::warn(CAT_INPUT, "[SIM] Eingang %d: Ringpuffer voll", ch + 1);
+        }
+        return;  // State goes out once the edge has been processed
+    } else if (strcmp(cmd, "simbutton") == 0) {
+        buttons::inject(doc["ch"].as<uint8_t>());
+        return;
+#endif
+    } else {
+        dbg::debug(CAT_WEB, "WS Kommando unbekannt: %s", cmd);
+        return;
+    }
+
+    queueCommand(c);
 }
 
 void onWebSocketEvent(AsyncWebSocket* srv, AsyncWebSocketClient* client,
                        AwsEventType type, void* arg, uint8_t* data, size_t len) {
     if (type == WS_EVT_CONNECT) {
+        if (!addClient(client->id())) {
+            dbg::warn(CAT_WEB, "WebSocket Client #%u abgewiesen: Client-Tabelle voll", client->id());
+            client->close();
+            return;
+        }
         dbg::info(CAT_WEB, "WebSocket Client #%u verbunden", client->id());
-        client->text(buildStateJson());
+        sendFullState(client);
         updateLedState();
     } else if (type == WS_EVT_DISCONNECT) {
         dbg::info(CAT_WEB, "WebSocket Client #%u getrennt", client->id());
+        removeClient(client->id());
         updateLedState();
     } else if (type == WS_EVT_DATA) {
-        JsonDocument doc;
-        DeserializationError err = deserializeJson(doc, data, len);
-        if (err) return;
-
-        const char* cmd = doc["cmd"];
-        if (!cmd) return;
-
-        dbg::debug(CAT_WEB, "WS Kommando: %s", cmd);
-
-        if (strcmp(cmd, "toggle") == 0) {
-            uint8_t ch = doc["ch"];
-            if (ch < NUM_CHANNELS) toggleRelay(ch);
-        } else if (strcmp(cmd, "set") == 0) {
-            uint8_t ch = doc["ch"];
-            bool val = doc["val"];
-            if (ch < NUM_CHANNELS) setRelay(ch, val);
-        } else if (strcmp(cmd, "map") == 0) {
-            uint8_t input = doc["input"];
-            int8_t output = doc["output"];
-            if (input < NUM_CHANNELS && output < (int8_t)NUM_CHANNELS) {
-                inputMapping[input] = output;
-                dbg::info(CAT_CONFIG, "Mapping E%d -> A%d", input + 1, output + 1);
-                saveConfig();
-            }
-        } else if (strcmp(cmd, "timer") == 0) {
-            uint8_t ch = doc["ch"];
-            uint32_t secs = doc["secs"];
-            if (ch < NUM_CHANNELS) {
-                autoOffSeconds[ch] = secs;
-                dbg::info(CAT_TIMER, "Auto-Aus A%d: %u s", ch + 1, secs);
-                saveConfig();
-            }
-        } else if (strcmp(cmd, "wifi") == 0) {
-            sta_ssid = doc["ssid"].as<String>();
-            sta_pass = doc["pass"].as<String>();
-            dbg::info(CAT_WIFI, "WiFi-Konfiguration geaendert: '%s'", sta_ssid.c_str());
-            saveConfig();
-            dbg::warn(CAT_SYSTEM, "Neustart in 1s...");
-            statusled::setState(statusled::ST_BOOTING);
-            statusled::update();
-            delay(1000);
-            ESP.restart();
-        } else if (strcmp(cmd, "alloff") == 0) {
-            dbg::info(CAT_RELAY, "Alle Relais AUS");
-            for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-                if (relayState[i]) setRelay(i, false);
-            }
+        AwsFrameInfo* info = (AwsFrameInfo*)arg;
+        if (!info->final || info->index != 0 || info->len != len) return;   // No fragmented frames
+        const uint32_t t0 = micros();
+        if (info->opcode == WS_BINARY) {
+            onBinaryMessage(client, data, len);
+        } else {
+            onTextMessage(client, data, len);
         }
-
-        sendState();
+        cmdqueue::noteHandler(micros() - t0);
     }
 }
 
@@ -525,36 +1000,210 @@ void setupWiFi() {
 // ============================================================
 // Web Server
 // ============================================================
+const char* formatIp(const IPAddress& addr, char* buf) {
+    snprintf(buf, 16, "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+    return buf;
+}
+
+#define API_JSON_MAX (STATE_JSON_MAX + 1024)   // Full state + diagnostics
+#define CRASHLOG_JSON_MAX (CRASHLOG_ENTRIES * 256 + 256)
+#define RULES_JSON_MAX (RULES_TEXT_MAX * 2 + 128)   // Text with escapes
+
 void setupWebServer() {
     server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest* req) {
-        JsonDocument doc;
-        JsonArray inputs = doc["inputs"].to<JsonArray>();
-        JsonArray outputs = doc["outputs"].to<JsonArray>();
-        JsonArray mappings = doc["mappings"].to<JsonArray>();
-        JsonArray timers = doc["timers"].to<JsonArray>();
-        JsonArray remaining = doc["remaining"].to<JsonArray>();
-        unsigned long now = millis();
+        char buf[API_JSON_MAX];
+        char ip[16];
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        stateproto::Snapshot snap;
+        const uint32_t seq = sentState(snap);
+        writeFullState(w, snap, seq);
+        w.key("ap_ip");
+        w.addStr(formatIp(WiFi.softAPIP(), ip));
+        w.key("sta_ip");
+        w.addStr(formatIp(WiFi.localIP(), ip));
+        w.key("sta_ssid");
+        w.addStr(sta_ssid.c_str());
+        w.key("mcp1");
+        w.addBool(mcpReady[0]);
+        w.key("mcp2");
+        w.addBool(mcpReady[1]);
+        uint16_t s0hw = 0;
         for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-            inputs.add(inputState[i]);
-            outputs.add(relayState[i]);
-            mappings.add(inputMapping[i]);
-            timers.add(autoOffSeconds[i]);
-            remaining.add(getRemainingAutoOffSeconds(i, now));
+            if (s0counter::hardware(i)) s0hw |= (uint16_t)(1 << i);
+        }
+        w.key("s0_pcnt");
+        w.addUint(s0hw);
+        w.key("in_dropped");
+        w.addUint(inputcap::droppedCount());
+        relaypulse::Stats ps = relaypulse::getStats();
+        w.key("pulse_depth");
+        w.addUint(ps.depth);
+        w.key("pulse_max_depth");
+        w.addUint(ps.maxDepth);
+        w.key("pulse_overruns");
+        w.addUint(ps.overruns);
+        w.key("i2c_tx");
+        w.addUint(mcpport::txCount());
+        w.key("i2c_err");
+        w.addUint(mcpport::errorCount());
+        scantask::Stats io = scantask::getStats();
+        w.key("io_period_us");
+        w.addUint(io.periodUs);
+        w.key("io_cycle_us");
+        w.addUint(io.avgUs);
+        w.key("io_cycle_max_us");
+        w.addUint(io.maxUs);
+        w.key("io_jitter_max_us");
+        w.addUint(io.jitterMaxUs);
+        w.key("io_overruns");
+        w.addUint(io.overruns);
+        dbg::LogStats ls = dbg::getLogStats();
+        w.key("log_dropped");
+        w.addUint(ls.dropped);
+        w.key("log_pending");
+        w.addUint(ls.pending);
+        w.key("log_cycles");
+        w.addUint(ls.avgCycles);
+        w.key("log_cycles_max");
+        w.addUint(ls.maxCycles);
+        iologic::RuleStats rs = ruleStats();
+        w.key("rules_rows");
+        w.addUint(rs.rows);
+        w.key("rules_cycles");
+        w.addUint(rs.avgCycles);
+        w.key("rules_cycles_max");
+        w.addUint(rs.maxCycles);
+        w.key("cfg_commits");
+        w.addUint(cfgCommits);
+        w.key("cfg_bytes");
+        w.addUint(cfgBytes);
+        w.key("cfg_pending");
+        w.addBool(cfgPending);
+        webassets::Stats wa = webassets::getStats();
+        w.key("web_sent");
+        w.addUint(wa.sent);
+        w.key("web_not_modified");
+        w.addUint(wa.notModified);
+        w.key("ws_frames");
+        w.addUint(wsFramesSent);
+        w.key("ws_coalesced");
+        w.addUint(framepace::coalesced());
+        w.key("ws_skipped");
+        w.addUint(wsSkipped);
+        w.key("ws_pool_misses");
+        w.addUint(jsonFrames.misses() + binFrames.misses());
+        w.key("led_writes");
+        w.addUint(topleds::writeCount());
+        buttons::Stats bs = buttons::getStats();
+        w.key("btn_reads");
+        w.addUint(bs.reads);
+        w.key("btn_presses");
+        w.addUint(bs.presses);
+        w.key("btn_bounces");
+        w.addUint(bs.bounces);
+        cmdqueue::Stats cq = cmdqueue::getStats();
+        w.key("cmdq_depth");
+        w.addUint(cq.depth);
+        w.key("cmdq_max_depth");
+        w.addUint(cq.maxDepth);
+        w.key("cmdq_posted");
+        w.addUint(cq.posted);
+        w.key("cmdq_rejected");
+        w.addUint(cq.rejected);
+        w.key("cmdq_wait_p50_us");
+        w.addUint(cq.waitP50Us);
+        w.key("cmdq_wait_p99_us");
+        w.addUint(cq.waitP99Us);
+        w.key("cmdq_wait_max_us");
+        w.addUint(cq.waitMaxUs);
+        w.key("ws_handler_p50_us");
+        w.addUint(cq.handlerP50Us);
+        w.key("ws_handler_p90_us");
+        w.addUint(cq.handlerP90Us);
+        w.key("ws_handler_p99_us");
+        w.addUint(cq.handlerP99Us);
+        w.key("ws_handler_max_us");
+        w.addUint(cq.handlerMaxUs);
+        w.endObject();
+
+        if (!w.ok()) {
+            req->send(500);
+            return;
+        }
+        req->send(200, "application/json", buf);
+    });
+    // Post-mortem buffer: run before the last reset, ?cur=1 for this run
+    server.on("/api/crashlog", HTTP_GET, [](AsyncWebServerRequest* req) {
+        const bool current = req->hasParam("cur");
+        char* buf = (char*)heap_caps_malloc(CRASHLOG_JSON_MAX, MALLOC_CAP_SPIRAM);
+        if (!buf) buf = (char*)malloc(CRASHLOG_JSON_MAX);
+        if (!buf) {
+            req->send(503);
+            return;
+        }
+        stateproto::JsonWriter w(buf, CRASHLOG_JSON_MAX);
+        w.beginObject();
+        w.key("reset");
+        w.addStr(crashlog::resetReasonName());
+        w.key("reset_code");
+        w.addInt(crashlog::resetReason());
+        w.key("boot");
+        w.addUint(crashlog::bootCount());
+        w.key("uptime_ms");
+        w.addUint(millis());
+        w.key("run");
+        w.addStr(current ? "current" : "previous");
+        w.key("valid");
+        w.addBool(current || crashlog::previousValid());
+        w.key("lost");
+        w.addUint(crashlog::lostCount(current));
+        w.key("entries");
+        crashlog::writeEntries(w, current);
+        w.endObject();
+
+        if (w.ok()) {
+            req->send(200, "application/json", buf);
+        } else {
+            req->send(500);
+        }
+        free(buf);
+    });
+    // Rule text (rules.h): GET the active rules, POST text/plain to replace them
+    server.on("/api/rules", HTTP_GET, [](AsyncWebServerRequest* req) {
+        char buf[RULES_JSON_MAX];
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        xSemaphoreTake(ioLock, portMAX_DELAY);
+        w.key("rules");
+        w.addStr(rulesText);
+        w.key("rows");
+        w.addUint(ruleStats().rows);
+        xSemaphoreGive(ioLock);
+        w.endObject();
+        if (w.ok()) {
+            req->send(200, "application/json", buf);
+        } else {
+            req->send(500);
         }
-        doc["ap_ip"] = WiFi.softAPIP().toString();
-        doc["sta_ip"] = WiFi.localIP().toString();
-        doc["sta_ssid"] = sta_ssid;
-        doc["mcp1"] = mcpReady[0];
-        doc["mcp2"] = mcpReady[1];
-        doc["time"] = dbg::getTimestamp();
-        doc["ntp"] = dbg::isTimeSynced();
-#if SIMULATE_HW
-        doc["sim"] = true;
-#endif
-
-        String json;
-        serializeJson(doc, json);
-        req->send(200, "application/json", json);
+    });
+    server.on("/api/rules", HTTP_POST, [](AsyncWebServerRequest* req) {
+        if (req->contentLength() >= RULES_TEXT_MAX) {
+            req->send(413);
+            return;
+        }
+        char buf[160];
+        stateproto::JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        const char* text = (const char*)req->_tempObject;
+        const bool ok = applyRules(text ? text : "", w);
+        w.endObject();
+        req->send(ok ? 200 : 400, "application/json", buf);
+    }, nullptr, [](AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total) {
+        // Body collected into _tempObject (freed with the request)
+        if (total >= RULES_TEXT_MAX) return;
+        if (index == 0) req->_tempObject = calloc(1, total + 1);
+        if (req->_tempObject) memcpy((char*)req->_tempObject + index, data, len);
     });
     server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest* req) {
         req->send(204);
@@ -563,6 +1212,7 @@ void setupWebServer() {
     ws.onEvent(onWebSocketEvent);
     server.addHandler(&ws);
 
+    webassets::begin(server);   // Embedded gzip pages, LittleFS only for other files
     server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
 
     server.begin();
@@ -573,15 +1223,23 @@ void setupWebServer() {
 // Input Pins
 // ============================================================
 void setupInputPins() {
+    // Edges are timestamped in the ISR, the IO task drains them every scan
+    inputcap::begin();
+    s0counter::begin();
+    const uint16_t raw = inputcap::levels();
     for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        pinMode(INPUT_PINS[i], INPUT);
+        inputfilter::reset(i, (raw >> i) & 1);
     }
 }
 
 // ============================================================
 // Main
 // ============================================================
+void ioCycle();
+void housekeepingTask(void*);
+
 void setup() {
+    crashlog::begin();      // Before the first log line
     dbg::begin(dbg::LVL_DEBUG, dbg::CAT_ALL);
 
     statusled::begin(20);
@@ -592,7 +1250,12 @@ void setup() {
 #if SIMULATE_HW
     dbg::warn(CAT_SYSTEM, "*** SIMULATIONSMODUS - keine echte Hardware ***");
 #endif
+    dbg::info(CAT_SYSTEM, "Start #%u, Reset-Grund: %s%s", crashlog::bootCount(),
+              crashlog::resetReasonName(),
+              crashlog::previousValid() ? " (Crashlog unter /api/crashlog)" : "");
 
+    ioLock = xSemaphoreCreateMutex();
+    cfgLock = xSemaphoreCreateMutex();
     setupInputPins();
     setupMCP();
     loadConfig();
@@ -606,72 +1269,105 @@ void setup() {
         dbg::info(CAT_SYSTEM, "LittleFS OK");
     }
 
+    stateLock = xSemaphoreCreateMutex();
+    cmdqueue::begin();
     setupWiFi();
-    setupWebServer();
 
-    // Reset all relays to OFF on startup
-#if !SIMULATE_HW
+    // Reset all relays to OFF on startup (one write per MCP for each edge)
+    const uint32_t txBefore = mcpport::txCount();
     for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        if (mcpReady[RELAY_PINS[i].mcpIndex]) {
-            mcp[RELAY_PINS[i].mcpIndex].digitalWrite(RELAY_PINS[i].resetPin, HIGH);
-        }
+        mcpport::write(RELAY_PINS[i].mcpIndex, RELAY_PINS[i].resetPin, HIGH);
     }
+    mcpport::flush();
     delay(RELAY_PULSE_MS);
     for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        if (mcpReady[RELAY_PINS[i].mcpIndex]) {
-            mcp[RELAY_PINS[i].mcpIndex].digitalWrite(RELAY_PINS[i].resetPin, LOW);
-        }
+        mcpport::write(RELAY_PINS[i].mcpIndex, RELAY_PINS[i].resetPin, LOW);
     }
-#endif
-    dbg::info(CAT_RELAY, "Alle Relais zurueckgesetzt");
+    mcpport::flush();
+    dbg::info(CAT_RELAY, "Alle Relais zurueckgesetzt (%u I2C-Transaktionen)",
+              mcpport::txCount() - txBefore);
 
-    updateLedState();
-    dbg::info(CAT_SYSTEM, "Setup abgeschlossen - System bereit");
-}
+    // Relay pulses from here on are non-blocking
+    relaypulse::begin(driveRelayCoil, flushRelayCoils, iologic::onRelayDone, RELAY_PULSE_MS);
 
-void loop() {
-    ws.cleanupClients();
-    statusled::update();
+    // AUTOOFF_RESTORE=1: timers that were running before a warm reset switch
+    // their relay back on for the rest; by default the relays stay off
+    iologic::begin();
 
-    bool stateChanged = false;
+    captureState(lastSentState);
+    jsonFrames.begin(STATE_JSON_MAX);
+    binFrames.begin(sizeof(binproto::StateFrame));
+    setupWebServer();       // Clients start from lastSentState
+    updateLedState();
 
-    // Read inputs with rising edge detection (StromstoÃŸschalter-Logik)
-    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        bool current = digitalRead(INPUT_PINS[i]);
-        if (current && !inputStatePrev[i]) {
-            inputState[i] = true;
-            dbg::debug(CAT_INPUT, "Eingang %d: steigende Flanke", i + 1);
-            if (inputMapping[i] >= 0 && inputMapping[i] < NUM_CHANNELS) {
-                toggleRelay(inputMapping[i]);
-            }
-            stateChanged = true;
-        } else if (!current && inputStatePrev[i]) {
-            inputState[i] = false;
-            stateChanged = true;
-        }
-        inputStatePrev[i] = current;
+    if (!scantask::begin(ioCycle, IO_SCAN_MS, IO_TASK_CORE, IO_TASK_PRIO)) {
+        dbg::error(CAT_SYSTEM, "IO-Task konnte nicht gestartet werden!");
     }
+    xTaskCreatePinnedToCore(housekeepingTask, "housekeeping", 8192, nullptr, 1, nullptr, HK_TASK_CORE);
+    dbg::info(CAT_SYSTEM, "Setup abgeschlossen - IO-Zyklus %u ms auf Core %d", IO_SCAN_MS, IO_TASK_CORE);
+}
 
-    // Auto-off timer check
-    unsigned long now = millis();
-    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
-        if (relayState[i] && autoOffSeconds[i] > 0 && relayOnTimestamp[i] > 0) {
-            if (now - relayOnTimestamp[i] >= (unsigned long)autoOffSeconds[i] * 1000UL) {
-                dbg::info(CAT_TIMER, "Auto-Aus: Relais %d nach %u s", i + 1, autoOffSeconds[i]);
-                setRelay(i, false);
-                stateChanged = true;
-            }
-        }
+// One PLC scan: client commands -> read inputs -> evaluate -> write outputs
+// (IO task, core 1)
+void ioCycle() {
+    uint8_t fx = 0;
+    bool commands = false;
+    xSemaphoreTake(ioLock, portMAX_DELAY);
+    cmdqueue::Message m;
+    while (cmdqueue::pop(m)) {
+        fx |= iologic::execute(m.cmd);
+        commands = true;
     }
+    cmdqueue::endCycle();
+    if (fx & iologic::FX_CONFIG) markConfigDirty();
+    fx |= iologic::scan();
+    xSemaphoreGive(ioLock);
 
-    // Update LED when NTP syncs
-    static bool lastNtpState = false;
-    if (dbg::isTimeSynced() && !lastNtpState) {
-        dbg::info(CAT_NTP, "NTP synchronisiert: %s", dbg::getTimestamp().c_str());
-        updateLedState();
-        lastNtpState = true;
+    if (fx & iologic::FX_RELAY) ledUpdatePending = true;
+    if ((fx & iologic::FX_STATE) || commands) requestBroadcast();
+}
+
+// S0 totals to NVS (every S0_PERSIST_MS, force: now); taken under
+// ioLock, written without it like commitConfig()
+void persistCounters(bool force) {
+    static s0counter::Pending p;
+    xSemaphoreTake(ioLock, portMAX_DELAY);
+    const bool due = s0counter::takeChanged(p, force);
+    xSemaphoreGive(ioLock);
+    if (!due || s0counter::write(p)) return;
+    xSemaphoreTake(ioLock, portMAX_DELAY);
+    s0counter::writeFailed(p);
+    xSemaphoreGive(ioLock);
+    dbg::error(CAT_CONFIG, "S0-Zaehlerstaende: NVS-Schreibfehler");
+}
+
+// Housekeeping: store WiFi credentials from a client, restart 1 s later
+void wifiTick(uint32_t now) {
+    static bool restarting = false;
+    static uint32_t restartAt = 0;
+    if (restarting) {
+        if ((int32_t)(now - restartAt) < 0) return;
+        dbg::flush();
+        ESP.restart();
     }
+    if (!wifiRequestPending.load(std::memory_order_acquire)) return;
+
+    xSemaphoreTake(ioLock, portMAX_DELAY);
+    sta_ssid = wifiRequest.ssid;
+    sta_pass = wifiRequest.pass;
+    markConfigDirty();
+    xSemaphoreGive(ioLock);
+    dbg::info(CAT_WIFI, "WiFi-Konfiguration geaendert: '%s'", sta_ssid.c_str());
+    commitConfig();     // Pending changes go out before the restart
+    persistCounters(true);
+    dbg::warn(CAT_SYSTEM, "Neustart in 1s...");
+    statusled::setState(statusled::ST_BOOTING);
+    statusled::update();
+    restarting = true;
+    restartAt = now + 1000;
+}
 
+void checkApStations(unsigned long now) {
     // Periodische AP-Station-Ãœberwachung (alle 5 Sekunden)
     static unsigned long lastStaCheck = 0;
     static uint8_t lastStaCount = 255;
@@ -708,14 +1404,42 @@ void loop() {
             }
         }
     }
+}
 
-    if (stateChanged) {
-        sendState();
-    }
+// Network and housekeeping work (low priority, core 0)
+void housekeepingTask(void*) {
+    for (;;) {
+        ws.cleanupClients();
+        if (ledUpdatePending) {
+            ledUpdatePending = false;
+            updateLedState();
+        }
+        statusled::update();
 
-    delay(10);
-}
+        // Update LED when NTP syncs
+        static bool lastNtpState = false;
+        if (dbg::isTimeSynced() && !lastNtpState) {
+            dbg::info(CAT_NTP, "NTP synchronisiert: %s", dbg::getTimestamp().c_str());
+            updateLedState();
+            lastNtpState = true;
+        }
 
+        checkApStations(millis());
 
+        persistCounters(false);
+        xSemaphoreTake(ioLock, portMAX_DELAY);
+        const uint16_t timers = iologic::timerMask();
+        xSemaphoreGive(ioLock);
+        topLedTick(timers, millis());
+        configTick(millis());
+        wifiTick(millis());
 
+        broadcastTick();
+        vTaskDelay(pdMS_TO_TICKS(HK_PERIOD_MS));
+    }
+}
 
+void loop() {
+    // All work runs in the IO scan task and the housekeeping task
+    vTaskDelete(nullptr);
+}
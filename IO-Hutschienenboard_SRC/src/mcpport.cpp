@@ -0,0 +1,219 @@
+#include "mcpport.h"
+#include <Wire.h>
+#include <freertos/semphr.h>
+
+#define MCP_REG_COUNT 0x16
+
+namespace mcpport {
+
+struct Chip {
+    uint8_t  addr;
+    bool     ready;
+    bool     dirty;     // Shadow differs from the chip
+    uint16_t olat;      // Shadow of OLATA (low byte) / OLATB (high byte)
+};
+
+static Chip s_chip[MCP_MAX_CHIPS];
+static TwoWire* s_wire = nullptr;
+static SemaphoreHandle_t s_busLock = nullptr;     // Serializes bus access
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;  // Guards the shadows
+static int s_holdDepth = 0;
+static uint32_t s_tx = 0;
+static uint32_t s_errors = 0;
+
+#if SIMULATE_HW
+static uint8_t s_mockReg[MCP_MAX_CHIPS][MCP_REG_COUNT];
+#endif
+
+// --- Bus access (call with s_busLock held) ---
+
+static bool busWrite(uint8_t chip, uint8_t reg, const uint8_t* data, uint8_t len) {
+    s_tx++;
+#if SIMULATE_HW
+    for (uint8_t i = 0; i < len; i++) {
+        s_mockReg[chip][(reg + i) % MCP_REG_COUNT] = data[i];
+    }
+    return true;
+#else
+    s_wire->beginTransmission(s_chip[chip].addr);
+    s_wire->write(reg);
+    s_wire->write(data, len);
+    if (s_wire->endTransmission() != 0) {
+        s_errors++;
+        return false;
+    }
+    return true;
+#endif
+}
+
+static bool busRead(uint8_t chip, uint8_t reg, uint8_t* data, uint8_t len) {
+    s_tx++;
+#if SIMULATE_HW
+    for (uint8_t i = 0; i < len; i++) {
+        data[i] = s_mockReg[chip][(reg + i) % MCP_REG_COUNT];
+    }
+    return true;
+#else
+    s_wire->beginTransmission(s_chip[chip].addr);
+    s_wire->write(reg);
+    if (s_wire->endTransmission(false) != 0 ||
+        s_wire->requestFrom(s_chip[chip].addr, len) != len) {
+        s_errors++;
+        return false;
+    }
+    for (uint8_t i = 0; i < len; i++) {
+        data[i] = s_wire->read();
+    }
+    return true;
+#endif
+}
+
+bool writeRegs(uint8_t chip, uint8_t reg, const uint8_t* data, uint8_t len) {
+    if (chip >= MCP_MAX_CHIPS || !s_busLock) return false;
+    xSemaphoreTake(s_busLock, portMAX_DELAY);
+    const bool ok = busWrite(chip, reg, data, len);
+    xSemaphoreGive(s_busLock);
+    return ok;
+}
+
+bool readRegs(uint8_t chip, uint8_t reg, uint8_t* data, uint8_t len) {
+    if (chip >= MCP_MAX_CHIPS || !s_busLock) return false;
+    xSemaphoreTake(s_busLock, portMAX_DELAY);
+    const bool ok = busRead(chip, reg, data, len);
+    xSemaphoreGive(s_busLock);
+    return ok;
+}
+
+// --- Init ---
+
+void begin(TwoWire& wire) {
+    s_wire = &wire;
+    if (!s_busLock) s_busLock = xSemaphoreCreateMutex();
+}
+
+bool addOutputChip(uint8_t chip, uint8_t addr) {
+    if (chip >= MCP_MAX_CHIPS) return false;
+    Chip& c = s_chip[chip];
+    c.addr = addr;
+    c.olat = 0;
+    c.dirty = false;
+
+    // IOCON: BANK=0, SEQOP=0 -> register pointer auto-increments A/B
+    const uint8_t iocon = 0x00;
+    const uint8_t zero[2] = {0x00, 0x00};
+    xSemaphoreTake(s_busLock, portMAX_DELAY);
+    c.ready = busWrite(chip, REG_IOCON, &iocon, 1) &&
+              busWrite(chip, REG_OLATA, zero, 2) &&     // Latches low before ...
+              busWrite(chip, REG_IODIRA, zero, 2);      // ... switching to output
+    xSemaphoreGive(s_busLock);
+    return c.ready;
+}
+
+bool addInputChip(uint8_t chip, uint8_t addr, uint16_t mask) {
+    if (chip >= MCP_MAX_CHIPS) return false;
+    Chip& c = s_chip[chip];
+    c.addr = addr;
+    c.olat = 0;
+    c.dirty = false;
+
+    // IOCON: MIRROR (INTA = INTB), ODR (open drain, wired to one GPIO)
+    const uint8_t iocon = 0x44;
+    const uint8_t lo = (uint8_t)(mask & 0xFF);
+    const uint8_t hi = (uint8_t)(mask >> 8);
+    // IODIR, IPOL, GPINTEN, DEFVAL, INTCON (A/B each): one sequential write
+    const uint8_t cfg[10] = {0xFF, 0xFF, lo, hi, lo, hi, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t pullup[2] = {0xFF, 0xFF};
+    uint8_t clear[6];
+    xSemaphoreTake(s_busLock, portMAX_DELAY);
+    c.ready = busWrite(chip, REG_IOCON, &iocon, 1) &&
+              busWrite(chip, REG_IODIRA, cfg, sizeof(cfg)) &&
+              busWrite(chip, REG_GPPUA, pullup, 2) &&
+              busRead(chip, REG_INTFA, clear, sizeof(clear));   // Drop a pending interrupt
+    xSemaphoreGive(s_busLock);
+    return c.ready;
+}
+
+bool ready(uint8_t chip) {
+    return chip < MCP_MAX_CHIPS && s_chip[chip].ready;
+}
+
+// --- Shadow latch ---
+
+void writeMask(uint8_t chip, uint16_t mask, uint16_t bits) {
+    if (chip >= MCP_MAX_CHIPS) return;
+    portENTER_CRITICAL(&s_mux);
+    Chip& c = s_chip[chip];
+    const uint16_t next = (c.olat & ~mask) | (bits & mask);
+    if (next != c.olat) {
+        c.olat = next;
+        c.dirty = true;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void write(uint8_t chip, uint8_t pin, bool level) {
+    const uint16_t bit = (uint16_t)1 << (pin & 0x0F);
+    writeMask(chip, bit, level ? bit : 0);
+}
+
+uint16_t latch(uint8_t chip) {
+    if (chip >= MCP_MAX_CHIPS) return 0;
+    portENTER_CRITICAL(&s_mux);
+    const uint16_t v = s_chip[chip].olat;
+    portEXIT_CRITICAL(&s_mux);
+    return v;
+}
+
+bool flush() {
+    portENTER_CRITICAL(&s_mux);
+    const bool held = s_holdDepth > 0;
+    portEXIT_CRITICAL(&s_mux);
+    if (held || !s_busLock) return true;
+
+    bool ok = true;
+    xSemaphoreTake(s_busLock, portMAX_DELAY);
+    for (uint8_t m = 0; m < MCP_MAX_CHIPS; m++) {
+        // Snapshot inside the bus lock -> writes can never overtake each other
+        portENTER_CRITICAL(&s_mux);
+        const bool dirty = s_chip[m].dirty && s_chip[m].ready;
+        const uint16_t olat = s_chip[m].olat;
+        if (dirty) s_chip[m].dirty = false;
+        portEXIT_CRITICAL(&s_mux);
+        if (!dirty) continue;
+
+        const uint8_t buf[2] = {(uint8_t)(olat & 0xFF), (uint8_t)(olat >> 8)};
+        if (!busWrite(m, REG_OLATA, buf, 2)) {
+            ok = false;
+            portENTER_CRITICAL(&s_mux);
+            s_chip[m].dirty = true;    // Retry with the next flush
+            portEXIT_CRITICAL(&s_mux);
+        }
+    }
+    xSemaphoreGive(s_busLock);
+    return ok;
+}
+
+void hold() {
+    portENTER_CRITICAL(&s_mux);
+    s_holdDepth++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void release() {
+    portENTER_CRITICAL(&s_mux);
+    if (s_holdDepth > 0) s_holdDepth--;
+    portEXIT_CRITICAL(&s_mux);
+    flush();
+}
+
+// --- Statistics ---
+
+uint32_t txCount() {
+    return s_tx;
+}
+
+uint32_t errorCount() {
+    return s_errors;
+}
+
+} // namespace mcpport
@@ -0,0 +1,182 @@
+#include "relaypulse.h"
+#include "pin_config.h"
+#include <esp_timer.h>
+
+// Pulses ending within this window are released together
+#define PULSE_GROUP_US 500
+
+namespace relaypulse {
+
+struct Slot {
+    int64_t deadlineUs;   // End of the running pulse
+    bool    active;       // Pulse running
+    bool    releasing;    // Pulse over, coil is being released
+    bool    on;           // Direction of the running pulse (SET/RESET)
+    bool    queued;       // Another pulse waits behind the running one
+    bool    queuedOn;     // Direction of the queued pulse
+};
+
+static Slot s_slot[NUM_CHANNELS];
+static Stats s_stats = {0, 0, 0, 0};
+static DriveFn s_drive = nullptr;
+static FlushFn s_flush = nullptr;
+static DoneFn s_done = nullptr;
+static int64_t s_pulseUs = 50000;
+static esp_timer_handle_t s_timer = nullptr;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Helpers (call with s_mux held) ---
+
+static void updateDepth() {
+    uint8_t depth = 0;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        depth += (s_slot[i].active || s_slot[i].releasing) + s_slot[i].queued;
+    }
+    s_stats.depth = depth;
+    if (depth > s_stats.maxDepth) s_stats.maxDepth = depth;
+}
+
+static void armTimer(int64_t now) {
+    int64_t next = INT64_MAX;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (s_slot[i].active && s_slot[i].deadlineUs < next) next = s_slot[i].deadlineUs;
+    }
+    esp_timer_stop(s_timer);
+    if (next != INT64_MAX) {
+        esp_timer_start_once(s_timer, next > now ? (uint64_t)(next - now) : 1);
+    }
+}
+
+// --- Timer callback (esp_timer task) ---
+
+static void onTimer(void*) {
+    bool released[NUM_CHANNELS] = {false};
+    bool releasedOn[NUM_CHANNELS] = {false};
+    bool started[NUM_CHANNELS] = {false};
+    bool startedOn[NUM_CHANNELS] = {false};
+
+    // 1) Collect all pulses that are due
+    portENTER_CRITICAL(&s_mux);
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        Slot& s = s_slot[i];
+        if (!s.active || s.deadlineUs > now + PULSE_GROUP_US) continue;
+        s.active = false;
+        s.releasing = true;
+        released[i] = true;
+        releasedOn[i] = s.on;
+        s_stats.pulses++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    // 2) Release the coils, commit the new relay states
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (released[i]) s_drive(i, releasedOn[i], false);
+    }
+    s_flush();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (released[i]) s_done(i, releasedOn[i]);
+    }
+
+    // 3) Start pulses that were queued behind the released ones
+    portENTER_CRITICAL(&s_mux);
+    now = esp_timer_get_time();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        Slot& s = s_slot[i];
+        if (!released[i]) continue;
+        s.releasing = false;
+        if (s.queued && s.queuedOn != releasedOn[i]) {
+            s.active = true;
+            s.on = s.queuedOn;
+            s.deadlineUs = now + s_pulseUs;
+            started[i] = true;
+            startedOn[i] = s.on;
+        }
+        s.queued = false;
+    }
+    updateDepth();
+    armTimer(now);
+    portEXIT_CRITICAL(&s_mux);
+
+    bool anyStarted = false;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (started[i]) {
+            s_drive(i, startedOn[i], true);
+            anyStarted = true;
+        }
+    }
+    if (anyStarted) s_flush();
+}
+
+// --- Init ---
+
+void begin(DriveFn drive, FlushFn flush, DoneFn done, uint16_t pulseMs) {
+    s_drive = drive;
+    s_flush = flush;
+    s_done = done;
+    s_pulseUs = (int64_t)pulseMs * 1000;
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.name = "relaypulse";
+    esp_timer_create(&args, &s_timer);
+}
+
+// --- Requests ---
+
+void request(uint8_t ch, bool on) {
+    if (ch >= NUM_CHANNELS || !s_timer) return;
+    bool start = false;
+
+    portENTER_CRITICAL(&s_mux);
+    Slot& s = s_slot[ch];
+    if (!s.active && !s.releasing) {
+        s.active = true;
+        s.on = on;
+        const int64_t now = esp_timer_get_time();
+        s.deadlineUs = now + s_pulseUs;
+        start = true;
+        armTimer(now);
+    } else if (s.queued) {
+        // Only the newest request matters
+        if (s.queuedOn != on) s_stats.overruns++;
+        s.queuedOn = on;
+    } else if (s.on != on) {
+        s.queued = true;
+        s.queuedOn = on;
+    }
+    updateDepth();
+    portEXIT_CRITICAL(&s_mux);
+
+    if (start) {
+        s_drive(ch, on, true);
+        s_flush();
+    }
+}
+
+bool busy(uint8_t ch) {
+    if (ch >= NUM_CHANNELS) return false;
+    portENTER_CRITICAL(&s_mux);
+    const bool b = s_slot[ch].active || s_slot[ch].releasing || s_slot[ch].queued;
+    portEXIT_CRITICAL(&s_mux);
+    return b;
+}
+
+bool target(uint8_t ch, bool current) {
+    if (ch >= NUM_CHANNELS) return current;
+    portENTER_CRITICAL(&s_mux);
+    const Slot& s = s_slot[ch];
+    if (s.queued) current = s.queuedOn;
+    else if (s.active || s.releasing) current = s.on;
+    portEXIT_CRITICAL(&s_mux);
+    return current;
+}
+
+Stats getStats() {
+    portENTER_CRITICAL(&s_mux);
+    Stats st = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+    return st;
+}
+
+} // namespace relaypulse
@@ -0,0 +1,215 @@
+#include "rules.h"
+#include <string.h>
+#include <ctype.h>
+
+namespace rules {
+
+// --- Parser state ---
+
+struct Parser {
+    const char* p;
+    const char* err;        // First error wins
+    const char* errAt;
+};
+
+static bool fail(Parser& ps, const char* msg) {
+    if (!ps.err) {
+        ps.err = msg;
+        ps.errAt = ps.p;
+    }
+    return false;
+}
+
+// Blanks and comments, not the newline (it ends a rule)
+static void skipSpace(Parser& ps) {
+    while (*ps.p == ' ' || *ps.p == '\t' || *ps.p == '\r') ps.p++;
+    if (*ps.p == '#') {
+        while (*ps.p && *ps.p != '\n') ps.p++;
+    }
+}
+
+static bool atEnd(Parser& ps) {
+    skipSpace(ps);
+    return *ps.p == '\0' || *ps.p == '\n' || *ps.p == ';';
+}
+
+// Symbol ("->", "|", ...) or keyword (case-insensitive, whole word)
+static bool accept(Parser& ps, const char* tok) {
+    skipSpace(ps);
+    const size_t n = strlen(tok);
+    for (size_t k = 0; k < n; k++) {
+        if (tolower((unsigned char)ps.p[k]) != tok[k]) return false;
+    }
+    if (isalpha((unsigned char)tok[0]) && isalnum((unsigned char)ps.p[n])) return false;
+    ps.p += n;
+    return true;
+}
+
+// 'E' = input, 'A' = output, followed by the 1-based channel
+static bool peekChannel(Parser& ps, char kind) {
+    skipSpace(ps);
+    return toupper((unsigned char)ps.p[0]) == kind && isdigit((unsigned char)ps.p[1]);
+}
+
+static bool number(Parser& ps, uint32_t max, uint32_t& v) {
+    skipSpace(ps);
+    if (!isdigit((unsigned char)*ps.p)) return false;
+    v = 0;
+    while (isdigit((unsigned char)*ps.p)) {
+        v = v * 10 + (uint32_t)(*ps.p - '0');
+        if (v > max) return false;
+        ps.p++;
+    }
+    return true;
+}
+
+static bool channel(Parser& ps, char kind, uint8_t& ch) {
+    if (!peekChannel(ps, kind)) {
+        return fail(ps, kind == 'E' ? "Eingang erwartet (E1..E12)" : "Ausgang erwartet (A1..A12)");
+    }
+    ps.p++;
+    uint32_t n = 0;
+    if (!number(ps, 255, n) || n < 1 || n > NUM_CHANNELS) return fail(ps, "Kanal ausserhalb 1..12");
+    ch = (uint8_t)(n - 1);
+    return true;
+}
+
+// Ch or range (A1-A4, A1-4)
+static bool channelItem(Parser& ps, char kind, Mask& m) {
+    uint8_t first = 0;
+    if (!channel(ps, kind, first)) return false;
+    uint8_t last = first;
+    skipSpace(ps);
+    if (ps.p[0] == '-' && ps.p[1] != '>') {
+        ps.p++;
+        skipSpace(ps);
+        if (toupper((unsigned char)*ps.p) == kind) ps.p++;
+        uint32_t n = 0;
+        if (!number(ps, 255, n) || n < 1 || n > NUM_CHANNELS) return fail(ps, "Kanal ausserhalb 1..12");
+        last = (uint8_t)(n - 1);
+        if (last < first) return fail(ps, "Bereich absteigend");
+    }
+    for (uint8_t ch = first; ch <= last; ch++) m |= (Mask)(1u << ch);
+    return true;
+}
+
+static bool outList(Parser& ps, Mask& m) {
+    if (!channelItem(ps, 'A', m)) return false;
+    while (peekChannel(ps, 'A')) {
+        if (!channelItem(ps, 'A', m)) return false;
+    }
+    return true;
+}
+
+// E1 & !E2 & ...  or  E1 | E2 | ...
+static bool condition(Parser& ps, Row& r) {
+    char op = 0;
+    for (;;) {
+        const bool neg = accept(ps, "!");
+        Mask m = 0;
+        if (!channelItem(ps, 'E', m)) return false;
+        if (op == '|' && neg) return fail(ps, "'!' nur in UND-Bedingungen");
+        if (neg) r.inNone |= m;
+        else r.inAll |= m;
+
+        char next = 0;
+        if (accept(ps, "&")) next = '&';
+        else if (accept(ps, "|")) next = '|';
+        else break;
+        if (op && next != op) return fail(ps, "'&' und '|' gemischt");
+        if (next == '|' && r.inNone) return fail(ps, "'!' nur in UND-Bedingungen");
+        op = next;
+    }
+    if (op == '|') {
+        r.inAny = r.inAll;      // OR form: any of them
+        r.inAll = 0;
+    }
+    return true;
+}
+
+static bool action(Parser& ps, Row& r, Program& p) {
+    if (accept(ps, "toggle")) return outList(ps, r.tog);
+    if (accept(ps, "on")) return outList(ps, r.set);
+    if (accept(ps, "off")) return outList(ps, r.clr);
+    if (accept(ps, "stair")) {
+        uint32_t secs = 0;
+        if (!number(ps, 65535, secs) || secs == 0) return fail(ps, "Sekunden erwartet (1..65535)");
+        Mask m = 0;
+        if (!outList(ps, m)) return false;
+        r.stair |= m;
+        for (uint8_t ch = 0; ch < NUM_CHANNELS; ch++) {
+            if (m & (1u << ch)) p.stairSecs[ch] = (uint16_t)secs;
+        }
+        return true;
+    }
+    return fail(ps, "Aktion erwartet (toggle, on, off, stair)");
+}
+
+// "if" / "unless" tail of a rule
+static bool guards(Parser& ps, Row& r, bool allowIf) {
+    if (allowIf && accept(ps, "if") && !condition(ps, r)) return false;
+    if (accept(ps, "unless") && !outList(ps, r.outNone)) return false;
+    return true;
+}
+
+// E1 | E2 -> action, action [if cond] [unless outs]
+static bool edgeRule(Parser& ps, Row& r, Program& p) {
+    do {
+        if (!channelItem(ps, 'E', r.trig)) return false;
+    } while (accept(ps, "|"));
+    if (!accept(ps, "->")) return fail(ps, "'->' erwartet");
+    do {
+        if (!action(ps, r, p)) return false;
+    } while (accept(ps, ","));
+    return guards(ps, r, true);
+}
+
+// A1 A2 = cond [unless outs]
+static bool levelRule(Parser& ps, Row& r) {
+    if (!outList(ps, r.follow)) return false;
+    if (!accept(ps, "=")) return fail(ps, "'=' erwartet");
+    if (!condition(ps, r)) return false;
+    return guards(ps, r, false);
+}
+
+bool compile(const char* text, Program& p, Error* err) {
+    memset(&p, 0, sizeof(p));
+    const char* src = text ? text : "";
+    Parser ps = {src, nullptr, nullptr};
+    if (strlen(ps.p) >= RULES_TEXT_MAX) {
+        fail(ps, "Regeltext zu lang");
+    }
+
+    while (!ps.err) {
+        if (atEnd(ps)) {
+            if (*ps.p == '\0') break;
+            ps.p++;     // Empty rule
+            continue;
+        }
+        if (p.rows >= RULES_MAX) {
+            fail(ps, "Zu viele Regeln (max 24)");
+            break;
+        }
+        Row& r = p.row[p.rows];
+        memset(&r, 0, sizeof(r));
+        const bool ok = peekChannel(ps, 'A') ? levelRule(ps, r) : edgeRule(ps, r, p);
+        if (!ok) break;
+        if (!atEnd(ps)) {
+            fail(ps, "Ende der Regel erwartet");
+            break;
+        }
+        p.rows++;
+    }
+
+    if (ps.err) {
+        if (err) {
+            err->pos = (uint16_t)(ps.errAt - src);
+            err->msg = ps.err;
+        }
+        memset(&p, 0, sizeof(p));
+        return false;
+    }
+    return true;
+}
+
+} // namespace rules
@@ -0,0 +1,250 @@
+#include "s0counter.h"
+#include "inputcap.h"
+#include <Preferences.h>
+#if !SIMULATE_HW
+#include <driver/pcnt.h>
+#include <driver/gpio.h>
+#endif
+
+// PCNT counts 0..S0_PCNT_LIMIT-1 and wraps to 0 at the limit.
+// At 20 impulses/s this is >25 min between two polls.
+#define S0_PCNT_LIMIT   32767
+// Glitch filter in APB cycles (80 MHz): 1000 = 12.5 us
+#define S0_PCNT_FILTER  1000
+// Power decay is re-evaluated at most this often without impulses
+#define S0_DECAY_US     1000000LL
+
+namespace s0counter {
+
+struct Channel {
+    uint64_t total;
+    uint64_t persisted;     // Value last written to NVS
+    int64_t  lastPulseUs;   // 0 = no impulse seen yet
+    int64_t  periodUs;      // Last impulse interval, 0 = unknown
+    int64_t  evalUs;        // Last power evaluation
+    uint32_t power;
+    uint16_t imp;
+    int16_t  lastCount;     // Last PCNT reading
+    int8_t   unit;          // PCNT unit, -1 = edge fallback
+    bool     enabled;
+};
+
+static Channel s_ch[NUM_CHANNELS];
+static bool s_unitUsed[S0_PCNT_UNITS] = {false};
+static uint32_t s_lastPersistMs = 0;
+
+// --- PCNT ---
+
+#if !SIMULATE_HW
+static int16_t readUnit(int8_t unit) {
+    int16_t v = 0;
+    pcnt_get_counter_value((pcnt_unit_t)unit, &v);
+    return v;
+}
+
+static bool attachUnit(uint8_t ch, int8_t unit) {
+    pcnt_config_t cfg = {};
+    cfg.pulse_gpio_num = INPUT_PINS[ch];
+    cfg.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    cfg.lctrl_mode = PCNT_MODE_KEEP;
+    cfg.hctrl_mode = PCNT_MODE_KEEP;
+    cfg.pos_mode = PCNT_COUNT_INC;      // Rising edge = impulse
+    cfg.neg_mode = PCNT_COUNT_DIS;
+    cfg.counter_h_lim = S0_PCNT_LIMIT;
+    cfg.counter_l_lim = 0;
+    cfg.unit = (pcnt_unit_t)unit;
+    cfg.channel = PCNT_CHANNEL_0;
+    if (pcnt_unit_config(&cfg) != ESP_OK) return false;
+
+    // pcnt_unit_config() enables the pull-up, the inputs are driven externally
+    gpio_set_pull_mode((gpio_num_t)INPUT_PINS[ch], GPIO_FLOATING);
+    pcnt_set_filter_value((pcnt_unit_t)unit, S0_PCNT_FILTER);
+    pcnt_filter_enable((pcnt_unit_t)unit);
+    pcnt_counter_pause((pcnt_unit_t)unit);
+    pcnt_counter_clear((pcnt_unit_t)unit);
+    pcnt_counter_resume((pcnt_unit_t)unit);
+    return true;
+}
+
+static void detachUnit(int8_t unit) {
+    pcnt_counter_pause((pcnt_unit_t)unit);
+    pcnt_set_pin((pcnt_unit_t)unit, PCNT_CHANNEL_0, PCNT_PIN_NOT_USED, PCNT_PIN_NOT_USED);
+}
+#endif
+
+// --- Rate ---
+
+static uint32_t wattsFor(int64_t periodUs, uint16_t imp) {
+    if (periodUs <= 0 || imp == 0) return 0;
+    return (uint32_t)(3600000000000ULL / ((uint64_t)periodUs * imp));
+}
+
+// n impulses arrived, the last one at tsUs
+static void addPulses(Channel& c, uint32_t n, int64_t tsUs) {
+    c.total += n;
+    if (c.lastPulseUs > 0) c.periodUs = (tsUs - c.lastPulseUs) / n;
+    c.lastPulseUs = tsUs;
+    c.evalUs = 0;           // Force power update in the next poll
+}
+
+// Power from the last interval, or less if the next impulse is overdue
+static bool updatePower(Channel& c, int64_t nowUs) {
+    if (c.evalUs && nowUs - c.evalUs < S0_DECAY_US) return false;
+    c.evalUs = nowUs;
+    int64_t period = c.periodUs;
+    if (c.lastPulseUs > 0 && nowUs - c.lastPulseUs > period) period = nowUs - c.lastPulseUs;
+    const uint32_t w = c.periodUs ? wattsFor(period, c.imp) : 0;
+    if (w == c.power) return false;
+    c.power = w;
+    return true;
+}
+
+// --- Init / configuration ---
+
+void begin() {
+    Preferences prefs;
+    prefs.begin("s0-count", true);
+    char key[8];
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        Channel& c = s_ch[i];
+        snprintf(key, sizeof(key), "tot%u", (unsigned)i);
+        c.total = prefs.getULong64(key, 0);
+        c.persisted = c.total;
+        c.imp = IMP_DEFAULT;
+        c.unit = -1;
+    }
+    prefs.end();
+    s_lastPersistMs = millis();
+}
+
+bool configure(uint8_t ch, bool enable, uint16_t impPerKwh) {
+    if (ch >= NUM_CHANNELS) return false;
+    Channel& c = s_ch[ch];
+    c.imp = impPerKwh ? impPerKwh : IMP_DEFAULT;
+    c.evalUs = 0;
+    if (enable == c.enabled) return c.unit >= 0;
+
+    if (!enable) {
+#if !SIMULATE_HW
+        if (c.unit >= 0) {
+            // Fold in what the unit counted since the last poll
+            const int16_t v = readUnit(c.unit);
+            c.total += (uint32_t)((v - c.lastCount + S0_PCNT_LIMIT) % S0_PCNT_LIMIT);
+            detachUnit(c.unit);
+            s_unitUsed[c.unit] = false;
+            inputcap::setIsrEnabled(ch, true);
+        }
+#endif
+        c.unit = -1;
+        c.enabled = false;
+        c.power = 0;
+        c.periodUs = 0;
+        c.lastPulseUs = 0;
+        return false;
+    }
+
+    c.enabled = true;
+    c.unit = -1;
+#if !SIMULATE_HW
+    for (int8_t u = 0; u < S0_PCNT_UNITS; u++) {
+        if (s_unitUsed[u]) continue;
+        if (!attachUnit(ch, u)) break;
+        s_unitUsed[u] = true;
+        c.unit = u;
+        c.lastCount = 0;
+        inputcap::setIsrEnabled(ch, false);    // Hardware counts, no CPU per impulse
+        break;
+    }
+#endif
+    return c.unit >= 0;
+}
+
+bool enabled(uint8_t ch) {
+    return ch < NUM_CHANNELS && s_ch[ch].enabled;
+}
+
+bool hardware(uint8_t ch) {
+    return ch < NUM_CHANNELS && s_ch[ch].unit >= 0;
+}
+
+uint16_t impPerKwh(uint8_t ch) {
+    return ch < NUM_CHANNELS ? s_ch[ch].imp : IMP_DEFAULT;
+}
+
+// --- Counting ---
+
+void onEdge(uint8_t ch, bool level, int64_t tsUs) {
+    if (ch >= NUM_CHANNELS) return;
+    Channel& c = s_ch[ch];
+    if (!c.enabled || c.unit >= 0 || !level) return;
+    addPulses(c, 1, tsUs);
+}
+
+bool poll(int64_t nowUs) {
+    bool changed = false;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        Channel& c = s_ch[i];
+        if (!c.enabled) continue;
+#if !SIMULATE_HW
+        if (c.unit >= 0) {
+            const int16_t v = readUnit(c.unit);
+            const uint32_t n = (uint32_t)((v - c.lastCount + S0_PCNT_LIMIT) % S0_PCNT_LIMIT);
+            if (n) {
+                c.lastCount = v;
+                addPulses(c, n, nowUs);   // Poll time stands in for the impulse time
+                changed = true;
+            }
+        }
+#endif
+        if (c.evalUs == 0) changed = true;    // New impulses on the edge path
+        if (updatePower(c, nowUs)) changed = true;
+    }
+    return changed;
+}
+
+uint64_t total(uint8_t ch) {
+    return ch < NUM_CHANNELS ? s_ch[ch].total : 0;
+}
+
+uint32_t powerW(uint8_t ch) {
+    return ch < NUM_CHANNELS ? s_ch[ch].power : 0;
+}
+
+// --- Persistence ---
+
+bool takeChanged(Pending& p, bool force) {
+    p.mask = 0;
+    if (!force && millis() - s_lastPersistMs < S0_PERSIST_MS) return false;
+    s_lastPersistMs = millis();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        Channel& c = s_ch[i];
+        if (c.total == c.persisted) continue;
+        p.total[i] = c.total;
+        p.mask |= (uint16_t)(1 << i);
+        c.persisted = c.total;      // Taken back by writeFailed()
+    }
+    return p.mask != 0;
+}
+
+bool write(const Pending& p) {
+    Preferences prefs;
+    if (!prefs.begin("s0-count", false)) return false;
+    char key[8];
+    bool ok = true;
+    for (uint16_t m = p.mask; m; m &= (uint16_t)(m - 1)) {
+        const uint8_t i = (uint8_t)__builtin_ctz(m);
+        snprintf(key, sizeof(key), "tot%u", (unsigned)i);
+        if (prefs.putULong64(key, p.total[i]) != sizeof(uint64_t)) ok = false;
+    }
+    prefs.end();
+    return ok;
+}
+
+void writeFailed(const Pending& p) {
+    for (uint16_t m = p.mask; m; m &= (uint16_t)(m - 1)) {
+        const uint8_t i = (uint8_t)__builtin_ctz(m);
+        s_ch[i].persisted = ~p.total[i];       // Differs from the total: written next time
+    }
+}
+
+} // namespace s0counter
@@ -0,0 +1,66 @@
+#include "scantask.h"
+#include <esp_timer.h>
+
+namespace scantask {
+
+static CycleFn s_fn = nullptr;
+static TickType_t s_periodTicks = 1;
+static Stats s_stats = {};
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void taskMain(void*) {
+    const int64_t periodUs = s_stats.periodUs;
+    TickType_t wake = xTaskGetTickCount();
+    int64_t due = esp_timer_get_time();
+
+    for (;;) {
+        const int64_t start = esp_timer_get_time();
+        s_fn();
+        const int64_t end = esp_timer_get_time();
+
+        const uint32_t exec = (uint32_t)(end - start);
+        const int64_t dev = start - due;
+        const uint32_t jitter = (uint32_t)(dev < 0 ? -dev : dev);
+
+        portENTER_CRITICAL(&s_mux);
+        s_stats.cycles++;
+        s_stats.lastUs = exec;
+        s_stats.avgUs = s_stats.avgUs ? s_stats.avgUs + ((int32_t)exec - (int32_t)s_stats.avgUs) / 16 : exec;
+        if (exec > s_stats.maxUs) s_stats.maxUs = exec;
+        if (jitter > s_stats.jitterMaxUs) s_stats.jitterMaxUs = jitter;
+        if (exec > periodUs) s_stats.overruns++;
+        portEXIT_CRITICAL(&s_mux);
+
+        due += periodUs;
+        if (xTaskDelayUntil(&wake, s_periodTicks) == pdFALSE) {
+            // Deadline already passed -> re-base, no catch-up burst
+            wake = xTaskGetTickCount();
+            due = esp_timer_get_time();
+        }
+    }
+}
+
+bool begin(CycleFn fn, uint32_t periodMs, BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+    if (!fn || s_fn) return false;
+    s_fn = fn;
+    s_periodTicks = pdMS_TO_TICKS(periodMs);
+    if (s_periodTicks == 0) s_periodTicks = 1;
+    s_stats.periodUs = (uint32_t)s_periodTicks * portTICK_PERIOD_MS * 1000;
+    return xTaskCreatePinnedToCore(taskMain, "io_scan", stackSize, nullptr, priority, nullptr, core) == pdPASS;
+}
+
+Stats getStats() {
+    portENTER_CRITICAL(&s_mux);
+    Stats st = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+    return st;
+}
+
+void resetMax() {
+    portENTER_CRITICAL(&s_mux);
+    s_stats.maxUs = 0;
+    s_stats.jitterMaxUs = 0;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+} // namespace scantask
@@ -0,0 +1,359 @@
+#include "stateproto.h"
+#include <string.h>
+
+namespace stateproto {
+
+static inline bool bit(uint16_t mask, uint8_t i) {
+    return (mask >> i) & 1;
+}
+
+// ============================================================
+// JsonWriter
+// ============================================================
+
+JsonWriter::JsonWriter(char* buf, size_t cap)
+    : m_buf(buf), m_cap(cap), m_len(0), m_ok(cap > 0),
+      m_afterKey(false), m_depth(0), m_needComma(0) {
+    if (cap) buf[0] = '\0';
+}
+
+void JsonWriter::put(char c) {
+    if (m_len + 1 >= m_cap) {
+        m_ok = false;
+        return;
+    }
+    m_buf[m_len++] = c;
+    m_buf[m_len] = '\0';
+}
+
+void JsonWriter::putRaw(const char* s) {
+    while (*s) put(*s++);
+}
+
+// Comma before every member/element but the first of a level
+void JsonWriter::sep() {
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+    const uint16_t b = (uint16_t)(1 << m_depth);
+    if (m_needComma & b) put(',');
+    m_needComma |= b;
+}
+
+void JsonWriter::beginObject() {
+    sep();
+    put('{');
+    m_depth++;
+    m_needComma &= ~(uint16_t)(1 << m_depth);
+}
+
+void JsonWriter::endObject() {
+    if (m_depth) m_depth--;
+    put('}');
+}
+
+void JsonWriter::beginArray() {
+    sep();
+    put('[');
+    m_depth++;
+    m_needComma &= ~(uint16_t)(1 << m_depth);
+}
+
+void JsonWriter::endArray() {
+    if (m_depth) m_depth--;
+    put(']');
+}
+
+void JsonWriter::key(const char* k) {
+    sep();
+    put('"');
+    putRaw(k);
+    put('"');
+    put(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::addBool(bool v) {
+    sep();
+    putRaw(v ? "true" : "false");
+}
+
+void JsonWriter::addUint(uint32_t v) {
+    addUint64(v);
+}
+
+void JsonWriter::addUint64(uint64_t v) {
+    sep();
+    char tmp[20];
+    uint8_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) put(tmp[--n]);
+}
+
+void JsonWriter::addInt(int32_t v) {
+    if (v >= 0) {
+        addUint((uint32_t)v);
+        return;
+    }
+    sep();
+    put('-');
+    m_afterKey = true;      // Digits follow without separator
+    addUint((uint32_t)(-(int64_t)v));
+}
+
+void JsonWriter::addStr(const char* s) {
+    static const char HEX[] = "0123456789abcdef";
+    sep();
+    put('"');
+    for (; *s; s++) {
+        const unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            put('\\');
+            put((char)c);
+        } else if (c < 0x20) {
+            putRaw("\\u00");
+            put(HEX[c >> 4]);
+            put(HEX[c & 0x0F]);
+        } else {
+            put((char)c);
+        }
+    }
+    put('"');
+}
+
+// ============================================================
+// Snapshot diff / serialization
+// ============================================================
+
+// Channels where remaining must be re-sent (output or timer changed)
+static uint16_t remainingMask(const Snapshot& prev, const Snapshot& cur) {
+    uint16_t m = prev.outputs ^ cur.outputs;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        if (prev.timers[i] != cur.timers[i]) m |= (uint16_t)(1 << i);
+    }
+    return m;
+}
+
+uint16_t diff(const Snapshot& prev, const Snapshot& cur) {
+    uint16_t f = 0;
+    if (prev.inputs != cur.inputs) f |= F_INPUTS;
+    if (prev.outputs != cur.outputs) f |= F_OUTPUTS;
+    if (memcmp(prev.mappings, cur.mappings, sizeof(cur.mappings)) != 0) f |= F_MAPPINGS;
+    if (memcmp(prev.timers, cur.timers, sizeof(cur.timers)) != 0) f |= F_TIMERS;
+    if (remainingMask(prev, cur)) f |= F_REMAINING;
+    if (prev.mcp != cur.mcp) f |= F_MCP;
+    if (prev.ntp != cur.ntp) f |= F_NTP;
+    if (memcmp(prev.inModes, cur.inModes, sizeof(cur.inModes)) != 0 ||
+        memcmp(prev.inFilterMs, cur.inFilterMs, sizeof(cur.inFilterMs)) != 0) f |= F_INCONFIG;
+    if (memcmp(prev.counts, cur.counts, sizeof(cur.counts)) != 0 ||
+        memcmp(prev.power, cur.power, sizeof(cur.power)) != 0 ||
+        memcmp(prev.s0Imp, cur.s0Imp, sizeof(cur.s0Imp)) != 0) f |= F_COUNTERS;
+    return f;
+}
+
+static void writeMcp(JsonWriter& w, uint8_t mcp) {
+    w.key("mcp");
+    w.beginArray();
+    w.addBool(bit(mcp, 0));
+    w.addBool(bit(mcp, 1));
+    w.endArray();
+}
+
+void writeFull(JsonWriter& w, const Snapshot& s, uint32_t seq) {
+    w.key("seq");
+    w.addUint(seq);
+    w.key("full");
+    w.addBool(true);
+
+    w.key("inputs");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addBool(bit(s.inputs, i));
+    w.endArray();
+
+    w.key("outputs");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addBool(bit(s.outputs, i));
+    w.endArray();
+
+    w.key("mappings");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addInt(s.mappings[i]);
+    w.endArray();
+
+    w.key("timers");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint(s.timers[i]);
+    w.endArray();
+
+    w.key("remaining");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint(s.remaining[i]);
+    w.endArray();
+
+    w.key("inmodes");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint(s.inModes[i]);
+    w.endArray();
+
+    w.key("infilter");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint(s.inFilterMs[i]);
+    w.endArray();
+
+    w.key("counts");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint64(s.counts[i]);
+    w.endArray();
+
+    w.key("power");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint(s.power[i]);
+    w.endArray();
+
+    w.key("s0imp");
+    w.beginArray();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) w.addUint(s.s0Imp[i]);
+    w.endArray();
+
+    writeMcp(w, s.mcp);
+    w.key("time");
+    w.addStr(s.time);
+    w.key("ntp");
+    w.addBool(s.ntp);
+}
+
+// Channel index as object key
+static void chKey(JsonWriter& w, uint8_t i) {
+    char k[3];
+    if (i < 10) {
+        k[0] = (char)('0' + i);
+        k[1] = '\0';
+    } else {
+        k[0] = (char)('0' + i / 10);
+        k[1] = (char)('0' + i % 10);
+        k[2] = '\0';
+    }
+    w.key(k);
+}
+
+bool writeDelta(JsonWriter& w, const Snapshot& prev, const Snapshot& cur, uint32_t seq) {
+    const uint16_t f = diff(prev, cur);
+    if (!f) return false;
+
+    w.key("seq");
+    w.addUint(seq);
+
+    if (f & F_INPUTS) {
+        const uint16_t changed = prev.inputs ^ cur.inputs;
+        w.key("inputs");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (!bit(changed, i)) continue;
+            chKey(w, i);
+            w.addBool(bit(cur.inputs, i));
+        }
+        w.endObject();
+    }
+    if (f & F_OUTPUTS) {
+        const uint16_t changed = prev.outputs ^ cur.outputs;
+        w.key("outputs");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (!bit(changed, i)) continue;
+            chKey(w, i);
+            w.addBool(bit(cur.outputs, i));
+        }
+        w.endObject();
+    }
+    if (f & F_MAPPINGS) {
+        w.key("mappings");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.mappings[i] == cur.mappings[i]) continue;
+            chKey(w, i);
+            w.addInt(cur.mappings[i]);
+        }
+        w.endObject();
+    }
+    if (f & F_TIMERS) {
+        w.key("timers");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.timers[i] == cur.timers[i]) continue;
+            chKey(w, i);
+            w.addUint(cur.timers[i]);
+        }
+        w.endObject();
+    }
+    if (f & F_REMAINING) {
+        const uint16_t changed = remainingMask(prev, cur);
+        w.key("remaining");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (!bit(changed, i)) continue;
+            chKey(w, i);
+            w.addUint(cur.remaining[i]);
+        }
+        w.endObject();
+    }
+    if (f & F_INCONFIG) {
+        w.key("inmodes");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.inModes[i] == cur.inModes[i]) continue;
+            chKey(w, i);
+            w.addUint(cur.inModes[i]);
+        }
+        w.endObject();
+        w.key("infilter");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.inFilterMs[i] == cur.inFilterMs[i]) continue;
+            chKey(w, i);
+            w.addUint(cur.inFilterMs[i]);
+        }
+        w.endObject();
+    }
+    if (f & F_COUNTERS) {
+        w.key("counts");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.counts[i] == cur.counts[i]) continue;
+            chKey(w, i);
+            w.addUint64(cur.counts[i]);
+        }
+        w.endObject();
+        w.key("power");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.power[i] == cur.power[i]) continue;
+            chKey(w, i);
+            w.addUint(cur.power[i]);
+        }
+        w.endObject();
+        w.key("s0imp");
+        w.beginObject();
+        for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+            if (prev.s0Imp[i] == cur.s0Imp[i]) continue;
+            chKey(w, i);
+            w.addUint(cur.s0Imp[i]);
+        }
+        w.endObject();
+    }
+    if (f & F_MCP) {
+        writeMcp(w, cur.mcp);
+    }
+    if (f & F_NTP) {
+        w.key("ntp");
+        w.addBool(cur.ntp);
+        w.key("time");
+        w.addStr(cur.time);
+    }
+    return true;
+}
+
+} // namespace stateproto
@@ -3,6 +3,8 @@
 #include <time.h>
 #include <sys/time.h>
 #include "esp_sntp.h"
+#include <esp_heap_caps.h>
+#include "ringbuf.h"
 
 // Debug output goes to Serial0 = CH343 COM port (UART0, GPIO43/44)
 // With ARDUINO_USB_CDC_ON_BOOT=1, Serial = USB-CDC, Serial0 = UART0
@@ -12,17 +14,47 @@
 #define DBG_TX_PIN 43
 #define DBG_RX_PIN 44
 #define DBG_BUFSIZE 256
+#define DBG_RING_SIZE 128       // Queued lines (~35 KB, PSRAM if available)
+#define DBG_TASK_PRIO 1
+#define DBG_TASK_CORE 0
+#define DBG_IDLE_MS   5         // Drain task poll period when the ring is empty
+
+#if DBG_TOKENIZED
+#define DBG_PAYLOAD DBG_TOK_ARGS_MAX
+#else
+#define DBG_PAYLOAD DBG_BUFSIZE
+#endif
 
 namespace dbg {
 
-static Level s_minLevel = LVL_DEBUG;
-static uint16_t s_catMask = CAT_ALL;
+Level g_minLevel = LVL_DEBUG;
+uint16_t g_catMask = CAT_ALL;
 static bool s_initialized = false;
 static bool s_timeSynced = false;
 
+// One queued log line; timestamp taken at the call. Text records carry
+// the formatted message, tokenized ones (fmt != nullptr) packed args.
+struct Record {
+    struct timeval tv;
+    uint32_t    ms;
+    const char* fmt;
+    Level       lvl;
+    Category    cat;
+    uint8_t     len;
+    bool        truncated;      // Tokenized: trailing arguments dropped
+    char        msg[DBG_PAYLOAD];
+};
+
+static MpmcRing<Record, DBG_RING_SIZE> s_ring;
+static std::atomic<uint32_t> s_queued{0};
+static std::atomic<uint32_t> s_dropped{0};
+static uint32_t s_avgCycles = 0;
+static uint32_t s_maxCycles = 0;
+static portMUX_TYPE s_statMux = portMUX_INITIALIZER_UNLOCKED;
+
 // --- Level helpers ---
 
-static const char* levelStr(Level lvl) {
+const char* levelName(Level lvl) {
     switch (lvl) {
         case LVL_DEBUG: return "DBG";
         case LVL_INFO:  return "INF";
@@ -61,12 +93,20 @@ const char* catName(Category cat) {
 
 // --- Init ---
 
+static void drainTask(void*);
+
 void begin(Level minLevel, uint16_t enabledCategories) {
-    s_minLevel = minLevel;
-    s_catMask = enabledCategories;
+    g_minLevel = minLevel;
+    g_catMask = enabledCategories;
     if (!s_initialized) {
         DBG_SERIAL.begin(DBG_BAUD, SERIAL_8N1, DBG_RX_PIN, DBG_TX_PIN);
-        s_initialized = true;
+
+        void* buf = heap_caps_malloc(DBG_RING_SIZE * sizeof(Record), MALLOC_CAP_SPIRAM);
+        if (!buf) buf = heap_caps_malloc(DBG_RING_SIZE * sizeof(Record), MALLOC_CAP_8BIT);
+        s_ring.attach((Record*)buf);
+        xTaskCreatePinnedToCore(drainTask, "log", 4096, nullptr, DBG_TASK_PRIO, nullptr, DBG_TASK_CORE);
+
+        s_initialized = s_ring.ready();
         delay(100);
     }
 }
@@ -75,26 +115,26 @@ void begin(Level minLevel, uint16_t enabledCategories) {
 
 void catEnable(Category cat, bool enable) {
     if (enable) {
-        s_catMask |= (uint16_t)cat;
+        g_catMask |= (uint16_t)cat;
     } else {
-        s_catMask &= ~(uint16_t)cat;
+        g_catMask &= ~(uint16_t)cat;
     }
 }
 
 void catSet(uint16_t mask) {
-    s_catMask = mask;
+    g_catMask = mask;
 }
 
 uint16_t catGet() {
-    return s_catMask;
+    return g_catMask;
 }
 
 void enableAll() {
-    s_catMask = CAT_ALL;
+    g_catMask = CAT_ALL;
 }
 
 void disableAll() {
-    s_catMask = 0;
+    g_catMask = 0;
 }
 
 // --- NTP ---
@@ -115,77 +155,138 @@ bool isTimeSynced() {
 
 // --- Timestamp ---
 
-String getTimestamp() {
+// Wall clock once it is set (same check as getLocalTime), else uptime
+void formatTime(char* buf, size_t len, time_t sec, uint32_t ms) {
     struct tm ti;
-    if (getLocalTime(&ti, 0)) {
-        char buf[24];
-        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &ti);
-        return String(buf);
+    if (sec >= 1483228800) {   // 2017-01-01
+        localtime_r(&sec, &ti);
+        strftime(buf, len, "%Y-%m-%d %H:%M:%S", &ti);
+        return;
     }
-    unsigned long ms = millis();
-    unsigned long s = ms / 1000;
-    char buf[16];
-    snprintf(buf, sizeof(buf), "%lu.%03lu", s, ms % 1000);
+    snprintf(buf, len, "%lu.%03lu", (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+}
+
+void formatTimestamp(char* buf, size_t len) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    formatTime(buf, len, tv.tv_sec, millis());
+}
+
+String getTimestamp() {
+    char buf[24];
+    formatTimestamp(buf, sizeof(buf));
     return String(buf);
 }
 
 // --- Level control ---
 
 void setLevel(Level level) {
-    s_minLevel = level;
+    g_minLevel = level;
 }
 
 Level getLevel() {
-    return s_minLevel;
+    return g_minLevel;
 }
 
 // --- Core log function ---
 
-static void logMsg(Level lvl, Category cat, const char* fmt, va_list args) {
-    if (!s_initialized) return;
-    if (lvl < s_minLevel) return;
-
-    // ERROR always passes through, others check category mask
-    if (lvl != LVL_ERROR && !(s_catMask & (uint16_t)cat)) return;
+// Binary frame, see tok::encodeFrame()
+static void writeToken(const Record& r) {
+    uint8_t f[DBG_TOK_FRAME_HDR + DBG_PAYLOAD + 1];
+    const size_t n = tok::encodeFrame(f, r.fmt, (uint32_t)r.tv.tv_sec, r.ms, (uint8_t)r.lvl,
+                                      (uint16_t)r.cat, (const uint8_t*)r.msg, r.len, r.truncated);
+    DBG_SERIAL.write(f, n);
+}
 
-    char msg[DBG_BUFSIZE];
-    vsnprintf(msg, sizeof(msg), fmt, args);
+// Format: [timestamp] LVL CATEGORY | message
+static void writeRecord(const Record& r) {
+    if (r.fmt) {
+        writeToken(r);
+        return;
+    }
+    char ts[24];
+    formatTime(ts, sizeof(ts), r.tv.tv_sec, r.ms);
+    DBG_SERIAL.printf("%s[%s] %s %-5s | %s\033[0m\r\n",
+                      levelColor(r.lvl), ts, levelName(r.lvl), catName(r.cat), r.msg);
+}
 
-    String ts = getTimestamp();
+static void drainTask(void*) {
+    static Record r;    // Only this task pops outside flush()
+    for (;;) {
+        if (s_ring.pop(r)) {
+            writeRecord(r);
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(DBG_IDLE_MS));
+        }
+    }
+}
 
-    // Format: [timestamp] LVL CATEGORY | message
-    DBG_SERIAL.printf("%s[%s] %s %-5s | %s\033[0m\r\n",
-                      levelColor(lvl), ts.c_str(), levelStr(lvl), catName(cat), msg);
+void flush() {
+    if (!s_initialized) return;
+    Record r;
+    while (s_ring.pop(r)) writeRecord(r);
+    DBG_SERIAL.flush();
 }
 
-// --- Public log functions ---
+// Drop oldest on overflow, the caller never waits for the UART
+static void enqueue(const Record& r, uint32_t c0) {
+    while (!s_ring.push(r)) {
+        if (s_ring.discard()) s_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    s_queued.fetch_add(1, std::memory_order_relaxed);
 
-void debug(Category cat, const char* fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    logMsg(LVL_DEBUG, cat, fmt, args);
-    va_end(args);
+    const uint32_t cycles = ESP.getCycleCount() - c0;
+    portENTER_CRITICAL(&s_statMux);
+    s_avgCycles = s_avgCycles ? s_avgCycles + ((int32_t)cycles - (int32_t)s_avgCycles) / 16 : cycles;
+    if (cycles > s_maxCycles) s_maxCycles = cycles;
+    portEXIT_CRITICAL(&s_statMux);
 }
 
-void info(Category cat, const char* fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    logMsg(LVL_INFO, cat, fmt, args);
-    va_end(args);
+static void stamp(Record& r, Level lvl, Category cat) {
+    gettimeofday(&r.tv, nullptr);
+    r.ms = millis();
+    r.lvl = lvl;
+    r.cat = cat;
 }
 
-void warn(Category cat, const char* fmt, ...) {
+// Filtering happened inline at the call site (dbg::enabled)
+void logf(Level lvl, Category cat, const char* fmt, ...) {
+    if (!s_initialized) return;
+
+    const uint32_t c0 = ESP.getCycleCount();
+    Record r;
+    stamp(r, lvl, cat);
+    r.fmt = nullptr;
     va_list args;
     va_start(args, fmt);
-    logMsg(LVL_WARN, cat, fmt, args);
+    vsnprintf(r.msg, sizeof(r.msg), fmt, args);
     va_end(args);
+    enqueue(r, c0);
 }
 
-void error(Category cat, const char* fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    logMsg(LVL_ERROR, cat, fmt, args);
-    va_end(args);
+void logt(Level lvl, Category cat, const char* fmt, const uint8_t* args, uint8_t len, bool truncated) {
+    if (!s_initialized) return;
+
+    const uint32_t c0 = ESP.getCycleCount();
+    Record r;
+    stamp(r, lvl, cat);
+    r.fmt = fmt;
+    r.truncated = truncated || len > sizeof(r.msg);
+    r.len = len <= sizeof(r.msg) ? len : (uint8_t)sizeof(r.msg);
+    memcpy(r.msg, args, r.len);
+    enqueue(r, c0);
+}
+
+LogStats getLogStats() {
+    LogStats st;
+    st.queued = s_queued.load(std::memory_order_relaxed);
+    st.dropped = s_dropped.load(std::memory_order_relaxed);
+    st.pending = (uint32_t)s_ring.size();
+    portENTER_CRITICAL(&s_statMux);
+    st.avgCycles = s_avgCycles;
+    st.maxCycles = s_maxCycles;
+    portEXIT_CRITICAL(&s_statMux);
+    return st;
 }
 
 } // namespace dbg
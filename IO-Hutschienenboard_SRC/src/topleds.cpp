@@ -0,0 +1,49 @@
+#include "topleds.h"
+#include "pin_config.h"
+#include "mcpport.h"
+
+#define LED_MASK ((uint16_t)((1u << NUM_CHANNELS) - 1))
+
+namespace topleds {
+
+static uint8_t s_chip = 0;
+static bool s_ready = false;
+static uint16_t s_image = 0;        // Last image handed to mcpport
+static uint32_t s_writes = 0;
+
+bool begin(uint8_t chip, uint8_t addr) {
+    s_chip = chip;
+    s_image = 0;
+    s_ready = mcpport::addOutputChip(chip, addr);   // Latches low = all off
+    return s_ready;
+}
+
+bool ready() {
+    return s_ready;
+}
+
+uint16_t compose(uint16_t on, uint16_t slow, uint16_t fast, uint32_t nowMs) {
+    // First half of each period lit
+    const uint16_t slowPhase = (nowMs % LED_SLOW_MS) < LED_SLOW_MS / 2 ? 0xFFFF : 0;
+    const uint16_t fastPhase = (nowMs % LED_FAST_MS) < LED_FAST_MS / 2 ? 0xFFFF : 0;
+    const uint16_t steady = (uint16_t)(on & ~(slow | fast));
+    const uint16_t slowLit = (uint16_t)(slow & ~fast & slowPhase);
+    return (uint16_t)((steady | slowLit | (fast & fastPhase)) & LED_MASK);
+}
+
+bool update(uint16_t on, uint16_t slow, uint16_t fast, uint32_t nowMs) {
+    if (!s_ready) return false;
+    const uint16_t image = compose(on, slow, fast, nowMs);
+    if (image == s_image) return false;
+    s_image = image;
+    mcpport::writeMask(s_chip, LED_MASK, image);
+    mcpport::flush();       // Only dirty chips: this one (plus staged relay pins)
+    s_writes++;
+    return true;
+}
+
+uint32_t writeCount() {
+    return s_writes;
+}
+
+} // namespace topleds
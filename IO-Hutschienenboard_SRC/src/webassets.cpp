@@ -0,0 +1,65 @@
+#include "webassets.h"
+#include <ESPAsyncWebServer.h>
+#include "swtools.h"
+#include "webassets_data.h"     // Generated by tools/embed_assets.py
+
+#define CACHE_REVALIDATE "no-cache"
+#define CACHE_IMMUTABLE  "public, max-age=31536000, immutable"
+
+namespace webassets {
+
+static uint32_t s_sent = 0;
+static uint32_t s_notModified = 0;
+
+static void send(AsyncWebServerRequest* req, const Asset& a) {
+    const AsyncWebParameter* v = req->getParam("v");
+    const char* cache = (v && v->value() == a.hash) ? CACHE_IMMUTABLE : CACHE_REVALIDATE;
+
+    const AsyncWebHeader* inm = req->getHeader("If-None-Match");
+    if (inm && strstr(inm->value().c_str(), a.etag)) {
+        AsyncWebServerResponse* r = req->beginResponse(304);
+        r->addHeader("ETag", a.etag);
+        r->addHeader("Cache-Control", cache);
+        req->send(r);
+        s_notModified++;
+        return;
+    }
+
+    AsyncWebServerResponse* r = req->beginResponse(200, a.type, a.data, a.len);
+    r->addHeader("Content-Encoding", "gzip");
+    r->addHeader("ETag", a.etag);
+    r->addHeader("Cache-Control", cache);
+    req->send(r);
+    s_sent++;
+}
+
+void begin(AsyncWebServer& server) {
+    for (uint8_t i = 0; i < ASSET_COUNT; i++) {
+        const Asset* a = &ASSETS[i];
+        server.on(a->path, HTTP_GET, [a](AsyncWebServerRequest* req) { send(req, *a); });
+        if (strcmp(a->path, "/index.html") == 0) {
+            server.on("/", HTTP_GET, [a](AsyncWebServerRequest* req) { send(req, *a); });
+        }
+        dbg::info(dbg::CAT_WEB, "Web-Asset %s: %u Bytes gzip, ETag %s", a->path, a->len, a->hash);
+    }
+}
+
+const Asset* find(const char* path) {
+    for (uint8_t i = 0; i < ASSET_COUNT; i++) {
+        if (strcmp(ASSETS[i].path, path) == 0) return &ASSETS[i];
+    }
+    return nullptr;
+}
+
+uint8_t count() {
+    return ASSET_COUNT;
+}
+
+Stats getStats() {
+    Stats st;
+    st.sent = s_sent;
+    st.notModified = s_notModified;
+    return st;
+}
+
+} // namespace webassets
@@ -0,0 +1,190 @@
+// autooff: deadline order, retime, cancel, 64-bit time and the warm-reset
+// restore, on the virtual clock of the native HAL
+//   pio test -e native-test -f test_autooff
+#include <unity.h>
+#include <esp_timer.h>
+#include "hal_native.h"
+#include "autooff.h"
+
+static const int64_t SEC = 1000000LL;
+
+static uint32_t s_dueCalls = 0;
+static int64_t s_dueAtUs = -1;      // Clock at the last callback
+
+static void onDue() {
+    s_dueCalls++;
+    s_dueAtUs = esp_timer_get_time();
+}
+
+void setUp() {
+    nativehal::reset();
+    autooff::begin(onDue, false);   // Clean schedule, old RTC image dropped
+    s_dueCalls = 0;
+    s_dueAtUs = -1;
+}
+
+void tearDown() {}
+
+// One callback per distinct deadline, equal deadlines taken together
+static void test_deadline_order() {
+    autooff::arm(2, 5, 0);
+    autooff::arm(0, 3, 0);
+    autooff::arm(1, 3, 0);
+    TEST_ASSERT_EQUAL_INT64(3 * SEC, nativehal::nextEventUs());
+
+    TEST_ASSERT_EQUAL_HEX16(0, autooff::takeExpired(3 * SEC - 1));
+    nativehal::advance(3 * SEC);
+    TEST_ASSERT_EQUAL_UINT32(1, s_dueCalls);
+    TEST_ASSERT_EQUAL_INT64(3 * SEC, s_dueAtUs);
+    TEST_ASSERT_EQUAL_HEX16(0x0003, autooff::takeExpired(3 * SEC));
+    TEST_ASSERT_FALSE(autooff::armed(0));
+    TEST_ASSERT_TRUE(autooff::armed(2));
+    TEST_ASSERT_EQUAL_UINT32(2, autooff::remainingSeconds(2, 3 * SEC));
+
+    nativehal::advance(2 * SEC);
+    TEST_ASSERT_EQUAL_UINT32(2, s_dueCalls);
+    TEST_ASSERT_EQUAL_INT64(5 * SEC, s_dueAtUs);
+    TEST_ASSERT_EQUAL_HEX16(0x0004, autooff::takeExpired(5 * SEC));
+    TEST_ASSERT_EQUAL_INT64(-1, nativehal::nextEventUs());
+}
+
+// Re-arming replaces the deadline and moves the channel in the order
+static void test_rearm() {
+    autooff::arm(7, 2, 0);
+    autooff::arm(8, 4, 0);
+    autooff::arm(7, 10, 1 * SEC);                  // Now after channel 8
+    TEST_ASSERT_EQUAL_INT64(4 * SEC, nativehal::nextEventUs());
+    TEST_ASSERT_EQUAL_UINT32(10, autooff::remainingSeconds(7, 1 * SEC));
+    TEST_ASSERT_EQUAL_UINT32(1, autooff::remainingSeconds(7, 10 * SEC + 1));   // Rounded up
+    TEST_ASSERT_EQUAL_HEX16(1 << 8, autooff::takeExpired(4 * SEC));
+    TEST_ASSERT_EQUAL_HEX16(1 << 7, autooff::takeExpired(11 * SEC));
+
+    autooff::arm(7, 5, 0);
+    autooff::arm(7, 0, 0);                         // 0 s = cancel
+    TEST_ASSERT_FALSE(autooff::armed(7));
+}
+
+// New duration counts from the original start
+static void test_retime() {
+    autooff::arm(4, 10, 0);
+    autooff::arm(5, 8, 0);
+    nativehal::advance(4 * SEC);
+
+    autooff::retime(4, 6);
+    TEST_ASSERT_EQUAL_UINT32(2, autooff::remainingSeconds(4, 4 * SEC));
+    TEST_ASSERT_EQUAL_INT64(6 * SEC, nativehal::nextEventUs());
+
+    autooff::retime(4, 3);                         // Already past: due at once
+    TEST_ASSERT_EQUAL_HEX16(1 << 4, autooff::takeExpired(4 * SEC));
+
+    autooff::retime(9, 30);                        // Not armed: ignored
+    TEST_ASSERT_FALSE(autooff::armed(9));
+
+    autooff::retime(5, 0);                         // 0 s = cancel
+    TEST_ASSERT_FALSE(autooff::armed(5));
+    TEST_ASSERT_EQUAL_INT64(-1, nativehal::nextEventUs());
+}
+
+// Cancelling the earliest timer re-programs the callback for the next one
+static void test_cancel() {
+    autooff::arm(0, 1, 0);
+    autooff::arm(11, 7, 0);
+    autooff::cancel(0);
+    autooff::cancel(3);                            // Not armed: no effect
+    TEST_ASSERT_FALSE(autooff::armed(0));
+    TEST_ASSERT_EQUAL_UINT32(0, autooff::remainingSeconds(0, 0));
+
+    nativehal::advance(7 * SEC);
+    TEST_ASSERT_EQUAL_UINT32(1, s_dueCalls);
+    TEST_ASSERT_EQUAL_INT64(7 * SEC, s_dueAtUs);
+    TEST_ASSERT_EQUAL_HEX16(1 << 11, autooff::takeExpired(7 * SEC));
+}
+
+// 64-bit microseconds: no wrap where a 32-bit micros() would (2^32 us,
+// ~71.6 min), and the longest timer (2^32 - 1 s, ~136 years) keeps its order
+static void test_no_wrap() {
+    const int64_t t0 = (1LL << 32) - 500000;
+    nativehal::advanceTo(t0);
+    autooff::arm(1, 0xFFFFFFFFUL, t0);
+    autooff::arm(2, 1, t0);
+    TEST_ASSERT_EQUAL_INT64(t0 + SEC, nativehal::nextEventUs());
+    TEST_ASSERT_EQUAL_UINT32(1, autooff::remainingSeconds(2, (1LL << 32)));
+
+    nativehal::advance(SEC);
+    TEST_ASSERT_EQUAL_INT64(t0 + SEC, s_dueAtUs);
+    TEST_ASSERT_EQUAL_HEX16(1 << 2, autooff::takeExpired(t0 + SEC));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL, autooff::remainingSeconds(1, t0));
+    TEST_ASSERT_EQUAL_HEX16(0, autooff::takeExpired(t0 + 0xFFFFFFFFLL * SEC - 1));
+    TEST_ASSERT_EQUAL_HEX16(1 << 1, autooff::takeExpired(t0 + 0xFFFFFFFFLL * SEC));
+}
+
+// Schedule before a "warm reset": three timers, one done, heartbeat at 4 s
+static void runBeforeReset() {
+    autooff::arm(3, 10, 0);
+    autooff::arm(6, 3, 0);
+    nativehal::advance(2 * SEC);
+    autooff::arm(9, 60, 2 * SEC);
+    nativehal::advanceTo(4 * SEC);
+    autooff::takeExpired(4 * SEC);                 // Channel 6 done before the reset
+    autooff::heartbeat(4 * SEC);
+}
+
+static void test_restore() {
+    runBeforeReset();
+
+    // Reboot: the clock starts over, the RTC image survives
+    nativehal::reset();
+    autooff::begin(onDue, true);
+    TEST_ASSERT_EQUAL_HEX16((1 << 3) | (1 << 9), autooff::restoredMask());
+    TEST_ASSERT_EQUAL_UINT32(6, autooff::remainingSeconds(3, 0));
+    TEST_ASSERT_EQUAL_UINT32(58, autooff::remainingSeconds(9, 0));
+    TEST_ASSERT_FALSE(autooff::armed(6));
+    TEST_ASSERT_EQUAL_INT64(6 * SEC, nativehal::nextEventUs());
+
+    // The restored schedule is mirrored again for the next reset
+    nativehal::advance(1 * SEC);
+    autooff::heartbeat(1 * SEC);
+    nativehal::reset();
+    autooff::begin(onDue, true);
+    TEST_ASSERT_EQUAL_UINT32(5, autooff::remainingSeconds(3, 0));
+}
+
+// Default build: the relays are off after the reset, so are the timers
+static void test_restore_disabled() {
+    runBeforeReset();
+    nativehal::reset();
+    autooff::begin(onDue, false);
+    TEST_ASSERT_EQUAL_HEX16(0, autooff::restoredMask());
+    TEST_ASSERT_FALSE(autooff::armed(3));
+    TEST_ASSERT_FALSE(autooff::armed(9));
+    TEST_ASSERT_EQUAL_INT64(-1, nativehal::nextEventUs());
+
+    // Dropped for good, not just skipped once
+    nativehal::reset();
+    autooff::begin(onDue, true);
+    TEST_ASSERT_EQUAL_HEX16(0, autooff::restoredMask());
+}
+
+// A timer that ran out while the board was down is not restored
+static void test_restore_expired() {
+    autooff::arm(0, 2, 0);
+    autooff::arm(1, 20, 0);
+    autooff::heartbeat(5 * SEC);                   // Callback never collected
+    nativehal::reset();
+    autooff::begin(onDue, true);
+    TEST_ASSERT_EQUAL_HEX16(1 << 1, autooff::restoredMask());
+    TEST_ASSERT_EQUAL_UINT32(15, autooff::remainingSeconds(1, 0));
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_deadline_order);
+    RUN_TEST(test_rearm);
+    RUN_TEST(test_retime);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_no_wrap);
+    RUN_TEST(test_restore);
+    RUN_TEST(test_restore_disabled);
+    RUN_TEST(test_restore_expired);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+// binproto: byte-exact StateFrame / CommandFrame layout ("bin1")
+//   pio test -e native-test -f test_binproto
+#include <unity.h>
+#include <string.h>
+#include "binproto.h"
+
+using namespace binproto;
+
+void setUp() {}
+void tearDown() {}
+
+// seq 0x01020304, inputs 0x0A05, outputs 0x0813, NTP + both MCPs + SF_SIM,
+// mapping 0->0 1->1 2->2 11->11, timers[0] 300 s (299 left), timers[11] 0xAABBCCDD
+static const uint8_t GOLDEN_STATE[120] = {
+    0x01, 0x01, 0x0C, 0x0F,                                 // version, type, channels, flags
+    0x04, 0x03, 0x02, 0x01,                                 // seq
+    0x05, 0x0A, 0x13, 0x08,                                 // inputs, outputs
+    0x00, 0x01, 0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,         // mappings[0..7]
+    0xFF, 0xFF, 0xFF, 0x0B,                                 // mappings[8..11]
+    0x2C, 0x01, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // timers[0..1]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // timers[2..3]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // timers[4..5]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // timers[6..7]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // timers[8..9]
+    0x00, 0x00, 0x00, 0x00,  0xDD, 0xCC, 0xBB, 0xAA,        // timers[10..11]
+    0x2B, 0x01, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // remaining[0..1]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // remaining[2..3]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // remaining[4..5]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // remaining[6..7]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // remaining[8..9]
+    0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,        // remaining[10..11]
+};
+
+static stateproto::Snapshot goldenSnapshot() {
+    stateproto::Snapshot s;
+    memset(&s, 0, sizeof(s));
+    s.inputs = 0x0A05;
+    s.outputs = 0x0813;
+    for (int i = 0; i < NUM_CHANNELS; i++) s.mappings[i] = -1;
+    s.mappings[0] = 0;
+    s.mappings[1] = 1;
+    s.mappings[2] = 2;
+    s.mappings[11] = 11;
+    s.timers[0] = 300;
+    s.timers[11] = 0xAABBCCDDUL;
+    s.remaining[0] = 299;
+    s.mcp = 3;
+    s.ntp = true;
+    return s;
+}
+
+static void test_state_frame_golden() {
+    const stateproto::Snapshot s = goldenSnapshot();
+    StateFrame f;
+    memset(&f, 0xA5, sizeof(f));
+    encodeState(s, 0x01020304UL, SF_SIM, f);
+    TEST_ASSERT_EQUAL_size_t(120, sizeof(f));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(GOLDEN_STATE, (const uint8_t*)&f, sizeof(GOLDEN_STATE));
+}
+
+static void test_state_frame_flags_follow_snapshot() {
+    stateproto::Snapshot s = goldenSnapshot();
+    s.ntp = false;
+    s.mcp = 2;
+    StateFrame f;
+    encodeState(s, 1, 0, f);
+    TEST_ASSERT_EQUAL_HEX8(SF_MCP2, f.flags);
+}
+
+static void test_command_decode_golden() {
+    const uint8_t set[8] = { 0x01, 0x10, 0x02, 0x05, 0x01, 0x00, 0x00, 0x00 };
+    Command c;
+    TEST_ASSERT_TRUE(decodeCommand(set, sizeof(set), c));
+    TEST_ASSERT_EQUAL_UINT8(CMD_SET, c.cmd);
+    TEST_ASSERT_EQUAL_UINT8(5, c.ch);
+    TEST_ASSERT_EQUAL_INT32(1, c.value);
+
+    const uint8_t unmap[8] = { 0x01, 0x10, 0x03, 0x02, 0xFF, 0xFF, 0xFF, 0xFF };
+    TEST_ASSERT_TRUE(decodeCommand(unmap, sizeof(unmap), c));
+    TEST_ASSERT_EQUAL_UINT8(CMD_MAP, c.cmd);
+    TEST_ASSERT_EQUAL_UINT8(2, c.ch);
+    TEST_ASSERT_EQUAL_INT32(-1, c.value);
+
+    // CMD_INMODE: mode 1 (AC), 40 ms window -> 0x00002801
+    const uint8_t inmode[8] = { 0x01, 0x10, 0x07, 0x0B, 0x01, 0x28, 0x00, 0x00 };
+    TEST_ASSERT_TRUE(decodeCommand(inmode, sizeof(inmode), c));
+    TEST_ASSERT_EQUAL_UINT8(CMD_INMODE, c.cmd);
+    TEST_ASSERT_EQUAL_UINT8(11, c.ch);
+    TEST_ASSERT_EQUAL_INT32(0x2801, c.value);
+}
+
+static void test_command_decode_rejects() {
+    const uint8_t good[9] = { 0x01, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    Command c = { 0xEE, 0xEE, 0x5A5A };
+    TEST_ASSERT_FALSE(decodeCommand(good, 7, c));     // short
+    TEST_ASSERT_FALSE(decodeCommand(good, 9, c));     // long
+    TEST_ASSERT_FALSE(decodeCommand(good, 0, c));
+
+    uint8_t bad[8];
+    memcpy(bad, good, 8);
+    bad[0] = 2;                                       // unknown version
+    TEST_ASSERT_FALSE(decodeCommand(bad, 8, c));
+    memcpy(bad, good, 8);
+    bad[1] = MSG_STATE;                               // wrong direction
+    TEST_ASSERT_FALSE(decodeCommand(bad, 8, c));
+
+    // Rejected frames leave the output untouched
+    TEST_ASSERT_EQUAL_UINT8(0xEE, c.cmd);
+    TEST_ASSERT_EQUAL_INT32(0x5A5A, c.value);
+}
+
+static void test_command_encode_golden() {
+    const uint8_t expect[8] = { 0x01, 0x10, 0x04, 0x03, 0x10, 0x0E, 0x00, 0x00 };
+    const Command c = { CMD_TIMER, 3, 3600 };
+    CommandFrame f;
+    encodeCommand(c, f);
+    TEST_ASSERT_EQUAL_size_t(8, sizeof(f));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, (const uint8_t*)&f, sizeof(expect));
+
+    Command back;
+    TEST_ASSERT_TRUE(decodeCommand((const uint8_t*)&f, sizeof(f), back));
+    TEST_ASSERT_EQUAL_UINT8(c.cmd, back.cmd);
+    TEST_ASSERT_EQUAL_UINT8(c.ch, back.ch);
+    TEST_ASSERT_EQUAL_INT32(c.value, back.value);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_state_frame_golden);
+    RUN_TEST(test_state_frame_flags_follow_snapshot);
+    RUN_TEST(test_command_decode_golden);
+    RUN_TEST(test_command_decode_rejects);
+    RUN_TEST(test_command_encode_golden);
+    return UNITY_END();
+}
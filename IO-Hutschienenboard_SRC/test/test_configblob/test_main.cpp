@@ -0,0 +1,369 @@
+// configblob: versioned NVS blob - round trip, migration, newer firmware,
+// every rejection path, and the fallback to the old per-key layout
+//   pio test -e native-test -f test_configblob
+#include <unity.h>
+#include <string.h>
+#include <stddef.h>
+#include <esp_rom_crc.h>
+#include "configblob.h"
+#include "s0counter.h"
+
+using namespace configblob;
+
+static const size_t V1_SIZE = offsetof(Config, rules);
+
+static uint8_t s_buf[CFG_BLOB_MAX + 64];
+
+// Old per-key store: NVS finds a key only with the type it was written with
+struct LegacyKey {
+    const char* key;
+    KeyType     type;
+    int64_t     value;
+};
+
+static LegacyKey s_keys[80];
+static int s_keyCount = 0;
+static const char* s_ssid = nullptr;        // nullptr = not stored
+static const char* s_pass = nullptr;
+
+static bool legacyNum(const char* key, KeyType type, int64_t& v) {
+    for (int k = 0; k < s_keyCount; k++) {
+        if (strcmp(s_keys[k].key, key) == 0 && s_keys[k].type == type) {
+            v = s_keys[k].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool legacyStr(const char* key, char* out, size_t cap) {
+    const char* v = strcmp(key, "ssid") == 0 ? s_ssid : strcmp(key, "pass") == 0 ? s_pass : nullptr;
+    if (!v) return false;
+    strncpy(out, v, cap);       // Not terminated when too long: load() must cope
+    return true;
+}
+
+static const LegacyReader s_reader = {legacyNum, legacyStr};
+
+static void putKey(const char* key, KeyType type, int64_t value) {
+    s_keys[s_keyCount++] = {key, type, value};
+}
+
+void setUp() {
+    memset(s_buf, 0, sizeof(s_buf));
+    s_keyCount = 0;
+    s_ssid = nullptr;
+    s_pass = nullptr;
+}
+
+void tearDown() {}
+
+static void sample(Config& c) {
+    defaults(c);
+    strcpy(c.ssid, "Werkstatt");
+    strcpy(c.pass, "geheim123");
+    for (uint8_t i = 0; i < CFG_BLOB_CHANNELS; i++) {
+        c.inputMapping[i] = (int8_t)(CFG_BLOB_CHANNELS - 1 - i);
+        c.autoOffSeconds[i] = 60u * i;
+        c.inputMode[i] = i % 3;
+        c.inputFilterMs[i] = (uint16_t)(10 + i);
+        c.s0Imp[i] = (uint16_t)(800 + i);
+    }
+    strcpy(c.rules, "E1->toggle A1\n");
+}
+
+// Header + CRC around an arbitrary payload, as an older or newer firmware wrote it
+static size_t makeBlob(uint16_t version, const void* payload, uint16_t size) {
+    const uint32_t magic = 0x46434F49UL;   // "IOCF"
+    const uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)payload, size);
+    memcpy(s_buf, &magic, 4);
+    memcpy(s_buf + 4, &version, 2);
+    memcpy(s_buf + 6, &size, 2);
+    memcpy(s_buf + 8, &crc, 4);
+    memcpy(s_buf + CFG_BLOB_HEADER, payload, size);
+    return CFG_BLOB_HEADER + size;
+}
+
+static void assertDefaults(const Config& c) {
+    Config d;
+    defaults(d);
+    TEST_ASSERT_EQUAL_MEMORY(&d, &c, sizeof(Config));
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[0]);
+    TEST_ASSERT_EQUAL_UINT16(s0counter::IMP_DEFAULT, c.s0Imp[11]);
+}
+
+static void test_round_trip() {
+    Config in, out;
+    sample(in);
+    const size_t n = encode(in, s_buf, sizeof(s_buf));
+    TEST_ASSERT_EQUAL_size_t(CFG_BLOB_MAX, n);
+
+    const uint8_t head[8] = { 'I', 'O', 'C', 'F', CFG_BLOB_VERSION, 0x00,
+                              (uint8_t)sizeof(Config), (uint8_t)(sizeof(Config) >> 8) };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(head, s_buf, sizeof(head));
+
+    uint16_t ver = 0;
+    TEST_ASSERT_EQUAL_INT(OK, decode(s_buf, n, out, &ver));
+    TEST_ASSERT_EQUAL_UINT16(CFG_BLOB_VERSION, ver);
+    TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(Config));
+
+    TEST_ASSERT_EQUAL_size_t(0, encode(in, s_buf, CFG_BLOB_MAX - 1));   // Cap too small
+}
+
+// Version 1 (no rule text): fields kept, rules default to "", MIGRATED
+static void test_v1_migrates() {
+    Config in, out;
+    sample(in);
+    const size_t n = makeBlob(1, &in, (uint16_t)V1_SIZE);
+
+    uint16_t ver = 0;
+    TEST_ASSERT_EQUAL_INT(MIGRATED, decode(s_buf, n, out, &ver));
+    TEST_ASSERT_EQUAL_UINT16(1, ver);
+    TEST_ASSERT_EQUAL_MEMORY(&in, &out, V1_SIZE);
+    TEST_ASSERT_EQUAL_STRING("", out.rules);
+
+    // Written back it is a current blob
+    const size_t m = encode(out, s_buf, sizeof(s_buf));
+    TEST_ASSERT_EQUAL_INT(OK, decode(s_buf, m, out, &ver));
+    TEST_ASSERT_EQUAL_UINT16(CFG_BLOB_VERSION, ver);
+}
+
+// Blob of a newer firmware: read as far as this one knows it
+static void test_newer_longer() {
+    uint8_t payload[sizeof(Config) + 24];
+    Config in, out;
+    sample(in);
+    memcpy(payload, &in, sizeof(Config));
+    memset(payload + sizeof(Config), 0x5A, 24);     // Fields appended by "version 3"
+    const size_t n = makeBlob(CFG_BLOB_VERSION + 1, payload, sizeof(payload));
+
+    uint16_t ver = 0;
+    TEST_ASSERT_EQUAL_INT(OK, decode(s_buf, n, out, &ver));
+    TEST_ASSERT_EQUAL_UINT16(CFG_BLOB_VERSION + 1, ver);
+    TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(Config));
+
+    // Newer but shorter than the current layout: not append-only
+    const size_t m = makeBlob(CFG_BLOB_VERSION + 1, payload, sizeof(Config) - 1);
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, m, out, &ver));
+    TEST_ASSERT_EQUAL_UINT16(0, ver);
+    assertDefaults(out);
+}
+
+static void test_crc_flip() {
+    Config in, out;
+    sample(in);
+    const size_t n = encode(in, s_buf, sizeof(s_buf));
+
+    s_buf[CFG_BLOB_HEADER + 40] ^= 0x01;            // Payload bit
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n, out));
+    assertDefaults(out);
+    s_buf[CFG_BLOB_HEADER + 40] ^= 0x01;
+
+    s_buf[9] ^= 0x80;                               // Stored CRC bit
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n, out));
+    s_buf[9] ^= 0x80;
+
+    s_buf[n - 1] ^= 0x10;                           // Last rule byte
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n, out));
+    s_buf[n - 1] ^= 0x10;
+
+    TEST_ASSERT_EQUAL_INT(OK, decode(s_buf, n, out));
+}
+
+static void test_bad_size_or_magic() {
+    Config in, out;
+    sample(in);
+
+    // Size does not match the version (v2 with the v1 size)
+    size_t n = makeBlob(CFG_BLOB_VERSION, &in, (uint16_t)V1_SIZE);
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n, out));
+
+    // Size larger than the bytes read (truncated payload)
+    n = encode(in, s_buf, sizeof(s_buf));
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n - 1, out));
+
+    // Version 0
+    n = makeBlob(0, &in, (uint16_t)V1_SIZE);
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n, out));
+
+    // Magic
+    n = encode(in, s_buf, sizeof(s_buf));
+    s_buf[0] = 'X';
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, n, out));
+    assertDefaults(out);
+}
+
+static void test_truncated_header() {
+    Config in, out;
+    sample(in);
+    encode(in, s_buf, sizeof(s_buf));
+    for (size_t len = 1; len < CFG_BLOB_HEADER; len++) {
+        TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, len, out));
+    }
+    // Header only, payload missing
+    TEST_ASSERT_EQUAL_INT(CORRUPT, decode(s_buf, CFG_BLOB_HEADER, out));
+    assertDefaults(out);
+}
+
+static void test_empty() {
+    Config out;
+    uint16_t ver = 7;
+    TEST_ASSERT_EQUAL_INT(EMPTY, decode(s_buf, 0, out, &ver));
+    TEST_ASSERT_EQUAL_UINT16(0, ver);
+    assertDefaults(out);
+    TEST_ASSERT_EQUAL_INT(EMPTY, decode(nullptr, 100, out));
+}
+
+// Strings from the blob are always terminated
+static void test_strings_terminated() {
+    Config in, out;
+    sample(in);
+    memset(in.ssid, 'S', sizeof(in.ssid));
+    memset(in.pass, 'P', sizeof(in.pass));
+    memset(in.rules, 'R', sizeof(in.rules));
+    const size_t n = encode(in, s_buf, sizeof(s_buf));
+    TEST_ASSERT_EQUAL_INT(OK, decode(s_buf, n, out));
+    TEST_ASSERT_EQUAL_size_t(sizeof(out.ssid) - 1, strlen(out.ssid));
+    TEST_ASSERT_EQUAL_size_t(sizeof(out.pass) - 1, strlen(out.pass));
+    TEST_ASSERT_EQUAL_size_t(sizeof(out.rules) - 1, strlen(out.rules));
+}
+
+// --- Old per-key layout ---
+
+// Stored keys taken over, every key that is missing keeps its default
+static void test_legacy_defaults_for_missing() {
+    TEST_ASSERT_FALSE(hasLegacy(s_reader));
+    s_ssid = "Werkstatt";
+    putKey("map0", KEY_I8, 3);
+    putKey("map11", KEY_I8, -1);
+    putKey("auto2", KEY_U32, 600);
+    putKey("imode1", KEY_U8, 1);
+    putKey("ifilt1", KEY_U16, 40);
+    putKey("s0imp4", KEY_U16, 2000);
+    TEST_ASSERT_TRUE(hasLegacy(s_reader));
+
+    Config c, d;
+    readLegacy(s_reader, c);
+    defaults(d);
+    TEST_ASSERT_EQUAL_STRING("Werkstatt", c.ssid);
+    TEST_ASSERT_EQUAL_STRING("", c.pass);
+    TEST_ASSERT_EQUAL_INT8(3, c.inputMapping[0]);
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[1]);
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[11]);
+    TEST_ASSERT_EQUAL_UINT32(600, c.autoOffSeconds[2]);
+    TEST_ASSERT_EQUAL_UINT8(1, c.inputMode[1]);
+    TEST_ASSERT_EQUAL_UINT16(40, c.inputFilterMs[1]);
+    TEST_ASSERT_EQUAL_UINT16(2000, c.s0Imp[4]);
+    TEST_ASSERT_EQUAL_UINT16(s0counter::IMP_DEFAULT, c.s0Imp[5]);
+
+    // Everything else as defaults()
+    c.inputMapping[0] = d.inputMapping[0];
+    c.autoOffSeconds[2] = d.autoOffSeconds[2];
+    c.inputMode[1] = d.inputMode[1];
+    c.inputFilterMs[1] = d.inputFilterMs[1];
+    c.s0Imp[4] = d.s0Imp[4];
+    strcpy(d.ssid, "Werkstatt");
+    TEST_ASSERT_EQUAL_MEMORY(&d, &c, sizeof(Config));
+
+    // A board that only ever got its WiFi set
+    setUp();
+    s_ssid = "Nur-WLAN";
+    TEST_ASSERT_TRUE(hasLegacy(s_reader));
+}
+
+// Values that do not fit their field keep the default, their neighbours are taken
+static void test_legacy_value_out_of_range() {
+    putKey("map0", KEY_I8, 12);             // Channel 13
+    putKey("map1", KEY_I8, -2);
+    putKey("map2", KEY_I8, 200);            // Wider than int8
+    putKey("map3", KEY_I8, 11);
+    putKey("map4", KEY_U32, 5);             // Written with another type: not found
+    putKey("imode0", KEY_U8, 3);            // No such input mode
+    putKey("imode1", KEY_U8, 255);
+    putKey("imode2", KEY_U8, 2);
+    putKey("ifilt0", KEY_U16, 70000);
+    putKey("auto0", KEY_U32, -1);
+    putKey("auto1", KEY_U32, 0xFFFFFFFFLL);
+    s_ssid = "0123456789012345678901234567890123456789";  // Longer than 32
+
+    Config c;
+    readLegacy(s_reader, c);
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[0]);
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[1]);
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[2]);
+    TEST_ASSERT_EQUAL_INT8(11, c.inputMapping[3]);
+    TEST_ASSERT_EQUAL_INT8(-1, c.inputMapping[4]);
+    TEST_ASSERT_EQUAL_UINT8(0, c.inputMode[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, c.inputMode[1]);
+    TEST_ASSERT_EQUAL_UINT8(2, c.inputMode[2]);
+    TEST_ASSERT_EQUAL_UINT16(0, c.inputFilterMs[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, c.autoOffSeconds[0]);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL, c.autoOffSeconds[1]);
+    TEST_ASSERT_EQUAL_size_t(sizeof(c.ssid) - 1, strlen(c.ssid));
+}
+
+// Which source load() takes: blob first, old keys only without a usable one
+static void test_legacy_and_blob() {
+    Config in, out;
+    sample(in);
+    size_t n = encode(in, s_buf, sizeof(s_buf));
+    putKey("map0", KEY_I8, 7);
+    s_ssid = "Alt";
+
+    Result blob = OK;
+    TEST_ASSERT_EQUAL_INT(OK, load(s_buf, n, s_reader, out, nullptr, &blob));
+    TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(Config));        // Keys ignored
+
+    s_buf[CFG_BLOB_HEADER + 3] ^= 0x40;                         // Corrupt blob
+    TEST_ASSERT_EQUAL_INT(LEGACY, load(s_buf, n, s_reader, out, nullptr, &blob));
+    TEST_ASSERT_EQUAL_INT(CORRUPT, blob);
+    TEST_ASSERT_EQUAL_STRING("Alt", out.ssid);
+    TEST_ASSERT_EQUAL_INT8(7, out.inputMapping[0]);
+    TEST_ASSERT_EQUAL_STRING("", out.rules);
+
+    TEST_ASSERT_EQUAL_INT(LEGACY, load(s_buf, 0, s_reader, out, nullptr, &blob));
+    TEST_ASSERT_EQUAL_INT(EMPTY, blob);
+
+    // v1 blob next to old keys: the blob wins
+    n = makeBlob(1, &in, (uint16_t)V1_SIZE);
+    TEST_ASSERT_EQUAL_INT(MIGRATED, load(s_buf, n, s_reader, out));
+    TEST_ASSERT_EQUAL_STRING("Werkstatt", out.ssid);
+
+    // Corrupt without old keys: defaults
+    setUp();
+    n = encode(in, s_buf, sizeof(s_buf));
+    s_buf[0] = 'X';
+    TEST_ASSERT_EQUAL_INT(CORRUPT, load(s_buf, n, s_reader, out));
+    assertDefaults(out);
+}
+
+static int s_removed = 0;
+static bool s_sawLast = false;
+
+static void onKey(const char* key) {
+    s_removed++;
+    if (strcmp(key, "s0imp11") == 0) s_sawLast = true;
+}
+
+static void test_legacy_keys_listed() {
+    forEachLegacyKey(onKey);
+    TEST_ASSERT_EQUAL_INT(2 + 5 * CFG_BLOB_CHANNELS, s_removed);
+    TEST_ASSERT_TRUE(s_sawLast);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_v1_migrates);
+    RUN_TEST(test_newer_longer);
+    RUN_TEST(test_crc_flip);
+    RUN_TEST(test_bad_size_or_magic);
+    RUN_TEST(test_truncated_header);
+    RUN_TEST(test_empty);
+    RUN_TEST(test_strings_terminated);
+    RUN_TEST(test_legacy_defaults_for_missing);
+    RUN_TEST(test_legacy_value_out_of_range);
+    RUN_TEST(test_legacy_and_blob);
+    RUN_TEST(test_legacy_keys_listed);
+    return UNITY_END();
+}
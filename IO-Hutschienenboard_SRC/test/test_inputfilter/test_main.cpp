@@ -0,0 +1,182 @@
+// inputfilter: DC bounce lockout and AC presence window on edge traces
+//   pio test -e native-test -f test_inputfilter
+#include <unity.h>
+#include "inputfilter.h"
+
+using namespace inputfilter;
+
+static const uint8_t CH = 4;
+static const int64_t POLL_US = 1000;   // Poll grid of the replay (1 ms)
+
+struct Edge {
+    int64_t us;
+    bool    level;
+};
+
+struct Change {
+    int64_t us;
+    bool    on;
+};
+
+void setUp() {
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        configure(i, MODE_DC, 0);
+        reset(i, false);
+    }
+}
+
+void tearDown() {}
+
+// Replays the edges of CH in time order and polls every POLL_US like
+// iologic::scan() (edges up to t first, then poll(t)); returns the number
+// of conditioned transitions written to out
+static int replay(const Edge* e, int n, int64_t endUs, Change* out, int max) {
+    int count = 0;
+    int next = 0;
+    for (int64_t t = 0; t <= endUs; t += POLL_US) {
+        for (; next < n && e[next].us <= t; next++) {
+            if (feed(CH, e[next].level, e[next].us) && count < max) out[count++] = {e[next].us, state(CH)};
+        }
+        if ((poll(t) & (1 << CH)) && count < max) out[count++] = {t, state(CH)};
+    }
+    return count;
+}
+
+// --- DC ---
+
+// Contact closes with four bounces within 2 ms, opens 200 ms later with
+// two more: one transition each way, at the leading edge
+static void test_dc_bouncing_contact() {
+    const Edge trace[] = {
+        {0, true}, {300, false}, {800, true}, {1500, false}, {2100, true},
+        {200000, false}, {200400, true}, {201000, false},
+    };
+    Change ch[8];
+    const int n = replay(trace, 8, 300000, ch, 8);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT64(0, ch[0].us);
+    TEST_ASSERT_TRUE(ch[0].on);
+    TEST_ASSERT_EQUAL_INT64(200000, ch[1].us);
+    TEST_ASSERT_FALSE(ch[1].on);
+}
+
+// Level settles opposite to the leading edge: corrected at the lockout end
+static void test_dc_settles_differently() {
+    const Edge trace[] = { {0, true}, {5000, false} };
+    Change ch[4];
+    const int n = replay(trace, 2, 100000, ch, 4);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_TRUE(ch[0].on);
+    TEST_ASSERT_EQUAL_INT64(DC_DEFAULT_MS * 1000, ch[1].us);
+    TEST_ASSERT_FALSE(ch[1].on);
+}
+
+// A lone 50 us glitch is taken at once (leading edge) and reported as a
+// pulse of exactly the lockout length - by design, no added latency
+static void test_dc_lone_glitch() {
+    const Edge trace[] = { {10000, true}, {10050, false} };
+    Change ch[4];
+    int n = replay(trace, 2, 100000, ch, 4);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT64(10000, ch[0].us);
+    TEST_ASSERT_TRUE(ch[0].on);
+    TEST_ASSERT_EQUAL_INT64(10000 + DC_DEFAULT_MS * 1000, ch[1].us);
+    TEST_ASSERT_FALSE(ch[1].on);
+
+    // Configured lockout
+    configure(CH, MODE_DC, 50);
+    reset(CH, false);
+    n = replay(trace, 2, 100000, ch, 4);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT64(60000, ch[1].us);
+    TEST_ASSERT_EQUAL_UINT16(50, filterMs(CH));
+}
+
+// --- AC ---
+
+// Half-wave rectified 50 Hz through the optocoupler: high 10 ms every 20 ms
+static int acTrain(Edge* e, int max, int64_t startUs, int periods, int skip) {
+    int n = 0;
+    for (int k = 0; k < periods && n + 2 <= max; k++) {
+        if (k == skip) continue;
+        const int64_t t = startUs + (int64_t)k * 20000;
+        e[n++] = {t, true};
+        e[n++] = {t + 10000, false};
+    }
+    return n;
+}
+
+// On at the first edge, steady through 25 periods, off one window after
+// the last edge
+static void test_ac_50hz_on_off() {
+    configure(CH, MODE_AC, 0);
+    reset(CH, false);
+    Edge trace[64];
+    const int edges = acTrain(trace, 64, 100000, 25, -1);
+    Change ch[8];
+    const int n = replay(trace, edges, 800000, ch, 8);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT64(100000, ch[0].us);
+    TEST_ASSERT_TRUE(ch[0].on);
+    const int64_t lastEdge = trace[edges - 1].us;
+    TEST_ASSERT_EQUAL_INT64(lastEdge + AC_DEFAULT_MS * 1000, ch[1].us);
+    TEST_ASSERT_FALSE(ch[1].on);
+}
+
+// One missing pulse (30 ms gap): bridged by a 45 ms window, reported as a
+// drop-out with the 25 ms minimum window
+static void test_ac_missing_pulse() {
+    Edge trace[64];
+    const int edges = acTrain(trace, 64, 0, 10, 5);
+    Change ch[8];
+
+    configure(CH, MODE_AC, 45);
+    reset(CH, false);
+    TEST_ASSERT_EQUAL_INT(2, replay(trace, edges, 400000, ch, 8));
+
+    configure(CH, MODE_AC, 10);
+    reset(CH, false);
+    TEST_ASSERT_EQUAL_UINT16(AC_MIN_MS, filterMs(CH));
+    const int n = replay(trace, edges, 400000, ch, 8);
+    TEST_ASSERT_EQUAL_INT(4, n);
+    TEST_ASSERT_EQUAL_INT64(90000 + AC_MIN_MS * 1000, ch[1].us);   // Falling edge of pulse 4
+    TEST_ASSERT_FALSE(ch[1].on);
+    TEST_ASSERT_EQUAL_INT64(120000, ch[2].us);                     // Pulse 6
+    TEST_ASSERT_TRUE(ch[2].on);
+}
+
+// A lone glitch edge on an AC input reads as one window of presence
+static void test_ac_lone_glitch() {
+    configure(CH, MODE_AC, 0);
+    reset(CH, false);
+    const Edge trace[] = { {5000, true}, {5100, false} };
+    Change ch[4];
+    const int n = replay(trace, 2, 100000, ch, 4);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT64(5000, ch[0].us);
+    TEST_ASSERT_EQUAL_INT64(36000, ch[1].us);   // First poll >= 5.1 ms + window
+}
+
+// Line stuck high (optocoupler saturated / DC on an AC input) stays on
+static void test_ac_steady_high() {
+    configure(CH, MODE_AC, 0);
+    reset(CH, false);
+    const Edge trace[] = { {1000, true} };
+    Change ch[4];
+    const int n = replay(trace, 1, 500000, ch, 4);
+    TEST_ASSERT_EQUAL_INT(1, n);
+    TEST_ASSERT_TRUE(state(CH));
+    TEST_ASSERT_EQUAL_UINT16(1 << CH, states());
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_dc_bouncing_contact);
+    RUN_TEST(test_dc_settles_differently);
+    RUN_TEST(test_dc_lone_glitch);
+    RUN_TEST(test_ac_50hz_on_off);
+    RUN_TEST(test_ac_missing_pulse);
+    RUN_TEST(test_ac_lone_glitch);
+    RUN_TEST(test_ac_steady_high);
+    return UNITY_END();
+}
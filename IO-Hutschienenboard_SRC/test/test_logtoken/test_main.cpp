@@ -0,0 +1,97 @@
+// logtoken: argument packing, truncation and framing of tokenized log records
+//   pio test -e native-test -f test_logtoken
+#include <unity.h>
+#include <string.h>
+#include "logtoken.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_pack_layout() {
+    tok::Packer pk;
+    tok::packAll(pk, (uint8_t)7, -2, (uint64_t)0x0102030405060708ULL, "ab", 1.5);
+    const uint8_t head[] = {
+        0x07, 0x00, 0x00, 0x00,                             // uint8_t -> 4 bytes
+        0xFE, 0xFF, 0xFF, 0xFF,                             // int
+        0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,     // 64 bit
+        'a', 'b', 0x00,                                     // %s + NUL
+    };
+    TEST_ASSERT_EQUAL_UINT8(sizeof(head) + 8, pk.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(head, pk.buf, sizeof(head));
+    double d;
+    memcpy(&d, pk.buf + sizeof(head), 8);
+    TEST_ASSERT_TRUE(d == 1.5);
+    TEST_ASSERT_FALSE(pk.truncated);
+}
+
+// Strings are cut to DBG_TOK_STR_MAX - 1 characters, not dropped
+static void test_long_string_cut() {
+    char s[80];
+    memset(s, 'x', sizeof(s) - 1);
+    s[sizeof(s) - 1] = '\0';
+    tok::Packer pk;
+    tok::packAll(pk, (const char*)s);
+    TEST_ASSERT_EQUAL_UINT8(DBG_TOK_STR_MAX, pk.len);
+    TEST_ASSERT_EQUAL_UINT8(0, pk.buf[DBG_TOK_STR_MAX - 1]);
+    TEST_ASSERT_FALSE(pk.truncated);
+
+    tok::Packer nul;
+    tok::packAll(nul, (const char*)nullptr);
+    TEST_ASSERT_EQUAL_STRING("(null)", (const char*)nul.buf);
+}
+
+// 13 ints (52 bytes) + a 47-char string (48) overflow the 96 bytes:
+// the string and everything after it are dropped, nothing is packed
+// in the string's place
+static void test_stop_after_truncation() {
+    char s[48];
+    memset(s, 'y', 47);
+    s[47] = '\0';
+    tok::Packer pk;
+    tok::packAll(pk, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, (const char*)s, 77);
+    TEST_ASSERT_TRUE(pk.truncated);
+    TEST_ASSERT_EQUAL_UINT8(13 * 4, pk.len);
+
+    tok::Packer ints;
+    for (int k = 0; k < 24; k++) tok::pack(ints, k);       // Exactly full
+    TEST_ASSERT_FALSE(ints.truncated);
+    tok::pack(ints, (uint8_t)1);
+    TEST_ASSERT_TRUE(ints.truncated);
+    TEST_ASSERT_EQUAL_UINT8(DBG_TOK_ARGS_MAX, ints.len);
+}
+
+// Frame as tools/logdecode.py reads it; the sum covers fmt..args
+static void test_frame_layout() {
+    static const char fmt[] = "Relais %d: %s";
+    tok::Packer pk;
+    tok::packAll(pk, 3, "EIN");
+    uint8_t f[DBG_TOK_FRAME_MAX];
+    const size_t n = tok::encodeFrame(f, fmt, 0x11223344u, 0x0A0B0C0Du, 2, 0x0010, pk.buf, pk.len, true);
+    TEST_ASSERT_EQUAL_UINT32(DBG_TOK_FRAME_HDR + 8 + 1, n);
+    TEST_ASSERT_EQUAL_HEX8(DBG_TOK_SYNC0, f[0]);
+    TEST_ASSERT_EQUAL_HEX8(DBG_TOK_SYNC1, f[1]);
+    TEST_ASSERT_EQUAL_UINT8(8, f[2]);
+    uint32_t addr, sec, ms;
+    memcpy(&addr, f + 3, 4);
+    memcpy(&sec, f + 7, 4);
+    memcpy(&ms, f + 11, 4);
+    TEST_ASSERT_EQUAL_HEX32((uint32_t)(uintptr_t)fmt, addr);
+    TEST_ASSERT_EQUAL_HEX32(0x11223344u, sec);
+    TEST_ASSERT_EQUAL_HEX32(0x0A0B0C0Du, ms);
+    TEST_ASSERT_EQUAL_HEX8(2 | DBG_TOK_TRUNCATED, f[15]);
+    TEST_ASSERT_EQUAL_HEX8(0x10, f[16]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, f[17]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(pk.buf, f + DBG_TOK_FRAME_HDR, 8);
+    uint8_t sum = 0;
+    for (size_t i = 3; i < n - 1; i++) sum += f[i];
+    TEST_ASSERT_EQUAL_HEX8(sum, f[n - 1]);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pack_layout);
+    RUN_TEST(test_long_string_cut);
+    RUN_TEST(test_stop_after_truncation);
+    RUN_TEST(test_frame_layout);
+    return UNITY_END();
+}
@@ -0,0 +1,232 @@
+// rules: compile() on the rule language and evaluate() on the images -
+// actions, interlocks, level rules, stairwell, errors, 64-bit masks
+//   pio test -e native-test -f test_rules
+#include <unity.h>
+#include <string.h>
+#include "rules.h"
+
+using namespace rules;
+
+static Program s_p;
+
+void setUp() {}
+void tearDown() {}
+
+// 1-based channel as a mask bit, like the rule text
+static Mask ch(int n) {
+    return (Mask)(1u << (n - 1));
+}
+
+static void load(const char* text) {
+    Error err = {0, nullptr};
+    TEST_ASSERT_TRUE_MESSAGE(compile(text, s_p, &err), err.msg ? err.msg : "compile");
+}
+
+static Mask run(Mask in, Mask rise, Mask out, Mask& stair) {
+    stair = 0;
+    return evaluate(s_p.row, s_p.rows, in, rise, out, stair);
+}
+
+static Mask run(Mask in, Mask rise, Mask out) {
+    Mask stair = 0;
+    return run(in, rise, out, stair);
+}
+
+static void expectError(const char* text, uint16_t pos, const char* msg) {
+    Error err = {0xFFFF, nullptr};
+    TEST_ASSERT_FALSE_MESSAGE(compile(text, s_p, &err), text);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(msg, err.msg, text);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(pos, err.pos, text);
+    TEST_ASSERT_EQUAL_UINT8(0, s_p.rows);      // Nothing half-compiled
+}
+
+// --- Edge rules ---
+
+static void test_toggle() {
+    load("E1 -> toggle A1 A2");
+    TEST_ASSERT_EQUAL_UINT8(1, s_p.rows);
+    TEST_ASSERT_EQUAL_HEX16(ch(2), run(ch(1), ch(1), ch(1)));
+    TEST_ASSERT_EQUAL_HEX16(ch(1), run(ch(1), 0, ch(1)));           // Held, no edge
+    TEST_ASSERT_EQUAL_HEX16(ch(1), run(ch(1) | ch(2), ch(2), ch(1)));   // Edge of another input
+}
+
+static void test_scene_and_central_off() {
+    load("E9 -> on A1 A3, off A2\n"
+         "E12 -> off A1-A12\n"
+         "E11 -> on A4-6");
+    TEST_ASSERT_EQUAL_UINT8(3, s_p.rows);
+    TEST_ASSERT_EQUAL_HEX16(ch(1) | ch(3) | ch(8), run(ch(9), ch(9), ch(2) | ch(8)));
+    TEST_ASSERT_EQUAL_HEX16(0, run(ch(12), ch(12), 0x0FFF));
+    TEST_ASSERT_EQUAL_HEX16(ch(4) | ch(5) | ch(6), run(ch(11), ch(11), 0));
+
+    // Same scan: the later row wins
+    TEST_ASSERT_EQUAL_HEX16(0, run(ch(9) | ch(12), ch(9) | ch(12), ch(2)));
+}
+
+static void test_if_condition() {
+    load("E4 -> on A6 if E5 & !E6\n"
+         "E1 -> on A1 if E2 | E3");
+    TEST_ASSERT_EQUAL_HEX16(ch(6), run(ch(4) | ch(5), ch(4), 0));
+    TEST_ASSERT_EQUAL_HEX16(0, run(ch(4), ch(4), 0));                   // E5 missing
+    TEST_ASSERT_EQUAL_HEX16(0, run(ch(4) | ch(5) | ch(6), ch(4), 0));   // E6 on
+
+    TEST_ASSERT_EQUAL_HEX16(ch(1), run(ch(1) | ch(3), ch(1), 0));
+    TEST_ASSERT_EQUAL_HEX16(0, run(ch(1), ch(1), 0));
+}
+
+// "unless" tests the output image as the earlier rows left it
+static void test_unless_interlock() {
+    load("E7 -> on A7 unless A8\n"
+         "E8 -> on A8 unless A7");
+    TEST_ASSERT_EQUAL_HEX16(ch(7), run(ch(7), ch(7), 0));
+    TEST_ASSERT_EQUAL_HEX16(ch(8), run(ch(7), ch(7), ch(8)));           // Blocked by A8
+    TEST_ASSERT_EQUAL_HEX16(ch(7), run(ch(7) | ch(8), ch(7) | ch(8), 0));   // Row 1 first, A8 blocked
+
+    load("E1 -> on A8\n"
+         "E1 -> on A7 unless A8");
+    TEST_ASSERT_EQUAL_HEX16(ch(8), run(ch(1), ch(1), 0));
+}
+
+// --- Level rules ---
+
+static void test_level_rules() {
+    load("A10 = E10 & E11\n"
+         "A11 = E10 | E11 unless A10");
+    TEST_ASSERT_EQUAL_UINT16(0, s_p.row[0].trig);
+    TEST_ASSERT_EQUAL_HEX16(ch(10), run(ch(10) | ch(11), 0, 0));
+    TEST_ASSERT_EQUAL_HEX16(ch(11), run(ch(10), 0, ch(10)));            // A10 follows back off
+    TEST_ASSERT_EQUAL_HEX16(ch(11), run(ch(11), 0, 0));
+    TEST_ASSERT_EQUAL_HEX16(0, run(0, 0, ch(10) | ch(11)));
+    TEST_ASSERT_EQUAL_HEX16(ch(1), run(0, 0, ch(1)));                   // Other outputs kept
+}
+
+// --- Stairwell ---
+
+static void test_stair_retrigger() {
+    load("E2 | E3 -> stair 120 A5\n"
+         "E4 -> stair 30 A6 A7");
+    TEST_ASSERT_EQUAL_UINT16(120, s_p.stairSecs[4]);
+    TEST_ASSERT_EQUAL_UINT16(30, s_p.stairSecs[5]);
+    TEST_ASSERT_EQUAL_UINT16(30, s_p.stairSecs[6]);
+    TEST_ASSERT_EQUAL_UINT16(0, s_p.stairSecs[0]);
+
+    Mask stair = 0;
+    TEST_ASSERT_EQUAL_HEX16(ch(5), run(ch(3), ch(3), 0, stair));
+    TEST_ASSERT_EQUAL_HEX16(ch(5), stair);
+
+    // Pressed again while on: stays on, timer restarts
+    TEST_ASSERT_EQUAL_HEX16(ch(5), run(ch(2), ch(2), ch(5), stair));
+    TEST_ASSERT_EQUAL_HEX16(ch(5), stair);
+
+    // No edge: no restart
+    TEST_ASSERT_EQUAL_HEX16(ch(5), run(ch(2), 0, ch(5), stair));
+    TEST_ASSERT_EQUAL_HEX16(0, stair);
+
+    TEST_ASSERT_EQUAL_HEX16(ch(6) | ch(7), run(ch(4), ch(4), 0, stair));
+    TEST_ASSERT_EQUAL_HEX16(ch(6) | ch(7), stair);
+}
+
+// --- Compiler ---
+
+static void test_syntax_accepted() {
+    load("# Flur\n"
+         "\n"
+         "e1 -> TOGGLE a1   # Kommentar\r\n"
+         ";;E2->on A2;E3->off A3\n");
+    TEST_ASSERT_EQUAL_UINT8(3, s_p.rows);
+    TEST_ASSERT_EQUAL_HEX16(ch(1), s_p.row[0].tog);
+
+    load("");
+    TEST_ASSERT_EQUAL_UINT8(0, s_p.rows);
+    TEST_ASSERT_TRUE(compile(nullptr, s_p));
+}
+
+static void test_compile_errors() {
+    expectError("E1 toggle A1", 3, "'->' erwartet");
+    expectError("E1 -> blink A1", 6, "Aktion erwartet (toggle, on, off, stair)");
+    expectError("E1 -> toggle A13 A1", 16, "Kanal ausserhalb 1..12");
+    expectError("E1 -> on A3-A1", 14, "Bereich absteigend");
+    expectError("E1 -> stair 0 A1", 13, "Sekunden erwartet (1..65535)");
+    expectError("E1 -> on A1 if E2 & E3 | E4", 24, "'&' und '|' gemischt");
+    expectError("E1 -> on A1 if E2 | !E3", 23, "'!' nur in UND-Bedingungen");
+    expectError("A1 = E1 if E2", 8, "Ende der Regel erwartet");
+    expectError("E1 -> on A1\nE2 -> on X1", 21, "Ausgang erwartet (A1..A12)");
+    expectError("A1 -> on A2", 3, "'=' erwartet");
+
+    char text[RULES_TEXT_MAX];
+    text[0] = '\0';
+    for (int k = 0; k <= RULES_MAX; k++) strcat(text, "E1->on A1;");
+    expectError(text, RULES_MAX * 10, "Zu viele Regeln (max 24)");
+
+    char big[RULES_TEXT_MAX + 1];
+    memset(big, ';', RULES_TEXT_MAX);
+    big[RULES_TEXT_MAX] = '\0';
+    expectError(big, 0, "Regeltext zu lang");
+}
+
+// --- 64-bit masks ---
+
+// Widen a compiled row and move it up by shift bits
+static BasicRow<uint64_t> widen(const Row& r, int shift) {
+    BasicRow<uint64_t> w;
+    w.trig = (uint64_t)r.trig << shift;
+    w.inAll = (uint64_t)r.inAll << shift;
+    w.inNone = (uint64_t)r.inNone << shift;
+    w.inAny = (uint64_t)r.inAny << shift;
+    w.outNone = (uint64_t)r.outNone << shift;
+    w.tog = (uint64_t)r.tog << shift;
+    w.set = (uint64_t)r.set << shift;
+    w.clr = (uint64_t)r.clr << shift;
+    w.stair = (uint64_t)r.stair << shift;
+    w.follow = (uint64_t)r.follow << shift;
+    return w;
+}
+
+// Every row kind on channels 49..60 of a 64-bit image gives the same
+// result as the 16-bit table, for a fixed pseudo-random set of images
+static void test_basic_row_u64() {
+    load("E1 -> toggle A1 A2\n"
+         "E2 | E3 -> stair 60 A3\n"
+         "E4 -> on A4 A5, off A6 if E5 & !E6\n"
+         "E7 -> on A7 unless A8\n"
+         "A9 = E9 & E10\n"
+         "A10 = E10 | E11 unless A9\n"
+         "E12 -> off A1-A12");
+    const int SHIFT = 48;
+    BasicRow<uint64_t> wide[RULES_MAX];
+    for (uint8_t k = 0; k < s_p.rows; k++) wide[k] = widen(s_p.row[k], SHIFT);
+
+    uint32_t seed = 12345;
+    for (int n = 0; n < 2000; n++) {
+        Mask img[3];
+        for (int k = 0; k < 3; k++) {
+            seed = seed * 1103515245u + 12345u;
+            img[k] = (Mask)((seed >> 8) & 0x0FFF);
+        }
+        const Mask in = img[0];
+        const Mask rise = (Mask)(in & img[1]);
+        Mask stair = 0;
+        const Mask next = evaluate(s_p.row, s_p.rows, in, rise, img[2], stair);
+
+        uint64_t stair64 = 0;
+        const uint64_t low = 0x5A5A5A5AULL;     // Channels outside the rules stay put
+        const uint64_t next64 = evaluate(wide, s_p.rows, (uint64_t)in << SHIFT, (uint64_t)rise << SHIFT,
+                                         ((uint64_t)img[2] << SHIFT) | low, stair64);
+        TEST_ASSERT_EQUAL_HEX64(((uint64_t)next << SHIFT) | low, next64);
+        TEST_ASSERT_EQUAL_HEX64((uint64_t)stair << SHIFT, stair64);
+    }
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_toggle);
+    RUN_TEST(test_scene_and_central_off);
+    RUN_TEST(test_if_condition);
+    RUN_TEST(test_unless_interlock);
+    RUN_TEST(test_level_rules);
+    RUN_TEST(test_stair_retrigger);
+    RUN_TEST(test_syntax_accepted);
+    RUN_TEST(test_compile_errors);
+    RUN_TEST(test_basic_row_u64);
+    return UNITY_END();
+}
@@ -0,0 +1,96 @@
+"""Embed the web assets from data/ into the firmware image.
+
+PlatformIO pre-build script (extra_scripts = pre:tools/embed_assets.py).
+Every file in data/ is gzipped (reproducible: no timestamp, no name),
+hashed (SHA-256 of the gzip bytes, first 16 hex digits = ETag) and
+written as a byte array to $BUILD_DIR/gen/webassets_data.h, which
+src/webassets.cpp includes. The header is only rewritten when an
+asset changed, so unchanged assets do not trigger a rebuild.
+
+Standalone (to inspect the output):
+    python tools/embed_assets.py data out_dir
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+
+MIME = {
+    ".html": "text/html",
+    ".htm": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".txt": "text/plain",
+}
+
+
+def collect(data_dir):
+    assets = []
+    for root, _, files in os.walk(data_dir):
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            rel = "/" + os.path.relpath(path, data_dir).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                raw = f.read()
+            packed = gzip.compress(raw, compresslevel=9, mtime=0)
+            digest = hashlib.sha256(packed).hexdigest()[:16]
+            mime = MIME.get(os.path.splitext(name)[1].lower(), "application/octet-stream")
+            assets.append((rel, mime, packed, digest, len(raw)))
+    assets.sort()
+    return assets
+
+
+def render(assets):
+    out = ["// Generated by tools/embed_assets.py - do not edit", "#pragma once", ""]
+    for i, (rel, _, packed, digest, size) in enumerate(assets):
+        out.append("// %s: %u -> %u bytes, %s" % (rel, size, len(packed), digest))
+        out.append("static const uint8_t ASSET_%u[] = {" % i)
+        for k in range(0, len(packed), 20):
+            out.append("    " + ", ".join("0x%02x" % b for b in packed[k:k + 20]) + ",")
+        out.append("};")
+        out.append("")
+    out.append("static const webassets::Asset ASSETS[] = {")
+    for i, (rel, mime, packed, digest, _) in enumerate(assets):
+        out.append('    {"%s", "%s", ASSET_%u, %u, "%s", "\\"%s\\""},'
+                   % (rel, mime, i, len(packed), digest, digest))
+    if not assets:
+        out.append('    {"", "", nullptr, 0, "", ""},')
+    out.append("};")
+    out.append("static const uint8_t ASSET_COUNT = %u;" % len(assets))
+    out.append("")
+    return "\n".join(out)
+
+
+def generate(data_dir, out_dir):
+    os.makedirs(out_dir, exist_ok=True)
+    target = os.path.join(out_dir, "webassets_data.h")
+    assets = collect(data_dir) if os.path.isdir(data_dir) else []
+    text = render(assets)
+    old = None
+    if os.path.exists(target):
+        with open(target) as f:
+            old = f.read()
+    if text != old:
+        with open(target, "w", newline="\n") as f:
+            f.write(text)
+    for rel, _, packed, digest, size in assets:
+        print("Web asset %s: %u -> %u bytes (gzip), ETag %s" % (rel, size, len(packed), digest))
+    return out_dir
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+except NameError:
+    env = None
+
+if env is not None:
+    gen = generate(os.path.join(env.subst("$PROJECT_DIR"), "data"),
+                   os.path.join(env.subst("$BUILD_DIR"), "gen"))
+    env.Append(CPPPATH=[gen])
+elif __name__ == "__main__":
+    generate(sys.argv[1], sys.argv[2])
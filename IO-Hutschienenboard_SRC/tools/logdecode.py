@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Decoder for tokenized dbg:: log frames (build flag DBG_TOKENIZED=1).
+
+The firmware sends the address of each format string instead of the
+text; this tool reads the strings from the firmware ELF and prints the
+same "[ts] LVL CAT   | msg" lines as the text mode. Bytes outside of
+frames (ROM boot messages, panics) are passed through unchanged.
+
+    pip install pyelftools pyserial
+    python tools/logdecode.py .pio/build/esp32s3/firmware.elf --port COM3
+    python tools/logdecode.py firmware.elf --file capture.bin
+
+Frame (little-endian), see tok::encodeFrame() in include/logtoken.h:
+    A5 5A | len | fmt u32 | sec u32 | ms u32 | lvl u8 | cat u16 | args[len] | sum u8
+lvl bit 7 set: the device dropped the arguments after args[len] (they
+render as "<?>", the line ends in " <...>").
+"""
+
+import argparse
+import re
+import struct
+import sys
+import time
+
+from elftools.elf.elffile import ELFFile
+
+SYNC = b"\xA5\x5A"
+HEADER = struct.Struct("<IIIBH")   # fmt, sec, ms, lvl, cat
+TRUNCATED = 0x80                   # lvl flag, DBG_TOK_TRUNCATED in logtoken.h
+
+LEVELS = ["DBG", "INF", "WRN", "ERR"]
+COLORS = ["\033[36m", "\033[32m", "\033[33m", "\033[31m"]
+CATEGORIES = ["SYS", "WIFI", "NTP", "MCP", "RELAY", "INPUT", "WEB", "CONF", "TIMER"]
+
+# printf conversion: flags, width, precision, length, type
+SPEC = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGp%])")
+
+
+class FormatTable:
+    """Format strings by address, read lazily from the ELF's loaded sections."""
+
+    def __init__(self, path):
+        self._f = open(path, "rb")
+        self._elf = ELFFile(self._f)
+        self._sections = [s for s in self._elf.iter_sections()
+                          if s["sh_flags"] & 0x2 and s["sh_type"] != "SHT_NOBITS"]
+        self._cache = {}
+
+    def lookup(self, addr):
+        if addr in self._cache:
+            return self._cache[addr]
+        text = None
+        for s in self._sections:
+            start = s["sh_addr"]
+            if start <= addr < start + s["sh_size"]:
+                data = s.data()
+                off = addr - start
+                end = data.find(b"\0", off)
+                text = data[off:end if end >= 0 else len(data)].decode("utf-8", "replace")
+                break
+        self._cache[addr] = text
+        return text
+
+
+def cat_name(mask):
+    for bit, name in enumerate(CATEGORIES):
+        if mask & (1 << bit):
+            return name
+    return "???"
+
+
+def render(fmt, args):
+    """printf-style formatting with the packed argument bytes."""
+    out = []
+    pos = 0
+    last = 0
+
+    def take(n):
+        nonlocal pos
+        if pos + n > len(args):
+            raise ValueError
+        chunk = args[pos:pos + n]
+        pos += n
+        return chunk
+
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        try:
+            if width == "*":
+                width = str(struct.unpack("<i", take(4))[0])
+            if prec == "*":
+                prec = str(struct.unpack("<i", take(4))[0])
+            spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+            if conv == "s":
+                end = args.find(b"\0", pos)
+                if end < 0:
+                    raise ValueError
+                value = args[pos:end].decode("utf-8", "replace")
+                pos = end + 1
+                out.append((spec + "s") % value)
+            elif conv in "fFeEgG":
+                out.append((spec + conv) % struct.unpack("<d", take(8))[0])
+            elif conv == "p":
+                out.append("0x%08x" % struct.unpack("<I", take(4))[0])
+            else:
+                wide = length in ("ll", "j")
+                raw = take(8 if wide else 4)
+                signed = conv in "di"
+                code = ("<q" if signed else "<Q") if wide else ("<i" if signed else "<I")
+                value = struct.unpack(code, raw)[0]
+                if length == "hh":
+                    value = value & 0xFF if not signed else (value + 0x80) % 0x100 - 0x80
+                elif length == "h":
+                    value = value & 0xFFFF if not signed else (value + 0x8000) % 0x10000 - 0x8000
+                out.append((spec + ("d" if conv == "u" else conv)) % value)
+        except ValueError:
+            out.append("<?>")
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def timestamp(sec, ms):
+    if sec >= 1483228800:   # Clock set (same check as on the device)
+        return time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(sec))
+    return "%u.%03u" % (ms // 1000, ms % 1000)
+
+
+def decode_stream(read, table, out):
+    buf = bytearray()
+    while True:
+        chunk = read()
+        if not chunk:
+            break
+        buf += chunk
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                keep = 1 if buf.endswith(SYNC[:1]) else 0
+                out.write(bytes(buf[:len(buf) - keep]).decode("utf-8", "replace"))
+                del buf[:len(buf) - keep]
+                break
+            if i:
+                out.write(bytes(buf[:i]).decode("utf-8", "replace"))
+                del buf[:i]
+            if len(buf) < 3:
+                break
+            n = buf[2]
+            total = 3 + HEADER.size + n + 1
+            if len(buf) < total:
+                break
+            body = bytes(buf[3:total - 1])
+            if (sum(body) & 0xFF) != buf[total - 1]:
+                out.write(bytes(buf[:1]).decode("latin-1"))   # Not a frame, resync
+                del buf[:1]
+                continue
+            fmt, sec, ms, lvl, cat = HEADER.unpack_from(body)
+            text = table.lookup(fmt)
+            msg = render(text, body[HEADER.size:]) if text is not None else "<fmt 0x%08x?>" % fmt
+            if lvl & TRUNCATED:
+                msg += " <...>"
+            lvl = min(lvl & ~TRUNCATED, 3)
+            out.write("%s[%s] %s %-5s | %s\033[0m\r\n" % (
+                COLORS[lvl], timestamp(sec, ms), LEVELS[lvl], cat_name(cat), msg))
+            del buf[:total]
+        out.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf", help="firmware.elf of the running build")
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--port", help="serial port (e.g. COM3, /dev/ttyUSB0)")
+    src.add_argument("--file", help="raw capture, '-' for stdin")
+    ap.add_argument("--baud", type=int, default=115200)
+    a = ap.parse_args()
+
+    table = FormatTable(a.elf)
+    if a.port:
+        import serial
+        port = serial.Serial(a.port, a.baud, timeout=0.1)
+
+        def read():   # Block across read timeouts
+            while True:
+                data = port.read(4096)
+                if data:
+                    return data
+    else:
+        f = sys.stdin.buffer if a.file == "-" else open(a.file, "rb")
+        read = lambda: f.read(4096)
+
+    try:
+        decode_stream(read, table, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()